@@ -0,0 +1,75 @@
+#!/bin/sh
+# Phase-level benchmark of pagerank and hits on an R-MAT graph.
+#
+#   ./bench.sh [scale] [edge_factor] [trials] [K]
+#
+# Every trial runs both tools twice: once cold, after removing their caches
+# (and dropping the page cache when allowed), so that parsing, building and
+# writing are timed, and once warm, reusing the caches. Both tools then run
+# cold and warm on the SELL-C-sigma layout, the cold runs building it from
+# the CSR cache, and pagerank warm on the edge stream layout, to compare
+# them with the CSR loops. The phase timings of all the runs, each one with
+# its layout, are collected in
+# bench_rmat-s<scale>-e<edge_factor>.json.
+
+SCALE=${1:-16}
+EDGES=${2:-16}
+TRIALS=${3:-3}
+K=${4:-10}
+NAME=rmat-s$SCALE-e$EDGES
+INPUT=data/$NAME.txt
+OUT=bench_$NAME.json
+TMP=bench_$NAME.tmp
+
+set -e
+mkdir -p data
+if [ ! -f "$INPUT" ]; then
+  ./rmat -s "$SCALE" -e "$EDGES" "$INPUT"
+fi
+
+drop_caches() {
+  sync
+  if ! (echo 3 > /proc/sys/vm/drop_caches) 2> /dev/null; then
+    echo "bench: cannot drop the page cache, input file may be cached" >&2
+  fi
+}
+
+run() {
+  # run <cold|warm> <trial> <tool> [args...]
+  mode=$1
+  trial=$2
+  shift 2
+  "$@" > /dev/null
+  printf '%s{"mode": "%s", "trial": %d, "run": ' "$SEP" "$mode" "$trial" \
+    >> "$OUT"
+  tr -d '\n' < "$TMP" >> "$OUT"
+  printf '}\n' >> "$OUT"
+  SEP=", "
+}
+
+printf '[' > "$OUT"
+SEP=""
+trial=1
+while [ "$trial" -le "$TRIALS" ]; do
+  echo "bench: $NAME trial $trial/$TRIALS"
+  rm -f "$NAME".graph "$NAME".sell "$NAME".sell_t "$NAME".stream
+  drop_caches
+  run cold "$trial" ./pagerank -T "$TMP" "$INPUT"
+  drop_caches
+  run cold "$trial" ./hits -T "$TMP" "$INPUT" "$K"
+  run warm "$trial" ./pagerank -T "$TMP" "$INPUT"
+  ./pagerank -l stream "$INPUT" > /dev/null
+  run warm "$trial" ./pagerank -l stream -T "$TMP" "$INPUT"
+  run warm "$trial" ./hits -T "$TMP" "$INPUT" "$K"
+  rm -f "$NAME".sell "$NAME".sell_t
+  drop_caches
+  run cold "$trial" ./pagerank -l sell -T "$TMP" "$INPUT"
+  drop_caches
+  run cold "$trial" ./hits -l sell -T "$TMP" "$INPUT" "$K"
+  run warm "$trial" ./pagerank -l sell -T "$TMP" "$INPUT"
+  run warm "$trial" ./hits -l sell -T "$TMP" "$INPUT" "$K"
+  trial=$((trial + 1))
+done
+printf ']\n' >> "$OUT"
+rm -f "$TMP"
+echo "bench: timings written to $OUT"
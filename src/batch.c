@@ -0,0 +1,710 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph.h"
+#include "pool.h"
+#include "spmv.h"
+#include "team.h"
+#include "timer.h"
+
+#define TOL 1.e-10
+#define MAX_ITER 200
+#define BATCH_GRAIN 65536L /* edges of a task when a solve is split */
+#define BATCH_SPLIT 4      /* tasks per worker of a split solve, at most */
+#define BATCH_PAGERANK 1
+#define BATCH_AUTH 2
+#define BATCH_HUB 4
+#define BATCH_HITS (BATCH_AUTH | BATCH_HUB)
+#define FNAME 256
+#define PATH 1024
+
+/* Degrees of a graph, collected by the first sweep of its solve */
+typedef struct {
+  int max_in, max_out;
+  int no_sources; /* nodes without in-edges */
+  int no_danglings;
+} Batch_degrees;
+
+/* A graph of the manifest and the algorithms to run on it */
+typedef struct {
+  char *input;
+  char name[FNAME];
+  int algos;
+  int separate; /* a solve per algorithm rather than a single one */
+  long size;    /* bytes of the input */
+  double d;
+  Pool *pool;
+  Graph graph;
+  int pr_iter, a_iter, h_iter;
+  double sweeps; /* passes over the edges of L or L^T */
+  Batch_degrees deg;
+  int no_tasks; /* of an iteration */
+  int worker;
+  double time;
+  int err;
+} Batch_job;
+
+typedef struct {
+  double dist, sum;   /* pagerank: distance and dangling ranks */
+  double a_sum, h_sum; /* hits: sums, then distances */
+  double a_dist, h_dist;
+  Batch_degrees deg;
+} Batch_partial;
+
+struct Batch_solve;
+
+typedef struct {
+  struct Batch_solve *s;
+  int t;
+} Batch_task;
+
+/* Solve of one or more metrics on one graph: every iteration is no_tasks
+ * tasks over the row ranges [bounds[t], bounds[t + 1]) of L^T and
+ * [bounds_l[t], bounds_l[t + 1]) of L, balanced by edges. active holds the
+ * metrics not converged yet. */
+typedef struct Batch_solve {
+  const Graph *g;
+  const SpMV_kernel *kernel;
+  Pool *pool;
+  int no_tasks;
+  int *bounds, *bounds_l;
+  Batch_task *tasks;
+  Batch_partial *partial;
+  int active;
+  int first; /* sweep collecting the degrees */
+  double d, dtp;
+  double *p, *p_new, *x, *x_new; /* pagerank ranks, scaled by out-degree */
+  double *a, *a_new, *h, *h_new; /* hits */
+  double a_sum, h_sum;
+} Batch_solve;
+
+/* A solve task: the job and the metrics to compute on its graph */
+typedef struct {
+  Batch_job *job;
+  int algos;
+  int pr_iter, a_iter, h_iter;
+  double sweeps;
+  Batch_degrees deg;
+  int no_tasks;
+  int err;
+} Batch_run;
+
+/* Helper functions */
+int write_data(char path[], void *data, size_t nmemb, size_t size);
+int read_manifest(FILE *in, Batch_job **jobs, double d);
+int cmp_jobs(const void *a, const void *b);
+void batch_graph(int worker, void *arg);
+void batch_solve(int worker, void *arg);
+int batch_init(Batch_solve *s, Pool *pool, const Graph *g, int algos,
+               double d);
+void batch_free(Batch_solve *s);
+void batch_run(Batch_solve *s, int worker, pool_fn fn);
+void batch_sweep(Batch_solve *s, int worker, Batch_run *run);
+void batch_sweep_task(int worker, void *arg);
+void batch_normalize_task(int worker, void *arg);
+
+/* Ranks many graphs in one process: the manifest lists an input and its
+ * algorithms (pagerank, hits) per line, and every graph is mapped (built the
+ * first time) and solved as tasks of a pool of threads that steal work.
+ * Small graphs run whole on one worker, large ones split every iteration
+ * into tasks of about BATCH_GRAIN edges for the idle workers to take. The
+ * algorithms of a graph share one sweep over its edges per iteration unless
+ * -S is given. The outputs are those of pagerank and hits without options. */
+int main(int argc, char *argv[]) {
+  Batch_job *jobs = NULL;
+  Pool *pool;
+  FILE *in;
+  struct stat st;
+  volatile int pending = 0;
+  double d = 0.85;
+  double begin, elapsed;
+  long tasks, steals, total_tasks = 0, total_steals = 0;
+  int no_threads = 1;
+  int separate = 0;
+  int no_jobs, no_solves = 0;
+  int opt;
+  int err = 0;
+  int i;
+
+  while ((opt = getopt(argc, argv, "t:d:S")) != -1) {
+    switch (opt) {
+    case 't':
+      no_threads = atoi(optarg);
+      break;
+    case 'd':
+      d = atof(optarg);
+      if (d <= 0. || d >= 1.) {
+        fprintf(stderr, " [ERROR] the damping factor must be in (0, 1)\n");
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'S':
+      separate = 1;
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./batch [-t <threads>] [-d <damping>] "
+                      "[-S] <manifest|->\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, " [ERROR] *1* argument required: ./batch <manifest|->\n");
+    exit(EXIT_FAILURE);
+  }
+  if (no_threads < 1)
+    no_threads = 1;
+
+  if (strcmp(argv[optind], "-") == 0)
+    in = stdin;
+  else if ((in = fopen(argv[optind], "r")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot open manifest \"%s\"\n", argv[optind]);
+    exit(EXIT_FAILURE);
+  }
+  no_jobs = read_manifest(in, &jobs, d);
+  if (in != stdin)
+    fclose(in);
+  if (no_jobs < 0)
+    exit(EXIT_FAILURE);
+  for (i = 0; i < no_jobs; ++i) {
+    jobs[i].size = stat(jobs[i].input, &st) == 0 ? (long)st.st_size : 0;
+    jobs[i].separate = separate;
+    no_solves += (jobs[i].algos & BATCH_PAGERANK) != 0;
+    no_solves += (jobs[i].algos & BATCH_HITS) != 0;
+  }
+
+  /* Largest graphs first: they are the oldest tasks of worker 0, the ones
+   * the other workers steal, while worker 0 packs the small ones */
+  qsort(jobs, no_jobs, sizeof(Batch_job), cmp_jobs);
+  if ((pool = pool_create(no_threads)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot start a pool of %d threads\n",
+            no_threads);
+    exit(EXIT_FAILURE);
+  }
+  printf("Batch of %d graphs, %d solves (%d thread%s)...\n", no_jobs,
+         no_solves, no_threads, no_threads > 1 ? "s" : "");
+  /* Caches built at once by several workers would mix their progress lines,
+   * so only the line of every graph is printed */
+  graph_set_quiet(1);
+  begin = timer_now();
+  for (i = 0; i < no_jobs && !err; ++i) {
+    jobs[i].pool = pool;
+    err = pool_spawn(pool, 0, batch_graph, jobs + i, &pending) ==
+          EXIT_FAILURE;
+  }
+  pool_wait(pool, 0, &pending);
+  elapsed = timer_now() - begin;
+
+  for (i = 0; i < no_jobs; ++i)
+    err = err || jobs[i].err;
+  for (i = 0; i < no_threads; ++i) {
+    pool_stats(pool, i, &tasks, &steals);
+    total_tasks += tasks;
+    total_steals += steals;
+  }
+  pool_destroy(pool);
+  printf("Done: %d graphs in %.3fs, %.1f graphs/s, %ld tasks, %ld stolen\n",
+         no_jobs, elapsed, elapsed > 0. ? no_jobs / elapsed : 0., total_tasks,
+         total_steals);
+
+  for (i = 0; i < no_jobs; ++i)
+    free(jobs[i].input);
+  free(jobs);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Helper functions */
+
+int write_data(char path[], void *data, size_t nmemb, size_t size) {
+  FILE *pdata;
+
+  if ((pdata = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  fwrite(data, size, nmemb, pdata);
+  fclose(pdata);
+  return EXIT_SUCCESS;
+}
+
+/* One graph per line, "<input> <algorithm>...", blank lines and lines from
+ * '#' skipped; an input listed twice gets the algorithms of both lines.
+ * Returns the number of graphs, -1 on errors. */
+int read_manifest(FILE *in, Batch_job **jobs, double d) {
+  Batch_job *job = NULL, *more;
+  char *line = NULL, *tok, *input;
+  char name[FNAME];
+  size_t len = 0;
+  int no_jobs = 0, size = 0, no_line = 0;
+  int algos = 0, i;
+
+  while (getline(&line, &len, in) != -1) {
+    ++no_line;
+    line[strcspn(line, "#")] = '\0';
+    if ((input = strtok(line, " \t\r\n")) == NULL)
+      continue;
+    algos = 0;
+    while ((tok = strtok(NULL, " \t\r\n,")) != NULL) {
+      if (strcmp(tok, "pagerank") == 0)
+        algos |= BATCH_PAGERANK;
+      else if (strcmp(tok, "hits") == 0)
+        algos |= BATCH_HITS;
+      else {
+        fprintf(stderr, " [ERROR] Line %d: unknown algorithm \"%s\" "
+                        "(pagerank, hits)\n",
+                no_line, tok);
+        algos = -1;
+        break;
+      }
+    }
+    if (algos == 0) {
+      fprintf(stderr, " [ERROR] Line %d: no algorithm for \"%s\"\n", no_line,
+              input);
+      algos = -1;
+    }
+    if (algos < 0)
+      break;
+
+    /* The outputs and caches are named after the input without directory
+     * and extensions, so two inputs may not share a name */
+    graph_name(input, name);
+    for (i = 0; i < no_jobs && strcmp(job[i].name, name) != 0; ++i)
+      ;
+    if (i < no_jobs && strcmp(job[i].input, input) != 0) {
+      fprintf(stderr, " [ERROR] Line %d: \"%s\" and \"%s\" both write %s.*\n",
+              no_line, job[i].input, input, name);
+      algos = -1;
+      break;
+    }
+    if (i < no_jobs) {
+      job[i].algos |= algos;
+      continue;
+    }
+    if (no_jobs == size) {
+      size = size > 0 ? 2 * size : 64;
+      if ((more = (Batch_job *)realloc(job, sizeof(Batch_job) * size)) ==
+          NULL) {
+        fprintf(stderr, " [ERROR] Not enough memory for the manifest\n");
+        algos = -1;
+        break;
+      }
+      job = more;
+    }
+    memset(job + no_jobs, 0, sizeof(Batch_job));
+    strcpy(job[no_jobs].name, name);
+    if ((job[no_jobs].input = (char *)malloc(strlen(input) + 1)) == NULL) {
+      fprintf(stderr, " [ERROR] Not enough memory for the manifest\n");
+      algos = -1;
+      break;
+    }
+    strcpy(job[no_jobs].input, input);
+    job[no_jobs].algos = algos;
+    job[no_jobs].d = d;
+    ++no_jobs;
+  }
+  free(line);
+  if (algos < 0 || no_jobs == 0) {
+    if (no_jobs == 0 && algos >= 0)
+      fprintf(stderr, " [ERROR] The manifest lists no graph\n");
+    for (i = 0; i < no_jobs; ++i)
+      free(job[i].input);
+    free(job);
+    return -1;
+  }
+  *jobs = job;
+  return no_jobs;
+}
+
+/* Larger inputs first, then in the order of the names */
+int cmp_jobs(const void *a, const void *b) {
+  const Batch_job *x = (const Batch_job *)a, *y = (const Batch_job *)b;
+
+  if (x->size != y->size)
+    return x->size > y->size ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+/* Maps the graph of a job, computes its metrics, in a single solve or in one
+ * per algorithm with -S, and writes the input ids once they are done */
+void batch_graph(int worker, void *arg) {
+  Batch_job *job = (Batch_job *)arg;
+  Batch_run runs[2];
+  char cache_p[PATH], fids[PATH];
+  volatile int pending = 0;
+  double begin = timer_now();
+  int no_runs = 0, i;
+
+  graph_path(job->name, ".graph", cache_p);
+  if (graph_open(&job->graph, job->input, cache_p, 1, NULL, NULL) ==
+      EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Graph \"%s\" could not be opened.\n",
+            job->input);
+    job->err = 1;
+    return;
+  }
+  memset(runs, 0, sizeof(runs));
+  if (!job->separate)
+    runs[no_runs++].algos = job->algos;
+  else {
+    if (job->algos & BATCH_PAGERANK)
+      runs[no_runs++].algos = BATCH_PAGERANK;
+    if (job->algos & BATCH_HITS)
+      runs[no_runs++].algos = BATCH_HITS;
+  }
+  for (i = 0; i < no_runs; ++i) {
+    runs[i].job = job;
+    if (no_runs == 1)
+      batch_solve(worker, runs + i);
+    else if (pool_spawn(job->pool, worker, batch_solve, runs + i,
+                        &pending) == EXIT_FAILURE)
+      runs[i].err = 1;
+  }
+  pool_wait(job->pool, worker, &pending);
+
+  for (i = 0; i < no_runs; ++i) {
+    job->err = job->err || runs[i].err;
+    if (runs[i].algos & BATCH_PAGERANK)
+      job->pr_iter = runs[i].pr_iter;
+    if (runs[i].algos & BATCH_HITS) {
+      job->a_iter = runs[i].a_iter;
+      job->h_iter = runs[i].h_iter;
+    }
+    job->sweeps += runs[i].sweeps;
+    if (runs[i].no_tasks > job->no_tasks)
+      job->no_tasks = runs[i].no_tasks;
+  }
+  job->deg = runs[0].deg;
+  if (!job->err && job->graph.data.sparse_ids) {
+    graph_path(job->name, ".ids", fids);
+    job->err = graph_write_ids(&job->graph, fids) == EXIT_FAILURE;
+  }
+  job->time = timer_now() - begin;
+  job->worker = worker;
+  /* The lines of a graph are printed whole, between those of the others */
+  flockfile(stdout);
+  printf("%s: %d nodes, %ld edges, ", job->name, job->graph.data.no_nodes,
+         job->graph.data.no_edges);
+  if (job->algos & BATCH_PAGERANK)
+    printf("pagerank %d iterations, ", job->pr_iter);
+  if (job->algos & BATCH_HITS)
+    printf("hits %d/%d iterations (a/h), ", job->a_iter, job->h_iter);
+  printf("%.0f sweeps, %d task%s per iteration, %.3fs on worker %d\n"
+         "  degrees: in at most %d, out at most %d, %d sources, %d "
+         "danglings\n",
+         job->sweeps, job->no_tasks, job->no_tasks > 1 ? "s" : "", job->time,
+         worker, job->deg.max_in, job->deg.max_out, job->deg.no_sources,
+         job->deg.no_danglings);
+  fflush(stdout);
+  funlockfile(stdout);
+  graph_close(&job->graph);
+}
+
+/* Computes the metrics of a run on the graph of its job and writes them, in
+ * increasing input id order, to the files of pagerank and hits */
+void batch_solve(int worker, void *arg) {
+  Batch_run *run = (Batch_run *)arg;
+  Batch_job *job = run->job;
+  Batch_solve s;
+  char path[PATH];
+  int n = job->graph.data.no_nodes;
+
+  if (batch_init(&s, job->pool, &job->graph, run->algos, job->d) ==
+      EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Not enough memory to solve \"%s\"\n",
+            job->input);
+    run->err = 1;
+    return;
+  }
+  run->no_tasks = s.no_tasks;
+  batch_sweep(&s, worker, run);
+  if (run->algos & BATCH_PAGERANK) {
+    graph_unpermute(s.g, s.p, s.p_new);
+    graph_path(job->name, ".pr", path);
+    run->err = write_data(path, s.p_new, sizeof(double), n) == EXIT_FAILURE;
+  }
+  if (run->algos & BATCH_HITS) {
+    graph_unpermute(s.g, s.a, s.a_new);
+    graph_path(job->name, "_a.hits", path);
+    run->err =
+        write_data(path, s.a_new, sizeof(double), n) == EXIT_FAILURE ||
+        run->err;
+    graph_unpermute(s.g, s.h, s.h_new);
+    graph_path(job->name, "_h.hits", path);
+    run->err =
+        write_data(path, s.h_new, sizeof(double), n) == EXIT_FAILURE ||
+        run->err;
+  }
+  batch_free(&s);
+}
+
+/* Vectors of the metrics of a solve and its split: one task for a small
+ * graph, else about BATCH_GRAIN edges per task, at most BATCH_SPLIT tasks
+ * per worker */
+int batch_init(Batch_solve *s, Pool *pool, const Graph *g, int algos,
+               double d) {
+  int n = g->data.no_nodes;
+  long no_tasks = g->data.no_edges / BATCH_GRAIN + 1;
+  int pr = (algos & BATCH_PAGERANK) != 0, hits = (algos & BATCH_HITS) != 0;
+  int t, i;
+
+  memset(s, 0, sizeof(Batch_solve));
+  if (no_tasks > (long)BATCH_SPLIT * pool_size(pool))
+    no_tasks = (long)BATCH_SPLIT * pool_size(pool);
+  if (no_tasks > n)
+    no_tasks = n > 0 ? n : 1;
+  s->g = g;
+  s->kernel = spmv_select(NULL, g->index_width);
+  s->pool = pool;
+  s->no_tasks = (int)no_tasks;
+  s->active = algos;
+  s->first = 1;
+  s->d = d;
+  s->bounds = (int *)malloc(sizeof(int) * (no_tasks + 1));
+  s->bounds_l = (int *)malloc(sizeof(int) * (no_tasks + 1));
+  s->tasks = (Batch_task *)malloc(sizeof(Batch_task) * no_tasks);
+  s->partial = (Batch_partial *)calloc(no_tasks, sizeof(Batch_partial));
+  if (s->bounds == NULL || s->bounds_l == NULL || s->tasks == NULL ||
+      s->partial == NULL || s->kernel == NULL) {
+    batch_free(s);
+    return EXIT_FAILURE;
+  }
+  if (pr) {
+    s->p = (double *)malloc(sizeof(double) * (n + 1));
+    s->p_new = (double *)malloc(sizeof(double) * (n + 1));
+    s->x = (double *)malloc(sizeof(double) * (n + 1));
+    s->x_new = (double *)malloc(sizeof(double) * (n + 1));
+    if (s->p == NULL || s->p_new == NULL || s->x == NULL || s->x_new == NULL) {
+      batch_free(s);
+      return EXIT_FAILURE;
+    }
+    for (i = 0; i < n; ++i) {
+      s->p[i] = 1. / (double)n;
+      s->x[i] = g->out_deg[i] > 0 ? s->p[i] / (double)g->out_deg[i] : 0.;
+    }
+    s->dtp = (double)g->data.no_danglings / (double)n / (double)n;
+  }
+  if (hits) {
+    s->a = (double *)malloc(sizeof(double) * (n + 1));
+    s->a_new = (double *)malloc(sizeof(double) * (n + 1));
+    s->h = (double *)malloc(sizeof(double) * (n + 1));
+    s->h_new = (double *)malloc(sizeof(double) * (n + 1));
+    if (s->a == NULL || s->a_new == NULL || s->h == NULL || s->h_new == NULL) {
+      batch_free(s);
+      return EXIT_FAILURE;
+    }
+    for (i = 0; i < n; ++i)
+      s->a[i] = s->h[i] = 1.;
+  }
+  team_partition(g->row_ptr_t, n, s->no_tasks, 1, s->bounds);
+  team_partition(g->row_ptr, n, s->no_tasks, 1, s->bounds_l);
+  for (t = 0; t < s->no_tasks; ++t) {
+    s->tasks[t].s = s;
+    s->tasks[t].t = t;
+  }
+  return EXIT_SUCCESS;
+}
+
+void batch_free(Batch_solve *s) {
+  free(s->bounds);
+  free(s->bounds_l);
+  free(s->tasks);
+  free(s->partial);
+  free(s->p);
+  free(s->p_new);
+  free(s->x);
+  free(s->x_new);
+  free(s->a);
+  free(s->a_new);
+  free(s->h);
+  free(s->h_new);
+  s->bounds = s->bounds_l = NULL;
+  s->tasks = NULL;
+  s->partial = NULL;
+  s->p = s->p_new = s->x = s->x_new = NULL;
+  s->a = s->a_new = s->h = s->h_new = NULL;
+}
+
+/* fn on every task of the solve: inline when there is one, else spawned on
+ * worker for any idle worker to steal, worker running its share */
+void batch_run(Batch_solve *s, int worker, pool_fn fn) {
+  volatile int pending = 0;
+  int t;
+
+  if (s->no_tasks == 1) {
+    fn(worker, s->tasks);
+    return;
+  }
+  for (t = s->no_tasks - 1; t >= 0; --t)
+    if (pool_spawn(s->pool, worker, fn, s->tasks + t, &pending) ==
+        EXIT_FAILURE)
+      fn(worker, s->tasks + t);
+  pool_wait(s->pool, worker, &pending);
+}
+
+/* The power iterations of pagerank without lumping and of hits, a and h
+ * normalized to sum 1, sharing their passes over the edges. Every metric
+ * leaves the sweep once its own distance is below TOL: a converged a (or h)
+ * stays as the input of the other one. */
+void batch_sweep(Batch_solve *s, int worker, Batch_run *run) {
+  int n = s->g->data.no_nodes;
+  double dist, sum, a_dist, h_dist, *swap;
+  int iter, t;
+
+  for (iter = 0; s->active != 0 && iter < MAX_ITER; ++iter) {
+    batch_run(s, worker, batch_sweep_task);
+    run->sweeps += (s->active & (BATCH_PAGERANK | BATCH_AUTH)) != 0;
+    run->sweeps += (s->active & BATCH_HUB) != 0;
+    if (s->first) {
+      run->deg = s->partial[0].deg;
+      for (t = 1; t < s->no_tasks; ++t) {
+        if (s->partial[t].deg.max_in > run->deg.max_in)
+          run->deg.max_in = s->partial[t].deg.max_in;
+        if (s->partial[t].deg.max_out > run->deg.max_out)
+          run->deg.max_out = s->partial[t].deg.max_out;
+        run->deg.no_sources += s->partial[t].deg.no_sources;
+        run->deg.no_danglings += s->partial[t].deg.no_danglings;
+      }
+      s->first = 0;
+    }
+
+    if (s->active & BATCH_PAGERANK) {
+      for (t = 0, dist = 0., sum = 0.; t < s->no_tasks; ++t) {
+        dist += s->partial[t].dist;
+        sum += s->partial[t].sum;
+      }
+      s->dtp = sum / (double)n;
+      swap = s->p;
+      s->p = s->p_new;
+      s->p_new = swap;
+      swap = s->x;
+      s->x = s->x_new;
+      s->x_new = swap;
+      run->pr_iter = iter + 1;
+      if (sqrt(dist) <= TOL)
+        s->active &= ~BATCH_PAGERANK;
+    }
+    if ((s->active & BATCH_HITS) == 0)
+      continue;
+
+    for (t = 0, s->a_sum = s->h_sum = 0.; t < s->no_tasks; ++t) {
+      s->a_sum += s->partial[t].a_sum;
+      s->h_sum += s->partial[t].h_sum;
+    }
+    batch_run(s, worker, batch_normalize_task);
+    for (t = 0, a_dist = h_dist = 0.; t < s->no_tasks; ++t) {
+      a_dist += s->partial[t].a_dist;
+      h_dist += s->partial[t].h_dist;
+    }
+    if (s->active & BATCH_AUTH) {
+      swap = s->a;
+      s->a = s->a_new;
+      s->a_new = swap;
+      run->a_iter = iter + 1;
+      if (sqrt(a_dist) <= TOL)
+        s->active &= ~BATCH_AUTH;
+    }
+    if (s->active & BATCH_HUB) {
+      swap = s->h;
+      s->h = s->h_new;
+      s->h_new = swap;
+      run->h_iter = iter + 1;
+      if (sqrt(h_dist) <= TOL)
+        s->active &= ~BATCH_HUB;
+    }
+  }
+}
+
+/* One pass over the rows of the task in L^T for p_new = d (L^T x + dtp) + (1
+ * - d) / n and a_new = L^T h, both from the same column ids when both are
+ * active, and one over its rows in L for h_new = L a; then the distance and
+ * dangling ranks of pagerank, the sums of hits and, the first time, the
+ * degrees */
+void batch_sweep_task(int worker, void *arg) {
+  Batch_task *task = (Batch_task *)arg;
+  Batch_solve *s = task->s;
+  Batch_partial *part = s->partial + task->t;
+  const Graph *g = s->g;
+  const long *row_ptr_t = g->row_ptr_t;
+  const void *col_ind_t = g->col_ind_t;
+  const int *out_deg = g->out_deg;
+  int lo = s->bounds[task->t], hi = s->bounds[task->t + 1];
+  int lo_l = s->bounds_l[task->t], hi_l = s->bounds_l[task->t + 1];
+  double teleport = (1. - s->d) / (double)g->data.no_nodes;
+  double dist = 0., sum = 0.;
+  int i, in;
+
+  if ((s->active & BATCH_PAGERANK) && (s->active & BATCH_AUTH))
+    s->kernel->pattern2(row_ptr_t, col_ind_t, s->x, s->h, s->p_new, s->a_new,
+                        lo, hi);
+  else if (s->active & BATCH_PAGERANK)
+    s->kernel->pattern(row_ptr_t, col_ind_t, s->x, s->p_new, lo, hi);
+  else if (s->active & BATCH_AUTH)
+    s->kernel->pattern(row_ptr_t, col_ind_t, s->h, s->a_new, lo, hi);
+  if (s->active & BATCH_HUB)
+    s->kernel->pattern(g->row_ptr, g->col_ind, s->a, s->h_new, lo_l, hi_l);
+
+  if (s->active & BATCH_PAGERANK) {
+    for (i = lo; i < hi; ++i) {
+      s->p_new[i] = s->d * (s->p_new[i] + s->dtp) + teleport;
+      s->x_new[i] = out_deg[i] > 0 ? s->p_new[i] / (double)out_deg[i] : 0.;
+      dist += (s->p[i] - s->p_new[i]) * (s->p[i] - s->p_new[i]);
+      if (out_deg[i] == 0)
+        sum += s->p_new[i];
+    }
+    part->dist = dist;
+    part->sum = sum;
+  }
+  if (s->active & BATCH_AUTH) {
+    for (i = lo, sum = 0.; i < hi; ++i)
+      sum += s->a_new[i];
+    part->a_sum = sum;
+  }
+  if (s->active & BATCH_HUB) {
+    for (i = lo_l, sum = 0.; i < hi_l; ++i)
+      sum += s->h_new[i];
+    part->h_sum = sum;
+  }
+
+  if (s->first) {
+    memset(&part->deg, 0, sizeof(Batch_degrees));
+    for (i = lo; i < hi; ++i) {
+      in = (int)(row_ptr_t[i + 1] - row_ptr_t[i]);
+      if (in > part->deg.max_in)
+        part->deg.max_in = in;
+      if (out_deg[i] > part->deg.max_out)
+        part->deg.max_out = out_deg[i];
+      part->deg.no_sources += in == 0;
+      part->deg.no_danglings += out_deg[i] == 0;
+    }
+  }
+}
+
+/* a_new and h_new of the task divided by their sums, and their distances to
+ * a and h, for the metrics still active */
+void batch_normalize_task(int worker, void *arg) {
+  Batch_task *task = (Batch_task *)arg;
+  Batch_solve *s = task->s;
+  int lo = s->bounds[task->t], hi = s->bounds[task->t + 1];
+  int lo_l = s->bounds_l[task->t], hi_l = s->bounds_l[task->t + 1];
+  double dist;
+  int i;
+
+  if (s->active & BATCH_AUTH) {
+    for (i = lo, dist = 0.; i < hi; ++i) {
+      s->a_new[i] /= s->a_sum;
+      dist += (s->a[i] - s->a_new[i]) * (s->a[i] - s->a_new[i]);
+    }
+    s->partial[task->t].a_dist = dist;
+  }
+  if (s->active & BATCH_HUB) {
+    for (i = lo_l, dist = 0.; i < hi_l; ++i) {
+      s->h_new[i] /= s->h_sum;
+      dist += (s->h[i] - s->h_new[i]) * (s->h[i] - s->h_new[i]);
+    }
+    s->partial[task->t].h_dist = dist;
+  }
+}
@@ -0,0 +1,266 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+/* Fletcher-like checksum over 64-bit words, the tail padded with zeros */
+static uint64_t cache_checksum(const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  uint64_t a = 1, b = 0, w;
+  size_t i;
+
+  for (i = 0; i + sizeof(w) <= size; i += sizeof(w)) {
+    memcpy(&w, p + i, sizeof(w));
+    a += w;
+    b += a;
+  }
+  if (i < size) {
+    w = 0;
+    memcpy(&w, p + i, size - i);
+    a += w;
+    b += a;
+  }
+  return a ^ (b << 32 | b >> 32);
+}
+
+static uint64_t cache_header_checksum(const Cache_header *h) {
+  Cache_header copy = *h;
+
+  copy.checksum = 0;
+  return cache_checksum(&copy, sizeof(Cache_header));
+}
+
+static size_t cache_round(size_t size) {
+  return (size + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+static int cache_pad(FILE *pf, size_t size) {
+  static const char zeros[CACHE_ALIGN] = {0};
+  size_t pad = cache_round(size) - size;
+
+  return fwrite(zeros, 1, pad, pf) == pad ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int cache_source(const char source[], uint64_t *size, int64_t *mtime,
+                        int64_t *mtime_ns) {
+  struct stat st;
+
+  if (stat(source, &st) == -1)
+    return EXIT_FAILURE;
+  *size = (uint64_t)st.st_size;
+  *mtime = (int64_t)st.st_mtim.tv_sec;
+  *mtime_ns = (int64_t)st.st_mtim.tv_nsec;
+  return EXIT_SUCCESS;
+}
+
+int cache_create(Cache_writer *cw, const char path[], const char source[],
+                 int index_width, int offset_width) {
+  Cache_header *h = &cw->header;
+
+  memset(h, 0, sizeof(Cache_header));
+  memcpy(h->magic, CACHE_MAGIC, sizeof(h->magic));
+  h->version = CACHE_VERSION;
+  h->index_width = (uint32_t)index_width;
+  h->offset_width = (uint32_t)offset_width;
+  if (cache_source(source, &h->source_size, &h->source_mtime,
+                   &h->source_mtime_ns) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Cannot stat source file \"%s\"\n", source);
+    return EXIT_FAILURE;
+  }
+  h->file_size = cache_round(sizeof(Cache_header));
+
+  cw->path = (char *)malloc(strlen(path) + 5);
+  sprintf(cw->path, "%s.tmp", path);
+  if ((cw->pf = fopen(cw->path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", cw->path);
+    free(cw->path);
+    return EXIT_FAILURE;
+  }
+
+  /* Room for the header, written last */
+  if (fwrite(h, sizeof(Cache_header), 1, cw->pf) != 1 ||
+      cache_pad(cw->pf, sizeof(Cache_header)) == EXIT_FAILURE) {
+    cache_abort(cw);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int cache_add(Cache_writer *cw, const char name[], const void *data,
+              size_t size) {
+  Cache_header *h = &cw->header;
+  Cache_section *cs;
+
+  if (h->no_sections == CACHE_SECTIONS) {
+    fprintf(stderr, " [ERROR] Too many sections in cache \"%s\"\n", cw->path);
+    return EXIT_FAILURE;
+  }
+  cs = h->section + h->no_sections++;
+  strncpy(cs->name, name, CACHE_NAME - 1);
+  cs->offset = h->file_size;
+  cs->size = size;
+  cs->checksum = cache_checksum(data, size);
+  if ((size > 0 && fwrite(data, 1, size, cw->pf) != size) ||
+      cache_pad(cw->pf, size) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Cannot write section \"%s\" of \"%s\"\n", name,
+            cw->path);
+    return EXIT_FAILURE;
+  }
+  h->file_size += cache_round(size);
+  return EXIT_SUCCESS;
+}
+
+int cache_commit(Cache_writer *cw) {
+  Cache_header *h = &cw->header;
+  char *path;
+  int err;
+
+  h->checksum = cache_header_checksum(h);
+  err = fseek(cw->pf, 0, SEEK_SET) != 0 ||
+        fwrite(h, sizeof(Cache_header), 1, cw->pf) != 1;
+  err = fclose(cw->pf) != 0 || err;
+  cw->pf = NULL;
+
+  /* path.tmp -> path */
+  path = (char *)malloc(strlen(cw->path) + 1);
+  strcpy(path, cw->path);
+  path[strlen(path) - 4] = '\0';
+  err = err || rename(cw->path, path) != 0;
+  free(path);
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write cache \"%s\"\n", cw->path);
+    cache_abort(cw);
+    return EXIT_FAILURE;
+  }
+  free(cw->path);
+  cw->path = NULL;
+  return EXIT_SUCCESS;
+}
+
+void cache_abort(Cache_writer *cw) {
+  if (cw->pf != NULL)
+    fclose(cw->pf);
+  cw->pf = NULL;
+  if (cw->path != NULL) {
+    remove(cw->path);
+    free(cw->path);
+  }
+  cw->path = NULL;
+}
+
+int cache_open(Cache *c, const char path[], const char source[],
+               int index_width, int offset_width) {
+  const Cache_header *h;
+  const Cache_section *cs;
+  struct stat st;
+  uint64_t source_size;
+  int64_t mtime, mtime_ns;
+  unsigned int i;
+  int fd;
+
+  memset(c, 0, sizeof(Cache));
+  if ((fd = open(path, O_RDONLY)) == -1)
+    return CACHE_MISSING;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Cache_header)) {
+    close(fd);
+    return CACHE_CORRUPT;
+  }
+  c->size = (size_t)st.st_size;
+  c->base = mmap(NULL, c->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (c->base == MAP_FAILED) {
+    c->base = NULL;
+    return CACHE_CORRUPT;
+  }
+  c->header = h = (const Cache_header *)c->base;
+
+  /* Header, then staleness, then the layout of the sections; their pages
+   * are only read when used */
+  if (memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+      h->checksum != cache_header_checksum(h) || h->file_size != c->size ||
+      h->no_sections > CACHE_SECTIONS) {
+    cache_close(c);
+    return CACHE_CORRUPT;
+  }
+  if (h->version != CACHE_VERSION ||
+      (index_width != 0 && h->index_width != (uint32_t)index_width) ||
+      h->offset_width != (uint32_t)offset_width ||
+      cache_source(source, &source_size, &mtime, &mtime_ns) == EXIT_FAILURE ||
+      h->source_size != source_size || h->source_mtime != mtime ||
+      h->source_mtime_ns != mtime_ns) {
+    cache_close(c);
+    return CACHE_STALE;
+  }
+  for (i = 0; i < h->no_sections; ++i) {
+    cs = h->section + i;
+    if (cs->offset % CACHE_ALIGN != 0 || cs->offset + cs->size > c->size) {
+      cache_close(c);
+      return CACHE_CORRUPT;
+    }
+  }
+  return CACHE_OK;
+}
+
+int cache_verify(const Cache *c) {
+  const Cache_section *cs;
+  unsigned int i;
+
+  for (i = 0; i < c->header->no_sections; ++i) {
+    cs = c->header->section + i;
+    if (cache_checksum((const char *)c->base + cs->offset, cs->size) !=
+        cs->checksum)
+      return CACHE_CORRUPT;
+  }
+  return CACHE_OK;
+}
+
+const void *cache_section(const Cache *c, const char name[], size_t *size) {
+  const Cache_section *cs;
+  unsigned int i;
+
+  for (i = 0; i < c->header->no_sections; ++i) {
+    cs = c->header->section + i;
+    if (strncmp(cs->name, name, CACHE_NAME) == 0) {
+      if (size != NULL)
+        *size = (size_t)cs->size;
+      return (const char *)c->base + cs->offset;
+    }
+  }
+  return NULL;
+}
+
+const void *cache_array(const Cache *c, const char name[], size_t size) {
+  const void *data;
+  size_t found;
+
+  if ((data = cache_section(c, name, &found)) == NULL || found != size)
+    return NULL;
+  return data;
+}
+
+void cache_release(const Cache *c, const char name[]) {
+  const char *data;
+  size_t size, page = (size_t)sysconf(_SC_PAGESIZE);
+
+  if ((data = (const char *)cache_section(c, name, &size)) != NULL &&
+      size > 0)
+    madvise((void *)data, (size + page - 1) / page * page, MADV_DONTNEED);
+}
+
+void cache_close(Cache *c) {
+  if (c->base != NULL)
+    munmap(c->base, c->size);
+  c->base = NULL;
+  c->header = NULL;
+  c->size = 0;
+}
+
+const char *cache_error(int err) {
+  static const char *errors[] = {"valid", "missing", "stale", "corrupted"};
+  return errors[err];
+}
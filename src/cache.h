@@ -0,0 +1,84 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Single file cache container: a header followed by named sections, each one
+ * aligned to CACHE_ALIGN bytes so that the whole file is used through one
+ * mmap. The header records the source file the cache was built from, so that
+ * a cache older than its input is rebuilt instead of being reused. */
+#define CACHE_MAGIC "IRWSGRPH"
+#define CACHE_VERSION 4
+#define CACHE_ALIGN 4096
+#define CACHE_SECTIONS 16
+#define CACHE_NAME 16
+
+/* Results of cache_open() */
+#define CACHE_OK 0
+#define CACHE_MISSING 1
+#define CACHE_STALE 2
+#define CACHE_CORRUPT 3
+
+typedef struct {
+  char name[CACHE_NAME];
+  uint64_t offset; /* from the beginning of the file */
+  uint64_t size;   /* bytes */
+  uint64_t checksum;
+} Cache_section;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t index_width; /* bytes of node ids (col_ind entries) */
+  uint64_t source_size;
+  int64_t source_mtime;
+  int64_t source_mtime_ns;
+  uint64_t file_size;
+  uint32_t no_sections;
+  uint32_t offset_width; /* bytes of edge offsets (row_ptr entries) */
+  Cache_section section[CACHE_SECTIONS];
+  uint64_t checksum; /* of the header, with this field set to 0 */
+} Cache_header;
+
+typedef struct {
+  const Cache_header *header;
+  void *base;
+  size_t size;
+} Cache;
+
+typedef struct {
+  FILE *pf;
+  char *path;
+  Cache_header header;
+} Cache_writer;
+
+/* Writing: sections are appended in order, the header is written and the
+ * file renamed into place by cache_commit(), so a crash leaves no cache */
+int cache_create(Cache_writer *cw, const char path[], const char source[],
+                 int index_width, int offset_width);
+int cache_add(Cache_writer *cw, const char name[], const void *data,
+              size_t size);
+int cache_commit(Cache_writer *cw);
+void cache_abort(Cache_writer *cw);
+
+/* Reading: maps the file and checks the header, the source file and the
+ * bounds of the sections, without reading them; a cache written with other
+ * index or offset widths is stale, index_width 0 accepting any (the caller
+ * reads it in the header) */
+int cache_open(Cache *c, const char path[], const char source[],
+               int index_width, int offset_width);
+/* Reads every section of an open cache against its checksum: CACHE_OK or
+ * CACHE_CORRUPT */
+int cache_verify(const Cache *c);
+const void *cache_section(const Cache *c, const char name[], size_t *size);
+/* Section of exactly size bytes, NULL if missing or of another size */
+const void *cache_array(const Cache *c, const char name[], size_t size);
+/* Drops the pages of a section the caller will not use from the resident set;
+ * they are read again from the file if touched later */
+void cache_release(const Cache *c, const char name[]);
+void cache_close(Cache *c);
+const char *cache_error(int err);
+
+#endif
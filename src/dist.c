@@ -0,0 +1,356 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dist.h"
+
+int dist_parse_transport(const char *name) {
+  if (strcmp(name, "shm") == 0)
+    return DIST_SHM;
+  if (strcmp(name, "socket") == 0)
+    return DIST_SOCKET;
+  return -1;
+}
+
+const char *dist_transport_name(int transport) {
+  return transport == DIST_SHM ? "shared memory" : "sockets";
+}
+
+int dist_spawn(Dist *d, int size, int transport, int no_nodes) {
+  pthread_barrierattr_t attr;
+  int *pairs = NULL;
+  size_t head;
+  pid_t pid;
+  int r, q;
+
+  memset(d, 0, sizeof(Dist));
+  d->size = size;
+  d->transport = transport;
+  d->no_nodes = no_nodes;
+  d->pids = (pid_t *)calloc(size, sizeof(pid_t));
+  d->fd = (int *)malloc(sizeof(int) * size);
+  d->out = (double *)malloc(sizeof(double) * size * DIST_SUMS);
+  d->in = (double *)malloc(sizeof(double) * size * DIST_SUMS);
+  if (d->pids == NULL || d->fd == NULL || d->out == NULL || d->in == NULL)
+    return EXIT_FAILURE;
+  for (q = 0; q < size; ++q)
+    d->fd[q] = -1;
+
+  if (transport == DIST_SHM) {
+    /* Barrier, boards and sums in one mapping inherited by the children */
+    head = (sizeof(pthread_barrier_t) + 63) / 64 * 64;
+    d->shm_size = head + sizeof(double) * 2 * ((size_t)no_nodes +
+                                               (size_t)size * DIST_SUMS);
+    if ((d->shm = mmap(NULL, d->shm_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+      d->shm = NULL;
+      return EXIT_FAILURE;
+    }
+    d->barrier = (pthread_barrier_t *)d->shm;
+    d->board = (double *)((char *)d->shm + head);
+    d->sums = d->board + 2 * (size_t)no_nodes;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    r = pthread_barrier_init(d->barrier, &attr, size);
+    pthread_barrierattr_destroy(&attr);
+    if (r != 0)
+      return EXIT_FAILURE;
+  } else {
+    /* A socket pair for every two processes, end 0 for the lower rank */
+    if ((pairs = (int *)malloc(sizeof(int) * 2 * size * size)) == NULL)
+      return EXIT_FAILURE;
+    for (r = 0; r < size; ++r)
+      for (q = r + 1; q < size; ++q)
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0,
+                       pairs + 2 * (r * size + q)) != 0) {
+          free(pairs);
+          return EXIT_FAILURE;
+        }
+  }
+
+  /* Nothing buffered is written twice */
+  fflush(stdout);
+  fflush(stderr);
+  for (r = 1; r < size; ++r) {
+    if ((pid = fork()) < 0) {
+      for (q = 1; q < r; ++q)
+        kill(d->pids[q], SIGKILL);
+      free(pairs);
+      return EXIT_FAILURE;
+    }
+    if (pid == 0) {
+      d->rank = r;
+      break;
+    }
+    d->pids[r] = pid;
+  }
+
+  if (transport == DIST_SOCKET) {
+    for (r = 0; r < size; ++r)
+      for (q = r + 1; q < size; ++q) {
+        if (d->rank == r)
+          d->fd[q] = pairs[2 * (r * size + q)];
+        else
+          close(pairs[2 * (r * size + q)]);
+        if (d->rank == q)
+          d->fd[r] = pairs[2 * (r * size + q) + 1];
+        else
+          close(pairs[2 * (r * size + q) + 1]);
+      }
+    for (q = 0; q < size; ++q)
+      if (d->fd[q] >= 0)
+        fcntl(d->fd[q], F_SETFL, fcntl(d->fd[q], F_GETFL) | O_NONBLOCK);
+    free(pairs);
+  }
+  return EXIT_SUCCESS;
+}
+
+int dist_plan(Dist *d, int *send_ptr, int *send_ind, int *send_node,
+              int *recv_ptr, int *recv_node) {
+  d->send_ptr = send_ptr;
+  d->send_ind = send_ind;
+  d->send_node = send_node;
+  d->recv_ptr = recv_ptr;
+  d->recv_node = recv_node;
+  if (d->transport == DIST_SHM)
+    return EXIT_SUCCESS;
+  free(d->out);
+  free(d->in);
+  d->out = (double *)malloc(sizeof(double) *
+                            (send_ptr[d->size] + d->size * DIST_SUMS));
+  d->in = (double *)malloc(sizeof(double) *
+                           (recv_ptr[d->size] + d->size * DIST_SUMS));
+  return d->out != NULL && d->in != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Values for or from q, none before the plan */
+static int dist_count(const int *ptr, int q) {
+  return ptr != NULL ? ptr[q + 1] - ptr[q] : 0;
+}
+
+static long dist_offset(const int *ptr, int q) {
+  return (ptr != NULL ? ptr[q] : 0) + (long)q * DIST_SUMS;
+}
+
+/* Every message of out written and every one of in read at once, as the
+ * sockets are ready, so that no two processes wait for each other; without
+ * values, the messages are the sums alone */
+static int dist_transfer(Dist *d, int values) {
+  const int *send_ptr = values ? d->send_ptr : NULL;
+  const int *recv_ptr = values ? d->recv_ptr : NULL;
+  struct pollfd pfd[DIST_MAX];
+  size_t out_len[DIST_MAX], in_len[DIST_MAX];
+  size_t sent[DIST_MAX], rcvd[DIST_MAX];
+  int peer[DIST_MAX];
+  ssize_t len;
+  int n, q, k;
+
+  for (q = 0; q < d->size; ++q) {
+    out_len[q] = sizeof(double) * (DIST_SUMS + dist_count(send_ptr, q));
+    in_len[q] = sizeof(double) * (DIST_SUMS + dist_count(recv_ptr, q));
+    sent[q] = rcvd[q] = 0;
+  }
+  for (;;) {
+    for (q = 0, n = 0; q < d->size; ++q) {
+      if (q == d->rank)
+        continue;
+      pfd[n].fd = d->fd[q];
+      pfd[n].events = (sent[q] < out_len[q] ? POLLOUT : 0) |
+                      (rcvd[q] < in_len[q] ? POLLIN : 0);
+      pfd[n].revents = 0;
+      if (pfd[n].events != 0)
+        peer[n++] = q;
+    }
+    if (n == 0)
+      return EXIT_SUCCESS;
+    if (poll(pfd, n, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return EXIT_FAILURE;
+    }
+    for (k = 0; k < n; ++k) {
+      q = peer[k];
+      if ((pfd[k].revents & POLLOUT) && sent[q] < out_len[q]) {
+        len = send(d->fd[q],
+                   (char *)(d->out + dist_offset(send_ptr, q)) + sent[q],
+                   out_len[q] - sent[q], MSG_NOSIGNAL);
+        if (len < 0 && errno != EAGAIN && errno != EINTR)
+          return EXIT_FAILURE;
+        if (len > 0)
+          sent[q] += len;
+      }
+      if ((pfd[k].revents & (POLLIN | POLLHUP | POLLERR)) &&
+          rcvd[q] < in_len[q]) {
+        len = recv(d->fd[q],
+                   (char *)(d->in + dist_offset(recv_ptr, q)) + rcvd[q],
+                   in_len[q] - rcvd[q], 0);
+        if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+          return EXIT_FAILURE; /* a process is gone */
+        if (len > 0)
+          rcvd[q] += len;
+      }
+    }
+  }
+}
+
+int dist_exchange(Dist *d, const double *x, double *halo, double *sums) {
+  double *board, *row;
+  double total;
+  long o;
+  int q, k, s;
+
+  if (d->size == 1)
+    return EXIT_SUCCESS;
+
+  if (d->transport == DIST_SHM) {
+    board = d->board + (size_t)d->parity * d->no_nodes;
+    row = d->sums + (size_t)d->parity * d->size * DIST_SUMS;
+    if (x != NULL)
+      for (k = 0; k < d->send_ptr[d->size]; ++k)
+        board[d->send_node[k]] = x[d->send_ind[k]];
+    memcpy(row + d->rank * DIST_SUMS, sums, sizeof(double) * DIST_SUMS);
+    pthread_barrier_wait(d->barrier);
+    if (x != NULL)
+      for (k = 0; k < d->recv_ptr[d->size]; ++k)
+        halo[k] = board[d->recv_node[k]];
+    for (s = 0; s < DIST_SUMS; ++s) {
+      for (q = 0, total = 0.; q < d->size; ++q)
+        total += row[q * DIST_SUMS + s];
+      sums[s] = total;
+    }
+    d->parity ^= 1;
+    return EXIT_SUCCESS;
+  }
+
+  for (q = 0; q < d->size; ++q) {
+    if (q == d->rank)
+      continue;
+    o = dist_offset(x != NULL ? d->send_ptr : NULL, q);
+    memcpy(d->out + o, sums, sizeof(double) * DIST_SUMS);
+    if (x != NULL)
+      for (k = d->send_ptr[q]; k < d->send_ptr[q + 1]; ++k)
+        d->out[o + DIST_SUMS + k - d->send_ptr[q]] = x[d->send_ind[k]];
+  }
+  if (dist_transfer(d, x != NULL) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  for (s = 0; s < DIST_SUMS; ++s) {
+    for (q = 0, total = 0.; q < d->size; ++q)
+      total += q == d->rank
+                   ? sums[s]
+                   : d->in[dist_offset(x != NULL ? d->recv_ptr : NULL, q) +
+                           s];
+    sums[s] = total;
+  }
+  if (x != NULL)
+    for (q = 0; q < d->size; ++q)
+      if (q != d->rank)
+        memcpy(halo + d->recv_ptr[q],
+               d->in + dist_offset(d->recv_ptr, q) + DIST_SUMS,
+               sizeof(double) * dist_count(d->recv_ptr, q));
+  return EXIT_SUCCESS;
+}
+
+int dist_sum(Dist *d, double *sums) {
+  return dist_exchange(d, NULL, NULL, sums);
+}
+
+/* The whole of len bytes through a nonblocking socket */
+static int dist_stream(int fd, char *buf, size_t len, int out) {
+  struct pollfd pfd;
+  ssize_t n;
+
+  while (len > 0) {
+    pfd.fd = fd;
+    pfd.events = out ? POLLOUT : POLLIN;
+    if (poll(&pfd, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return EXIT_FAILURE;
+    }
+    n = out ? send(fd, buf, len, MSG_NOSIGNAL) : recv(fd, buf, len, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+      return EXIT_FAILURE;
+    if (n > 0) {
+      buf += n;
+      len -= n;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int dist_gather(Dist *d, const double *v, const int *node_ptr,
+                const int *nodes, double *res) {
+  double *board, *buf;
+  int first = node_ptr[d->rank], n = node_ptr[d->rank + 1] - first;
+  int q, k;
+
+  if (d->transport == DIST_SHM && d->size > 1) {
+    board = d->board + (size_t)d->parity * d->no_nodes;
+    for (k = 0; k < n; ++k)
+      board[nodes[first + k]] = v[k];
+    pthread_barrier_wait(d->barrier);
+    if (d->rank == 0)
+      memcpy(res, board, sizeof(double) * d->no_nodes);
+    d->parity ^= 1;
+    return EXIT_SUCCESS;
+  }
+
+  if (d->rank > 0)
+    return dist_stream(d->fd[0], (char *)v, sizeof(double) * n, 1);
+  for (k = 0; k < n; ++k)
+    res[nodes[first + k]] = v[k];
+  for (q = 1; q < d->size; ++q) {
+    n = node_ptr[q + 1] - node_ptr[q];
+    if ((buf = (double *)malloc(sizeof(double) * (n + 1))) == NULL ||
+        dist_stream(d->fd[q], (char *)buf, sizeof(double) * n, 0) ==
+            EXIT_FAILURE) {
+      free(buf);
+      return EXIT_FAILURE;
+    }
+    for (k = 0; k < n; ++k)
+      res[nodes[node_ptr[q] + k]] = buf[k];
+    free(buf);
+  }
+  return EXIT_SUCCESS;
+}
+
+int dist_finish(Dist *d, int err) {
+  int status;
+  int q;
+
+  for (q = 0; q < d->size; ++q)
+    if (d->fd != NULL && d->fd[q] >= 0)
+      close(d->fd[q]);
+  if (d->rank > 0)
+    exit(err ? EXIT_FAILURE : EXIT_SUCCESS);
+
+  /* The mapping goes once no child uses the barrier */
+  for (q = 1; q < d->size; ++q)
+    if (d->pids[q] > 0 &&
+        (waitpid(d->pids[q], &status, 0) < 0 || !WIFEXITED(status) ||
+         WEXITSTATUS(status) != EXIT_SUCCESS))
+      err = 1;
+  if (d->shm != NULL) {
+    pthread_barrier_destroy(d->barrier);
+    munmap(d->shm, d->shm_size);
+  }
+  free(d->pids);
+  free(d->fd);
+  free(d->out);
+  free(d->in);
+  free(d->send_ptr);
+  free(d->send_ind);
+  free(d->send_node);
+  free(d->recv_ptr);
+  free(d->recv_node);
+  memset(d, 0, sizeof(Dist));
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
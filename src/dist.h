@@ -0,0 +1,68 @@
+#ifndef DIST_H
+#define DIST_H
+
+/* Group of cooperating processes, forked from the first one, each owning a
+ * part of the rows. At every exchange a process sends the values of its
+ * nodes the other parts read and receives those of the other parts it
+ * reads (its halo), together with DIST_SUMS partial sums that every process
+ * gets the totals of. The totals are added in process order, so they are the
+ * same bits everywhere and all the processes take the same decisions.
+ *
+ * The values go through shared memory, written on a board of all the nodes
+ * (one per parity of the exchange, so a single barrier per exchange
+ * suffices), or through a stream socket between every two processes, which
+ * only carry bytes and could as well connect processes on other hosts. */
+#define DIST_SHM 0
+#define DIST_SOCKET 1
+#define DIST_SUMS 4
+#define DIST_MAX 64
+
+#include <pthread.h>
+#include <sys/types.h>
+
+typedef struct {
+  int rank, size;
+  int transport;
+  int no_nodes;
+  pid_t *pids; /* of the other processes, in the first one */
+
+  /* Shared memory: 2 boards of no_nodes values and 2 rows of sums */
+  void *shm;
+  size_t shm_size;
+  double *board, *sums;
+  pthread_barrier_t *barrier;
+  int parity;
+
+  /* Sockets: to every other process, -1 for itself */
+  int *fd;
+
+  /* Plan: the values for process q are the entries [send_ptr[q],
+   * send_ptr[q + 1]) of send_ind (positions in the local vector) and of
+   * send_node (their nodes); those from q go to the halo entries
+   * [recv_ptr[q], recv_ptr[q + 1]), of nodes recv_node */
+  int *send_ptr, *send_ind, *send_node;
+  int *recv_ptr, *recv_node;
+  double *out, *in; /* sockets: messages of every process, sums first */
+} Dist;
+
+int dist_parse_transport(const char *name);
+const char *dist_transport_name(int transport);
+/* Forks size - 1 processes sharing the memory or the sockets of the group;
+ * returns in every process, with its rank */
+int dist_spawn(Dist *d, int size, int transport, int no_nodes);
+/* Takes the plan, allocated with malloc, and sets up the buffers */
+int dist_plan(Dist *d, int *send_ptr, int *send_ind, int *send_node,
+              int *recv_ptr, int *recv_node);
+/* Sends x[send_ind], receives halo, and replaces sums by their totals */
+int dist_exchange(Dist *d, const double *x, double *halo, double *sums);
+/* Totals of sums only */
+int dist_sum(Dist *d, double *sums);
+/* res of the first process gets v, the values of the nodes
+ * [node_ptr[rank], node_ptr[rank + 1]) of nodes in every process */
+int dist_gather(Dist *d, const double *v, const int *node_ptr,
+                const int *nodes, double *res);
+/* Ends the group: the other processes exit with err, the first one waits
+ * for them and returns whether all of them succeeded */
+int dist_finish(Dist *d, int err);
+
+#endif
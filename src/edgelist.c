@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "graph.h"
+#include "timer.h"
+
+/* Converter from the SNAP text format (plain, gzip or zstd) to the binary
+ * edge list that pagerank, hits and graphbuild map instead of parsing: for
+ * graphs regenerated often, the text is parsed once here. */
+int main(int argc, char *argv[]) {
+  double begin = timer_now();
+  int no_threads = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:")) != -1) {
+    switch (opt) {
+    case 't':
+      no_threads = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./edgelist [-t <threads>] <input> "
+                      "<output>\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (argc - optind != 2) {
+    fprintf(stderr, " [ERROR] *2* arguments required: ./edgelist <input> "
+                    "<output>\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (graph_convert(argv[optind], argv[optind + 1], no_threads) ==
+      EXIT_FAILURE)
+    exit(EXIT_FAILURE);
+  printf("Edge list written to \"%s\"\n", argv[optind + 1]);
+  printf("Elapsed time: %.3fs\n", timer_now() - begin);
+  exit(EXIT_SUCCESS);
+}
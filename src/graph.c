@@ -0,0 +1,1283 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "graph.h"
+#include "idmap.h"
+#include "mem.h"
+#include "queue.h"
+
+static int graph_quiet;
+
+void graph_set_quiet(int quiet) { graph_quiet = quiet; }
+
+/* Progress of the build, on stdout unless quiet */
+static void graph_log(const char *format, ...) {
+  va_list args;
+
+  if (graph_quiet)
+    return;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+}
+
+static void graph_phase(Phase_timer *timer, Perf_profile *prof,
+                        const char phase[]) {
+  if (timer != NULL)
+    timer_stop(timer, phase);
+  if (prof != NULL)
+    perf_profile_stop(prof, phase, 0.);
+}
+
+void graph_name(const char input[], char name[]) {
+  const char *base = strrchr(input, '/');
+  char *dot;
+
+  strncpy(name, base != NULL ? base + 1 : input, GRAPH_NAME - 1);
+  name[GRAPH_NAME - 1] = '\0';
+  if ((dot = strrchr(name, '.')) != NULL &&
+      (strcmp(dot, ".gz") == 0 || strcmp(dot, ".zst") == 0))
+    *dot = '\0';
+  if ((dot = strrchr(name, '.')) != NULL && dot != name)
+    *dot = '\0';
+}
+
+void graph_path(const char name[], const char suffix[], char path[]) {
+  sprintf(path, "%s%s", name, suffix);
+}
+
+/* Exclusive prefix sum of count[0..n) into ptr[0..n] */
+static void graph_prefix(const int *count, int n, long *ptr) {
+  int i;
+
+  ptr[0] = 0;
+  for (i = 0; i < n; ++i)
+    ptr[i + 1] = ptr[i] + count[i];
+}
+
+/* Copy of n node ids narrowed to 16 bits */
+static unsigned short *graph_narrow(const int *ind, long n) {
+  unsigned short *narrow;
+  long k;
+
+  if ((narrow = (unsigned short *)malloc(sizeof(unsigned short) *
+                                         (n > 0 ? n : 1))) == NULL)
+    return NULL;
+  for (k = 0; k < n; ++k)
+    narrow[k] = (unsigned short)ind[k];
+  return narrow;
+}
+
+/* Locality-friendly numbering of the dense nodes: decreasing total degree,
+ * so that the ranks of the hubs, read by most rows, share cache lines, with
+ * ties in id order. Dangling nodes come after all the others, so that PageRank
+ * can leave them out of its iterations. Returns the new number of every node
+ * (malloc'd). */
+static long graph_key(const int *out_deg, const int *in_deg, long max_deg,
+                      int i) {
+  return max_deg - out_deg[i] - in_deg[i] +
+         (out_deg[i] == 0 ? max_deg + 1 : 0);
+}
+
+static int *graph_order(const int *out_deg, const int *in_deg, int n) {
+  int *order;
+  long *bucket;
+  long max_deg = 0;
+  long i;
+
+  for (i = 0; i < n; ++i)
+    if ((long)out_deg[i] + in_deg[i] > max_deg)
+      max_deg = (long)out_deg[i] + in_deg[i];
+  order = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+  bucket = (long *)calloc(2 * max_deg + 3, sizeof(long));
+  if (order == NULL || bucket == NULL) {
+    free(order);
+    free(bucket);
+    return NULL;
+  }
+  /* Counting sort, bucket 0 holding the largest degree */
+  for (i = 0; i < n; ++i)
+    ++bucket[graph_key(out_deg, in_deg, max_deg, i) + 1];
+  for (i = 1; i <= 2 * max_deg + 2; ++i)
+    bucket[i] += bucket[i - 1];
+  for (i = 0; i < n; ++i)
+    order[i] = (int)bucket[graph_key(out_deg, in_deg, max_deg, i)]++;
+  free(bucket);
+  return order;
+}
+
+/* Compressed inputs, told apart by their magic numbers: gzip is inflated by
+ * zlib behind a stdio stream, in the thread reading it, and zstd by the zstd
+ * tool in a child process writing to a pipe. Either way the reader thread of
+ * the pipeline gets plain text while the team parses the previous blocks. */
+static ssize_t graph_gz_read(void *cookie, char *buf, size_t size) {
+  return gzread((gzFile)cookie, buf, size > INT_MAX ? INT_MAX : size);
+}
+
+static int graph_gz_close(void *cookie) {
+  return gzclose_r((gzFile)cookie) == Z_OK ? 0 : -1;
+}
+
+static FILE *graph_fopen(const char input[], pid_t *pid) {
+  static const unsigned char gz_magic[] = {0x1f, 0x8b};
+  static const unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+  cookie_io_functions_t gz_io = {graph_gz_read, NULL, NULL, graph_gz_close};
+  unsigned char magic[4] = {0};
+  FILE *pf;
+  gzFile gz;
+  int fd[2];
+
+  *pid = -1;
+  if ((pf = fopen(input, "r")) == NULL)
+    return NULL;
+  if (fread(magic, 1, sizeof(magic), pf) < sizeof(gz_magic) ||
+      (memcmp(magic, gz_magic, sizeof(gz_magic)) != 0 &&
+       memcmp(magic, zstd_magic, sizeof(zstd_magic)) != 0)) {
+    rewind(pf);
+    return pf;
+  }
+  fclose(pf);
+
+  if (magic[0] == gz_magic[0]) {
+    if ((gz = gzopen(input, "rb")) == NULL)
+      return NULL;
+    gzbuffer(gz, 1 << 17);
+    if ((pf = fopencookie(gz, "r", gz_io)) == NULL)
+      gzclose_r(gz);
+    return pf;
+  }
+
+  if (pipe(fd) != 0)
+    return NULL;
+  if ((*pid = fork()) == -1) {
+    close(fd[0]);
+    close(fd[1]);
+    return NULL;
+  }
+  if (*pid == 0) {
+    dup2(fd[1], STDOUT_FILENO);
+    close(fd[0]);
+    close(fd[1]);
+    /* Only async-signal-safe calls after fork(): a failed exec is told by
+     * its status */
+    execlp("zstd", "zstd", "-dcq", "--", input, (char *)NULL);
+    _exit(127);
+  }
+  close(fd[1]);
+  if ((pf = fdopen(fd[0], "r")) == NULL)
+    close(fd[0]);
+  return pf;
+}
+
+/* Closes an input opened by graph_fopen(), failing if its decompression did;
+ * a zstd closed before the end of its output fails with SIGPIPE */
+static int graph_fclose(FILE *pf, pid_t pid, const char input[]) {
+  int status;
+  int err = fclose(pf) != 0;
+
+  if (pid > 0) {
+    if (waitpid(pid, &status, 0) != pid)
+      err = 1;
+    else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+        fprintf(stderr, " [ERROR] Cannot run zstd to decompress \"%s\", is "
+                        "it on the PATH?\n",
+                input);
+      err = 1;
+    }
+  }
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Ingestion pipeline: a reader thread cuts the input into blocks of whole
+ * lines and the team parses them. The edges of the blocks are stored in input
+ * order by taking turns on a ticket, which only reserves their slots: each
+ * thread then copies its edges and counts the degrees on its own. */
+#define GRAPH_BLOCK (1 << 20)
+#define GRAPH_CONVERT_CHUNK (1 << 16)
+
+typedef struct {
+  char *text;
+  size_t len;
+  long seq;
+} Graph_block;
+
+/* Edge whose ids do not fit in 32 bits */
+typedef struct {
+  long k;
+  uint64_t src, dst;
+} Graph_wide;
+
+typedef struct {
+  FILE *pf;
+  Queue empty, full;      /* blocks to fill and to parse */
+  uint32_t *from, *to;    /* 4 bytes per id, so 8 per edge */
+  uint64_t *from64, *to64; /* instead, if some ids are wider */
+  Graph_wide *wide;       /* edges with wider ids, until widened */
+  long no_wide, max_wide;
+  pthread_mutex_t lock;
+  long no_edges;          /* at most, from the header */
+  long header_nodes;      /* degrees are counted for the ids below */
+  int *out_deg, *in_deg;
+  volatile long next_seq; /* block whose edges are stored next */
+  volatile long e;        /* edges stored */
+  volatile int stop;      /* more edges than no_edges, a reserved id or no
+                           * memory */
+  volatile long bad_edge; /* first edge with a reserved id, or -1 */
+  long no_malformed;      /* lines that do not start with two ids */
+  long malformed;         /* edges before the first of them, or -1 */
+  volatile int too_many;  /* more edges than the header has */
+  volatile int no_memory; /* for the reader or the edges with wider ids */
+  const char *pairs;      /* binary input: the mapped pairs of ids */
+  int id_width;           /* bytes of the ids of pairs */
+  int no_threads;
+  uint64_t *max_id;       /* per thread */
+  uint64_t **buf;         /* per thread, both ids of the edges of a block,
+                           * which has lines of 4 bytes at least */
+} Graph_ingest;
+
+static void *graph_read(void *arg) {
+  Graph_ingest *in = (Graph_ingest *)arg;
+  Graph_block *b;
+  char *carry = (char *)malloc(GRAPH_BLOCK);
+  size_t no_carry = 0, bytes;
+  long seq = 0;
+  int last;
+
+  if (carry == NULL) {
+    in->no_memory = 1;
+    in->stop = 1;
+  }
+  while (!in->stop && (b = (Graph_block *)queue_pop(&in->empty)) != NULL) {
+    /* The partial last line of the previous block comes first, and this
+     * block keeps its own for the next one */
+    memcpy(b->text, carry, no_carry);
+    bytes = fread(b->text + no_carry, 1, GRAPH_BLOCK - no_carry, in->pf);
+    b->len = no_carry + bytes;
+    b->seq = seq++;
+    last = feof(in->pf) || ferror(in->pf);
+    no_carry = 0;
+    if (!last) {
+      while (no_carry < b->len && b->text[b->len - no_carry - 1] != '\n')
+        ++no_carry;
+      if (no_carry == b->len)
+        no_carry = 0;
+      b->len -= no_carry;
+      memcpy(carry, b->text + b->len, no_carry);
+    }
+    b->text[b->len] = '\0';
+    queue_push(&in->full, b);
+    if (last)
+      break;
+  }
+  queue_close(&in->full);
+  free(carry);
+  return NULL;
+}
+
+/* Edges of a block into buf, as sscanf("%lu %lu") reads them on every line;
+ * *bad gets the first one with a reserved id, or -1. Blank lines and lines
+ * from '#' are skipped; the others without two ids are counted in
+ * *no_malformed, and *malformed gets the edges before the first, or -1. */
+static long graph_parse_block(Graph_block *b, uint64_t *buf, long *bad,
+                              long *no_malformed, long *malformed) {
+  char *s = b->text, *end = b->text + b->len;
+  char *eol, *p, *q;
+  unsigned long src, dst;
+  long n = 0;
+
+  *bad = -1;
+  *no_malformed = 0;
+  *malformed = -1;
+  for (; s < end; s = eol + 1) {
+    if ((eol = (char *)memchr(s, '\n', end - s)) == NULL)
+      eol = end;
+    *eol = '\0';
+    for (p = s; *p == ' ' || *p == '\t' || *p == '\r'; ++p)
+      ;
+    if (*p == '\0' || *p == '#')
+      continue;
+    src = strtoul(s, &p, 10);
+    q = p;
+    if (p != s)
+      dst = strtoul(p, &q, 10);
+    if (q == p) {
+      if ((*no_malformed)++ == 0)
+        *malformed = n;
+      continue;
+    }
+    if ((src == IDMAP_EMPTY || dst == IDMAP_EMPTY) && *bad < 0)
+      *bad = n;
+    buf[2 * n] = src;
+    buf[2 * n + 1] = dst;
+    ++n;
+  }
+  return n;
+}
+
+/* Edge k, with the degrees of the ids below header_nodes. Ids wider than 32
+ * bits are kept aside, for the few inputs that have them. */
+static void graph_store(Graph_ingest *in, long k, uint64_t src,
+                        uint64_t dst) {
+  Graph_wide *wide;
+
+  if (src > UINT32_MAX || dst > UINT32_MAX) {
+    pthread_mutex_lock(&in->lock);
+    if (in->no_wide == in->max_wide) {
+      in->max_wide = in->max_wide > 0 ? 2 * in->max_wide : 1024;
+      if ((wide = (Graph_wide *)realloc(
+               in->wide, sizeof(Graph_wide) * in->max_wide)) == NULL) {
+        in->max_wide = in->no_wide;
+        in->no_memory = 1;
+        in->stop = 1;
+      } else
+        in->wide = wide;
+    }
+    if (in->no_wide < in->max_wide) {
+      in->wide[in->no_wide].k = k;
+      in->wide[in->no_wide].src = src;
+      in->wide[in->no_wide].dst = dst;
+      ++in->no_wide;
+    }
+    pthread_mutex_unlock(&in->lock);
+    in->from[k] = 0;
+    in->to[k] = 0;
+    return;
+  }
+  in->from[k] = (uint32_t)src;
+  in->to[k] = (uint32_t)dst;
+  if (src < (uint64_t)in->header_nodes)
+    __sync_fetch_and_add(in->out_deg + src, 1);
+  if (dst < (uint64_t)in->header_nodes)
+    __sync_fetch_and_add(in->in_deg + dst, 1);
+}
+
+static void graph_parse_task(int tid, void *arg) {
+  Graph_ingest *in = (Graph_ingest *)arg;
+  Graph_block *b;
+  uint64_t *buf = in->buf[tid];
+  uint64_t max_id = 0;
+  uint64_t src, dst;
+  long n, bad, no_malformed, malformed, base, k;
+
+  while ((b = (Graph_block *)queue_pop(&in->full)) != NULL) {
+    bad = -1;
+    no_malformed = 0;
+    malformed = -1;
+    n = in->stop ? 0
+                 : graph_parse_block(b, buf, &bad, &no_malformed, &malformed);
+
+    /* Reserving the slots of the edges once the previous blocks have */
+    while (in->next_seq != b->seq)
+      sched_yield();
+    base = in->e;
+    if (in->stop)
+      n = no_malformed = 0;
+    if (no_malformed > 0 && in->no_malformed == 0)
+      in->malformed = base + malformed;
+    in->no_malformed += no_malformed;
+    if (n > in->no_edges - base) {
+      in->too_many = 1;
+      in->stop = 1;
+      n = in->no_edges - base;
+    }
+    if (bad >= 0 && bad < n) {
+      in->bad_edge = base + bad;
+      in->stop = 1;
+      n = bad;
+    }
+    in->e = base + n;
+    if (n > 0)
+      graph_log("\rEdge %ld/%ld", in->e, in->no_edges);
+    __sync_synchronize();
+    in->next_seq = b->seq + 1;
+
+    for (k = 0; k < n; ++k) {
+      src = buf[2 * k];
+      dst = buf[2 * k + 1];
+      graph_store(in, base + k, src, dst);
+      if (src > max_id)
+        max_id = src;
+      if (dst > max_id)
+        max_id = dst;
+    }
+    queue_push(&in->empty, b);
+  }
+  in->max_id[tid] = max_id;
+}
+
+/* Reads the edges that follow the header of in->pf */
+static int graph_ingest(Graph_ingest *in, Team *team) {
+  Graph_block *blocks;
+  pthread_t reader;
+  int no_threads = team_size(team);
+  int no_blocks = 2 * no_threads + 2;
+  int err;
+  int t;
+
+  in->next_seq = 0;
+  in->e = 0;
+  in->stop = 0;
+  in->buf = (uint64_t **)calloc(no_threads, sizeof(uint64_t *));
+  blocks = (Graph_block *)calloc(no_blocks, sizeof(Graph_block));
+  err = in->buf == NULL || blocks == NULL ||
+        queue_create(&in->empty, no_blocks) == EXIT_FAILURE ||
+        queue_create(&in->full, no_blocks) == EXIT_FAILURE;
+  for (t = 0; t < no_threads && !err; ++t)
+    err = (in->buf[t] = (uint64_t *)malloc(sizeof(uint64_t) *
+                                           (GRAPH_BLOCK / 2 + 2))) == NULL;
+  for (t = 0; t < no_blocks && !err; ++t) {
+    err = (blocks[t].text = (char *)malloc(GRAPH_BLOCK + 1)) == NULL;
+    if (!err)
+      queue_push(&in->empty, blocks + t);
+  }
+
+  if (!err && pthread_create(&reader, NULL, graph_read, in) == 0) {
+    team_run(team, graph_parse_task, in);
+    pthread_join(reader, NULL);
+  } else
+    err = 1;
+
+  for (t = 0; t < no_blocks && blocks != NULL; ++t)
+    free(blocks[t].text);
+  for (t = 0; t < no_threads && in->buf != NULL; ++t)
+    free(in->buf[t]);
+  free(blocks);
+  free(in->buf);
+  queue_free(&in->empty);
+  queue_free(&in->full);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Arrays of the edges and of the degrees of the ids below header_nodes */
+static int graph_alloc_edges(Graph_ingest *in, int no_threads) {
+  long m = in->no_edges > 0 ? in->no_edges : 1;
+
+  in->no_threads = no_threads;
+  pthread_mutex_init(&in->lock, NULL);
+  in->from = (uint32_t *)malloc(sizeof(uint32_t) * m);
+  in->to = (uint32_t *)malloc(sizeof(uint32_t) * m);
+  in->out_deg = (int *)calloc(in->header_nodes + 1, sizeof(int));
+  in->in_deg = (int *)calloc(in->header_nodes + 1, sizeof(int));
+  in->max_id = (uint64_t *)calloc(no_threads, sizeof(uint64_t));
+  return in->from == NULL || in->to == NULL || in->out_deg == NULL ||
+                 in->in_deg == NULL || in->max_id == NULL
+             ? EXIT_FAILURE
+             : EXIT_SUCCESS;
+}
+
+static void graph_free_edges(Graph_ingest *in) {
+  free(in->from);
+  free(in->to);
+  free(in->from64);
+  free(in->to64);
+  free(in->wide);
+  free(in->out_deg);
+  free(in->in_deg);
+  free(in->max_id);
+  in->from = in->to = NULL;
+  in->from64 = in->to64 = NULL;
+  in->wide = NULL;
+  in->out_deg = in->in_deg = NULL;
+  in->max_id = NULL;
+}
+
+/* 64-bit edges, once some ids turn out wider than 32 bits: the arrays are
+ * widened in place, from the last edge down */
+static int graph_widen(Graph_ingest *in) {
+  long m = in->e > 0 ? in->e : 1;
+  long k;
+
+  if ((in->from64 = (uint64_t *)realloc(in->from, sizeof(uint64_t) * m)) ==
+      NULL)
+    return EXIT_FAILURE;
+  in->from = NULL;
+  if ((in->to64 = (uint64_t *)realloc(in->to, sizeof(uint64_t) * m)) == NULL)
+    return EXIT_FAILURE;
+  in->to = NULL;
+  for (k = in->e - 1; k >= 0; --k) {
+    in->from64[k] = ((uint32_t *)in->from64)[k];
+    in->to64[k] = ((uint32_t *)in->to64)[k];
+  }
+  for (k = 0; k < in->no_wide; ++k)
+    if (in->wide[k].k < in->e) {
+      in->from64[in->wide[k].k] = in->wide[k].src;
+      in->to64[in->wide[k].k] = in->wide[k].dst;
+    }
+  free(in->wide);
+  in->wide = NULL;
+  return EXIT_SUCCESS;
+}
+
+static int graph_load_text(const char input[], Graph_ingest *in, Team *team) {
+  FILE *pf;
+  pid_t pid;
+  char *s = NULL;
+  size_t slen = 0;
+  ssize_t bytes;
+  int err;
+
+  if ((pf = graph_fopen(input, &pid)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot open input file \"%s\"\n", input);
+    return EXIT_FAILURE;
+  }
+
+  /* Parsing input file header */
+  graph_log("Parsing input data...\n");
+  bytes = getline(&s, &slen, pf);
+  bytes = getline(&s, &slen, pf);
+  bytes = getline(&s, &slen, pf);
+  if (bytes == -1 || sscanf(s, "# Nodes: %ld Edges: %ld", &in->header_nodes,
+                            &in->no_edges) != 2) {
+    /* A stream that ends before the header may be a failed decompression;
+     * a bad header line closes zstd early, which fails too */
+    if (graph_fclose(pf, pid, input) == EXIT_FAILURE && bytes == -1)
+      fprintf(stderr, " [ERROR] \"%s\" could not be read\n", input);
+    else
+      fprintf(stderr,
+              " [ERROR] \"%s\" has no \"# Nodes: N Edges: E\" line\n",
+              input);
+    free(s);
+    return EXIT_FAILURE;
+  }
+  if (in->header_nodes < 0 || in->header_nodes > GRAPH_MAX_NODES ||
+      in->no_edges < 0) {
+    fprintf(stderr, " [ERROR] \"%s\" has %ld nodes and %ld edges, node ids "
+                    "must fit in %d bits\n",
+            input, in->header_nodes, in->no_edges, 8 * GRAPH_INDEX_WIDTH);
+    graph_fclose(pf, pid, input);
+    free(s);
+    return EXIT_FAILURE;
+  }
+  graph_log("This graph has %ld nodes and %ld edges\n", in->header_nodes,
+            in->no_edges);
+  free(s);
+
+  in->pf = pf;
+  err = graph_alloc_edges(in, team_size(team)) == EXIT_FAILURE ||
+        graph_ingest(in, team) == EXIT_FAILURE || ferror(pf);
+  /* The input is read to its end, unless the parse stopped on an error that
+   * graph_load() reports; zstd then fails with SIGPIPE */
+  err = (graph_fclose(pf, pid, input) == EXIT_FAILURE && !in->stop) || err;
+  if (err) {
+    fprintf(stderr, " [ERROR] \"%s\" could not be read\n", input);
+    return EXIT_FAILURE;
+  }
+  graph_log("\rEdge %ld/%ld\n", in->e, in->no_edges);
+  return EXIT_SUCCESS;
+}
+
+/* Lowest edge with a reserved id */
+static void graph_bad_edge(Graph_ingest *in, long k) {
+  long cur;
+
+  while (((cur = in->bad_edge) < 0 || k < cur) &&
+         !__sync_bool_compare_and_swap(&in->bad_edge, cur, k))
+    ;
+}
+
+/* Drops the mapped pages inside [lo, hi) from the resident set; they are read
+ * again from the file if touched later */
+static void graph_drop(const char *lo, const char *hi) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t a = ((size_t)lo + page - 1) / page * page;
+  size_t b = (size_t)hi / page * page;
+
+  if (a < b)
+    madvise((void *)a, b - a, MADV_DONTNEED);
+}
+
+static void graph_copy_task(int tid, void *arg) {
+  Graph_ingest *in = (Graph_ingest *)arg;
+  const uint32_t *pairs32 = (const uint32_t *)in->pairs;
+  const uint64_t *pairs64 = (const uint64_t *)in->pairs;
+  long lo = in->no_edges * tid / in->no_threads;
+  long hi = in->no_edges * (tid + 1) / in->no_threads;
+  long pair = 2 * in->id_width;
+  uint64_t max_id = 0;
+  uint64_t src, dst;
+  long k;
+
+  for (k = lo; k < hi; ++k) {
+    /* The pairs already copied do not need to stay resident */
+    if (k > lo && (k - lo) % GRAPH_CONVERT_CHUNK == 0)
+      graph_drop(in->pairs + pair * (k - GRAPH_CONVERT_CHUNK),
+                 in->pairs + pair * k);
+    if (in->id_width == 4) {
+      src = pairs32[2 * k];
+      dst = pairs32[2 * k + 1];
+    } else {
+      src = pairs64[2 * k];
+      dst = pairs64[2 * k + 1];
+    }
+    if (src == IDMAP_EMPTY || dst == IDMAP_EMPTY) {
+      graph_bad_edge(in, k);
+      break;
+    }
+    graph_store(in, k, src, dst);
+    if (src > max_id)
+      max_id = src;
+    if (dst > max_id)
+      max_id = dst;
+  }
+  in->max_id[tid] = max_id;
+}
+
+/* Binary edge list: mapped and copied by all the threads at once */
+static int graph_load_binary(const char input[], Graph_ingest *in,
+                             Team *team) {
+  Graph_edges_header h;
+  struct stat st;
+  void *map = MAP_FAILED;
+  int fd;
+
+  graph_log("Mapping binary edge list...\n");
+  if ((fd = open(input, O_RDONLY)) == -1 || fstat(fd, &st) != 0 ||
+      pread(fd, &h, sizeof(h), 0) != sizeof(h)) {
+    fprintf(stderr, " [ERROR] \"%s\" could not be read\n", input);
+    if (fd != -1)
+      close(fd);
+    return EXIT_FAILURE;
+  }
+  if (h.version != GRAPH_EDGES_VERSION ||
+      (h.id_width != 4 && h.id_width != 8) ||
+      h.no_nodes > (uint64_t)GRAPH_MAX_NODES ||
+      h.no_edges > (LONG_MAX - sizeof(h)) / (2 * h.id_width) ||
+      (uint64_t)st.st_size < sizeof(h) + 2 * h.id_width * h.no_edges) {
+    fprintf(stderr, " [ERROR] \"%s\" is not a valid binary edge list\n",
+            input);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  in->header_nodes = (long)h.no_nodes;
+  in->no_edges = (long)h.no_edges;
+  in->id_width = (int)h.id_width;
+  graph_log("This graph has %ld nodes and %ld edges\n", in->header_nodes,
+            in->no_edges);
+  if (in->no_edges > 0 &&
+      (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+          MAP_FAILED) {
+    fprintf(stderr, " [ERROR] Cannot map \"%s\"\n", input);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  close(fd);
+
+  if (graph_alloc_edges(in, team_size(team)) == EXIT_FAILURE) {
+    if (map != MAP_FAILED)
+      munmap(map, st.st_size);
+    return EXIT_FAILURE;
+  }
+  if (map != MAP_FAILED) {
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    in->pairs = (const char *)map + sizeof(h);
+    team_run(team, graph_copy_task, in);
+    munmap(map, st.st_size);
+  }
+  in->e = in->no_edges;
+  return EXIT_SUCCESS;
+}
+
+static int graph_is_binary(const char input[]) {
+  char magic[sizeof(GRAPH_EDGES_MAGIC) - 1];
+  FILE *pf;
+  int binary;
+
+  if ((pf = fopen(input, "rb")) == NULL)
+    return 0;
+  binary = fread(magic, 1, sizeof(magic), pf) == sizeof(magic) &&
+           memcmp(magic, GRAPH_EDGES_MAGIC, sizeof(magic)) == 0;
+  fclose(pf);
+  return binary;
+}
+
+/* Edges of a text or binary input, and the largest id in *max_id */
+static int graph_load(const char input[], Graph_ingest *in, Team *team,
+                      uint64_t *max_id) {
+  int err;
+  int t;
+
+  memset(in, 0, sizeof(Graph_ingest));
+  in->bad_edge = -1;
+  in->malformed = -1;
+  if (graph_is_binary(input))
+    err = graph_load_binary(input, in, team) == EXIT_FAILURE;
+  else
+    err = graph_load_text(input, in, team) == EXIT_FAILURE;
+  if (!err && in->bad_edge >= 0) {
+    fprintf(stderr, " [ERROR] Edge %ld of \"%s\" has node id %lu, which is "
+                    "reserved\n",
+            in->bad_edge, input, (unsigned long)IDMAP_EMPTY);
+    err = 1;
+  }
+  if (!err && in->no_malformed > 0) {
+    fprintf(stderr, " [ERROR] \"%s\" has %ld malformed lines, the first after "
+                    "edge %ld\n",
+            input, in->no_malformed, in->malformed);
+    err = 1;
+  }
+  if (!err && in->too_many) {
+    fprintf(stderr, " [ERROR] \"%s\" has more edges than the %ld of its "
+                    "header\n",
+            input, in->no_edges);
+    err = 1;
+  }
+  if (!err && (in->no_memory ||
+               (in->no_wide > 0 && graph_widen(in) == EXIT_FAILURE))) {
+    fprintf(stderr, " [ERROR] Not enough memory for the edges of \"%s\"\n",
+            input);
+    err = 1;
+  }
+  if (!err && in->e < in->no_edges)
+    fprintf(stderr, " [WARNING] \"%s\" has %ld edges, fewer than the %ld of "
+                    "its header\n",
+            input, in->e, in->no_edges);
+  if (in->no_threads > 0)
+    pthread_mutex_destroy(&in->lock);
+  if (err) {
+    graph_free_edges(in);
+    return EXIT_FAILURE;
+  }
+  for (t = 0, *max_id = 0; t < in->no_threads; ++t)
+    if (in->max_id[t] > *max_id)
+      *max_id = in->max_id[t];
+  return EXIT_SUCCESS;
+}
+
+/* Dense numbers of the ids of the edges: the ids themselves when they fall in
+ * the node count of the header (isolated nodes included), else the rank of
+ * every distinct id, found through a parallel hash map. Sets *sorted to the
+ * distinct ids in the second case. The numbers are left in the 32-bit edge
+ * arrays. */
+static int graph_number(Graph_ingest *in, uint64_t max_id, Team *team,
+                        int *no_nodes, uint64_t **sorted) {
+  Id_map map;
+  void *from = in->from64 != NULL ? (void *)in->from64 : (void *)in->from;
+  void *to = in->from64 != NULL ? (void *)in->to64 : (void *)in->to;
+  int width = in->from64 != NULL ? sizeof(uint64_t) : sizeof(uint32_t);
+  uint32_t *ids;
+  long k;
+  int err;
+
+  *sorted = NULL;
+  if (in->e == 0 || max_id < (uint64_t)in->header_nodes) {
+    *no_nodes = (int)in->header_nodes;
+    return EXIT_SUCCESS;
+  }
+  if (idmap_create(&map, in->header_nodes) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  err = idmap_insert(&map, team, from, width, in->e) == EXIT_FAILURE ||
+        idmap_insert(&map, team, to, width, in->e) == EXIT_FAILURE ||
+        (*sorted = idmap_number(&map, team)) == NULL;
+  if (!err) {
+    idmap_translate(&map, team, from, width, in->e);
+    idmap_translate(&map, team, to, width, in->e);
+    *no_nodes = (int)map.no_ids;
+  } else if (map.no_ids > GRAPH_MAX_NODES)
+    fprintf(stderr, " [ERROR] %ld distinct node ids, at most %ld are "
+                    "supported\n",
+            map.no_ids, GRAPH_MAX_NODES);
+  idmap_free(&map);
+
+  /* Back to 4 bytes per id, in place, from the first edge up; the arrays
+   * keep their size if they cannot shrink */
+  if (!err && in->from64 != NULL) {
+    for (k = 0; k < in->e; ++k) {
+      ((uint32_t *)in->from64)[k] = (uint32_t)in->from64[k];
+      ((uint32_t *)in->to64)[k] = (uint32_t)in->to64[k];
+    }
+    in->from = (uint32_t *)in->from64;
+    in->to = (uint32_t *)in->to64;
+    in->from64 = in->to64 = NULL;
+    if ((ids = (uint32_t *)realloc(in->from, sizeof(uint32_t) * in->e)) !=
+        NULL)
+      in->from = ids;
+    if ((ids = (uint32_t *)realloc(in->to, sizeof(uint32_t) * in->e)) !=
+        NULL)
+      in->to = ids;
+  }
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int graph_convert(const char input[], const char output[], int no_threads) {
+  Graph_ingest in;
+  Graph_edges_header h;
+  Team *team;
+  FILE *pf;
+  uint64_t *buf;
+  uint32_t *buf32;
+  uint64_t max_id;
+  long k, n, i;
+  int err;
+
+  if ((team = team_create(no_threads, 0)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot start %d threads\n", no_threads);
+    return EXIT_FAILURE;
+  }
+  err = graph_load(input, &in, team, &max_id) == EXIT_FAILURE;
+  team_destroy(team);
+  if (err)
+    return EXIT_FAILURE;
+
+  /* 32-bit ids unless some id needs more */
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, GRAPH_EDGES_MAGIC, sizeof(h.magic));
+  h.version = GRAPH_EDGES_VERSION;
+  h.id_width = in.from64 == NULL ? 4 : 8;
+  h.no_nodes = (uint64_t)in.header_nodes;
+  h.no_edges = (uint64_t)in.e;
+  graph_log("Writing %ld edges with %u-bit ids...\n", in.e, 8 * h.id_width);
+
+  buf = (uint64_t *)malloc(sizeof(uint64_t) * 2 * GRAPH_CONVERT_CHUNK);
+  buf32 = (uint32_t *)buf;
+  if ((pf = fopen(output, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", output);
+    err = 1;
+  } else
+    err = buf == NULL || fwrite(&h, sizeof(h), 1, pf) != 1;
+  for (k = 0; k < in.e && !err; k += n) {
+    n = in.e - k < GRAPH_CONVERT_CHUNK ? in.e - k : GRAPH_CONVERT_CHUNK;
+    for (i = 0; i < n; ++i)
+      if (h.id_width == 4) {
+        buf32[2 * i] = in.from[k + i];
+        buf32[2 * i + 1] = in.to[k + i];
+      } else {
+        buf[2 * i] = in.from64[k + i];
+        buf[2 * i + 1] = in.to64[k + i];
+      }
+    err = fwrite(buf, h.id_width, 2 * n, pf) != (size_t)(2 * n);
+  }
+  if (pf != NULL && (fclose(pf) != 0 || err)) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", output);
+    remove(output);
+    err = 1;
+  }
+  free(buf);
+  graph_free_edges(&in);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Sections are handed to a writer thread as soon as they are final, so that
+ * writing the cache overlaps the rest of the build */
+typedef struct {
+  const char *name;
+  void *data;
+  size_t size;
+  int owned; /* freed once written */
+} Graph_section;
+
+typedef struct {
+  Cache_writer cw;
+  Queue sections;
+  int err;
+} Graph_writer;
+
+static void *graph_write(void *arg) {
+  Graph_writer *w = (Graph_writer *)arg;
+  Graph_section *s;
+
+  while ((s = (Graph_section *)queue_pop(&w->sections)) != NULL) {
+    if (!w->err &&
+        cache_add(&w->cw, s->name, s->data, s->size) == EXIT_FAILURE)
+      w->err = 1;
+    if (s->owned)
+      free(s->data);
+    free(s);
+  }
+  return NULL;
+}
+
+/* Queues a section for the writer; without memory, an owned section is freed
+ * and EXIT_FAILURE returned */
+static int graph_post(Graph_writer *w, const char name[], void *data,
+                      size_t size, int owned) {
+  Graph_section *s = (Graph_section *)malloc(sizeof(Graph_section));
+
+  if (s == NULL) {
+    if (owned)
+      free(data);
+    return EXIT_FAILURE;
+  }
+  s->name = name;
+  s->data = data;
+  s->size = size;
+  s->owned = owned;
+  queue_push(&w->sections, s);
+  return EXIT_SUCCESS;
+}
+
+int graph_build(const char input[], const char path[], int no_threads,
+                Phase_timer *timer, Perf_profile *prof) {
+  Graph_ingest in;
+  Graph_writer w;
+  pthread_t writer;
+  Team *team;
+  Graph_data data;
+  double begin = timer_now();
+  uint32_t *from, *to, t;
+  uint64_t *ids, *sorted;
+  uint64_t max_id;
+  long *row_ptr, *row_ptr_t, *pos;
+  int *col_ind, *col_ind_t;
+  void *ind, *ind_t;
+  int *out_deg, *in_deg, *danglings, *order, *deg;
+  long no_edges;
+  long k;
+  int no_nodes;
+  int index_width;
+  int i, j;
+  int err;
+
+  /* Reading data from input file: ids of any value below 2^64 - 1, numbered
+   * once all of them are known */
+  if ((team = team_create(no_threads, 0)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot start %d threads\n", no_threads);
+    return EXIT_FAILURE;
+  }
+  if (graph_load(input, &in, team, &max_id) == EXIT_FAILURE) {
+    team_destroy(team);
+    return EXIT_FAILURE;
+  }
+  out_deg = in.out_deg;
+  in_deg = in.in_deg;
+  no_edges = in.e;
+  free(in.max_id);
+  graph_log("Done\n\n");
+  graph_phase(timer, prof, "parse");
+
+  /* Dense and then locality-friendly node numbers, the degrees of dense ids
+   * being counted while parsing */
+  graph_log("Numbering nodes...\n");
+  err = graph_number(&in, max_id, team, &no_nodes, &sorted) == EXIT_FAILURE;
+  team_destroy(team);
+  from = in.from;
+  to = in.to;
+  if (err) {
+    fprintf(stderr, " [ERROR] Node ids of \"%s\" could not be numbered.\n",
+            input);
+    free(from);
+    free(to);
+    free(in.from64);
+    free(in.to64);
+    free(out_deg);
+    free(in_deg);
+    return EXIT_FAILURE;
+  }
+  if (sorted != NULL) {
+    free(out_deg);
+    free(in_deg);
+    out_deg = (int *)calloc(no_nodes + 1, sizeof(int));
+    in_deg = (int *)calloc(no_nodes + 1, sizeof(int));
+    if (out_deg != NULL && in_deg != NULL)
+      for (k = 0; k < no_edges; ++k) {
+        ++out_deg[from[k]];
+        ++in_deg[to[k]];
+      }
+  }
+  order = out_deg != NULL && in_deg != NULL
+              ? graph_order(out_deg, in_deg, no_nodes)
+              : NULL;
+  ids = (uint64_t *)malloc(sizeof(uint64_t) * (no_nodes + 1));
+  deg = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  if (order == NULL || ids == NULL || deg == NULL) {
+    fprintf(stderr, " [ERROR] Not enough memory to number the nodes of "
+                    "\"%s\"\n",
+            input);
+    free(from);
+    free(to);
+    free(out_deg);
+    free(in_deg);
+    free(sorted);
+    free(order);
+    free(ids);
+    free(deg);
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < no_edges; ++k) {
+    from[k] = order[from[k]];
+    to[k] = order[to[k]];
+  }
+  for (i = 0; i < no_nodes; ++i)
+    ids[order[i]] = sorted != NULL ? sorted[i] : (uint64_t)i;
+  memcpy(deg, out_deg, sizeof(int) * no_nodes);
+  for (i = 0; i < no_nodes; ++i)
+    out_deg[order[i]] = deg[i];
+  memcpy(deg, in_deg, sizeof(int) * no_nodes);
+  for (i = 0; i < no_nodes; ++i)
+    in_deg[order[i]] = deg[i];
+  free(deg);
+  memset(&data, 0, sizeof(Graph_data));
+  data.sparse_ids =
+      sorted != NULL && sorted[no_nodes - 1] != (uint64_t)(no_nodes - 1);
+  free(sorted);
+  graph_log("Done.\n\n");
+  graph_phase(timer, prof, "remap");
+
+  /* Writing data back to memory, section by section as they are built */
+  index_width = no_nodes <= GRAPH_MAX_NODES16 ? 2 : GRAPH_INDEX_WIDTH;
+  w.err = 0;
+  if (cache_create(&w.cw, path, input, index_width, GRAPH_OFFSET_WIDTH) ==
+      EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
+    free(from);
+    free(to);
+    free(out_deg);
+    free(in_deg);
+    free(ids);
+    free(order);
+    return EXIT_FAILURE;
+  }
+  if (queue_create(&w.sections, CACHE_SECTIONS) == EXIT_FAILURE ||
+      pthread_create(&writer, NULL, graph_write, &w) != 0) {
+    fprintf(stderr, " [ERROR] Cannot start the cache writer\n");
+    queue_free(&w.sections);
+    cache_abort(&w.cw);
+    free(from);
+    free(to);
+    free(out_deg);
+    free(in_deg);
+    free(ids);
+    free(order);
+    return EXIT_FAILURE;
+  }
+  err = graph_post(&w, "ids", ids, sizeof(uint64_t) * no_nodes, 1) ==
+        EXIT_FAILURE;
+  err = graph_post(&w, "order", order, sizeof(int) * no_nodes, 1) ==
+            EXIT_FAILURE ||
+        err;
+
+  /* Both matrices with no more than two edge arrays alive at once: the edges
+   * sorted by target in place (American flag sort) give L^T, whose sources
+   * become col_ind_t; scattering its rows gives L with sorted rows, and
+   * scattering those back over col_ind_t gives L^T with sorted rows. After a
+   * failure, the remaining steps only free their arrays. */
+  graph_log("Building CSR matrices...\n");
+  row_ptr = (long *)malloc(sizeof(long) * (no_nodes + 1));
+  row_ptr_t = (long *)malloc(sizeof(long) * (no_nodes + 1));
+  pos = (long *)malloc(sizeof(long) * (no_nodes + 1));
+  danglings = NULL;
+  col_ind = NULL;
+  err = err || row_ptr == NULL || row_ptr_t == NULL || pos == NULL;
+  if (!err) {
+    graph_prefix(out_deg, no_nodes, row_ptr);
+    graph_prefix(in_deg, no_nodes, row_ptr_t);
+
+    /* Keeping track of danglings data */
+    data.no_nodes = no_nodes;
+    data.no_edges = no_edges;
+    data.no_danglings = 0;
+    for (i = 0; i < no_nodes; ++i)
+      data.no_danglings += out_deg[i] == 0;
+    err = (danglings = (int *)malloc(sizeof(int) *
+                                     (data.no_danglings + 1))) == NULL;
+  }
+  free(in_deg);
+  if (!err) {
+    for (i = 0, j = 0; i < no_nodes; ++i)
+      if (out_deg[i] == 0)
+        danglings[j++] = i;
+    graph_log("Number of danglings nodes: %d\n", data.no_danglings);
+    err = graph_post(&w, "data", &data, sizeof(Graph_data), 0) ==
+              EXIT_FAILURE ||
+          graph_post(&w, "row_ptr", row_ptr, sizeof(long) * (no_nodes + 1),
+                     0) == EXIT_FAILURE ||
+          graph_post(&w, "row_ptr_t", row_ptr_t,
+                     sizeof(long) * (no_nodes + 1), 0) == EXIT_FAILURE;
+    err = graph_post(&w, "out_deg", out_deg, sizeof(int) * no_nodes, 1) ==
+              EXIT_FAILURE ||
+          err;
+    err = graph_post(&w, "danglings", danglings,
+                     sizeof(int) * data.no_danglings, 1) == EXIT_FAILURE ||
+          err;
+  } else
+    free(out_deg);
+
+  if (!err) {
+    memcpy(pos, row_ptr_t, sizeof(long) * no_nodes);
+    for (i = 0; i < no_nodes; ++i)
+      while (pos[i] < row_ptr_t[i + 1]) {
+        k = pos[i];
+        if ((int)to[k] == i) {
+          ++pos[i];
+          continue;
+        }
+        /* Swapping the edge with the next free slot of its target */
+        j = (int)to[k];
+        to[k] = to[pos[j]];
+        to[pos[j]] = j;
+        t = from[k];
+        from[k] = from[pos[j]];
+        from[pos[j]++] = t;
+      }
+    err = (col_ind = (int *)malloc(sizeof(int) *
+                                   (no_edges > 0 ? no_edges : 1))) == NULL;
+  }
+  free(to);
+  col_ind_t = (int *)from;
+
+  if (!err) {
+    memcpy(pos, row_ptr, sizeof(long) * no_nodes);
+    for (i = 0; i < no_nodes; ++i)
+      for (k = row_ptr_t[i]; k < row_ptr_t[i + 1]; ++k)
+        col_ind[pos[col_ind_t[k]]++] = i;
+
+    /* Compact node ids for small graphs */
+    ind = index_width == 2 ? (void *)graph_narrow(col_ind, no_edges)
+                          : (void *)col_ind;
+    err = ind == NULL ||
+          graph_post(&w, "col_ind", ind, index_width * no_edges,
+                     ind != col_ind) == EXIT_FAILURE;
+  }
+
+  if (!err) {
+    memcpy(pos, row_ptr_t, sizeof(long) * no_nodes);
+    for (i = 0; i < no_nodes; ++i)
+      for (k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+        col_ind_t[pos[col_ind[k]]++] = i;
+
+    ind_t = col_ind_t;
+    if (index_width == 2) {
+      ind_t = graph_narrow(col_ind_t, no_edges);
+      free(col_ind_t);
+    }
+    err = ind_t == NULL ||
+          graph_post(&w, "col_ind_t", ind_t, index_width * no_edges, 1) ==
+              EXIT_FAILURE;
+  } else
+    free(col_ind_t);
+  free(pos);
+  if (!err) {
+    graph_log("Done.\n\n");
+    graph_phase(timer, prof, "build");
+  }
+
+  /* Waiting for the sections still being written */
+  queue_close(&w.sections);
+  pthread_join(writer, NULL);
+  queue_free(&w.sections);
+  free(row_ptr);
+  free(row_ptr_t);
+  free(col_ind);
+  if (err || w.err || cache_commit(&w.cw) == EXIT_FAILURE) {
+    if (err || w.err)
+      cache_abort(&w.cw);
+    fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
+    return EXIT_FAILURE;
+  }
+  graph_log("Data written successfully!\n");
+  graph_phase(timer, prof, "write");
+  graph_log("Elapsed time: %.3fs\n", timer_now() - begin);
+  graph_log("Peak memory: %.1f MB (%.1f bytes per edge)\n\n",
+            mem_peak_rss() / 1e6,
+            no_edges > 0 ? (double)mem_peak_rss() / no_edges : 0.0);
+  return EXIT_SUCCESS;
+}
+
+int graph_open(Graph *g, const char input[], const char path[],
+               int no_threads, Phase_timer *timer, Perf_profile *prof) {
+  const Graph_data *data;
+  long m;
+  int n;
+  int err;
+
+  memset(g, 0, sizeof(Graph));
+  if ((err = cache_open(&g->cache, path, input, 0, GRAPH_OFFSET_WIDTH)) !=
+      CACHE_OK) {
+    if (err != CACHE_MISSING)
+      graph_log("Cache \"%s\" is %s, it will be rebuilt\n", path,
+                cache_error(err));
+    graph_log("Input file data \"%s\" is not compressed, ready to perform "
+              "compression...\n\n",
+              input);
+    if (graph_build(input, path, no_threads, timer, prof) == EXIT_FAILURE)
+      return EXIT_FAILURE;
+    /* The new file is read back once against its checksums, later opens
+     * only check its header */
+    if ((err = cache_open(&g->cache, path, input, 0, GRAPH_OFFSET_WIDTH)) !=
+            CACHE_OK ||
+        (err = cache_verify(&g->cache)) != CACHE_OK) {
+      graph_close(g);
+      fprintf(stderr, " [ERROR] Cache \"%s\" is %s.\n", path,
+              cache_error(err));
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Sections of the mapped cache */
+  if ((data = (const Graph_data *)cache_array(&g->cache, "data",
+                                              sizeof(Graph_data))) == NULL) {
+    fprintf(stderr, " [ERROR] Cache \"%s\" has no graph data.\n", path);
+    graph_close(g);
+    return EXIT_FAILURE;
+  }
+  g->data = *data;
+  n = g->data.no_nodes;
+  m = g->data.no_edges;
+  g->row_ptr =
+      (long *)cache_array(&g->cache, "row_ptr", sizeof(long) * (n + 1));
+  g->index_width = (int)g->cache.header->index_width;
+  g->col_ind = (void *)cache_array(&g->cache, "col_ind", g->index_width * m);
+  g->row_ptr_t =
+      (long *)cache_array(&g->cache, "row_ptr_t", sizeof(long) * (n + 1));
+  g->col_ind_t =
+      (void *)cache_array(&g->cache, "col_ind_t", g->index_width * m);
+  g->out_deg = (int *)cache_array(&g->cache, "out_deg", sizeof(int) * n);
+  g->danglings = (int *)cache_array(&g->cache, "danglings",
+                                    sizeof(int) * g->data.no_danglings);
+  g->ids = (uint64_t *)cache_array(&g->cache, "ids", sizeof(uint64_t) * n);
+  g->order = (int *)cache_array(&g->cache, "order", sizeof(int) * n);
+  if ((g->index_width != 2 && g->index_width != GRAPH_INDEX_WIDTH) ||
+      g->row_ptr == NULL || g->col_ind == NULL || g->row_ptr_t == NULL ||
+      g->col_ind_t == NULL || g->out_deg == NULL || g->danglings == NULL ||
+      g->ids == NULL || g->order == NULL) {
+    fprintf(stderr, " [ERROR] Cache \"%s\" is incomplete, it will be "
+                    "removed.\n",
+            path);
+    graph_close(g);
+    remove(path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+void graph_unpermute(const Graph *g, const double *v, double *res) {
+  int k;
+
+  for (k = 0; k < g->data.no_nodes; ++k)
+    res[k] = v[g->order[k]];
+}
+
+int graph_write_ids(const Graph *g, const char path[]) {
+  FILE *pf;
+  int k;
+  int err;
+
+  if ((pf = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  err = 0;
+  for (k = 0; k < g->data.no_nodes && !err; ++k)
+    err = fwrite(g->ids + g->order[k], sizeof(uint64_t), 1, pf) != 1;
+  if (fclose(pf) != 0 || err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+void graph_close(Graph *g) { cache_close(&g->cache); }
@@ -0,0 +1,96 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "cache.h"
+#include "perf.h"
+#include "timer.h"
+
+/* Graph cache shared by pagerank and hits: the adjacency matrix L and its
+ * transpose in CSR form, the out-degrees and the dangling nodes, built once
+ * from a SNAP edge list (by graphbuild or by the first solver run) and mapped
+ * read-only by every run on the same input. Rows of both matrices are sorted
+ * by column. */
+
+/* Node ids of the input may be sparse and up to 2^64 - 2: they are numbered
+ * densely and then by decreasing degree, for locality. The cache keeps the
+ * input id of every node and the node of every input id in increasing order,
+ * in which the solvers write their results. */
+
+/* Edge offsets are 64-bit, so that a graph may have more than 2^31 edges,
+ * while node ids are 32-bit, or 16-bit for graphs of at most 65536 nodes:
+ * the offsets cost 4 more bytes per node, wider ids would cost more bytes per
+ * edge. Both widths are recorded in the cache header and select the
+ * specialized SpMV kernels. */
+#define GRAPH_INDEX_WIDTH ((int)sizeof(int))
+#define GRAPH_OFFSET_WIDTH ((int)sizeof(long))
+#define GRAPH_MAX_NODES 0x7fffffffL
+#define GRAPH_MAX_NODES16 65536
+
+/* Node id k of an array of ids of the given width */
+#define GRAPH_ID(ind, width, k)                                                \
+  ((width) == 2 ? (int)((const unsigned short *)(ind))[k]                     \
+                : ((const int *)(ind))[k])
+
+/* Binary edge list, read like the SNAP text inputs: this header and then
+ * no_edges (source, target) pairs of id_width bytes in the byte order of the
+ * machine. Reading one is a copy of the mapped file, split among the
+ * threads, with no text to parse. */
+#define GRAPH_EDGES_MAGIC "IRWSEDGE"
+#define GRAPH_EDGES_VERSION 1
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t id_width; /* 4 or 8 */
+  uint64_t no_nodes; /* as in the header of the text input */
+  uint64_t no_edges;
+} Graph_edges_header;
+
+typedef struct {
+  int no_nodes;
+  int no_danglings; /* numbered last, after all the other nodes */
+  long no_edges;
+  int sparse_ids; /* input ids other than 0, 1, ..., no_nodes - 1 */
+} Graph_data;
+
+typedef struct {
+  Graph_data data;
+  long *row_ptr, *row_ptr_t; /* edge offsets of the rows of L and L^T */
+  void *col_ind;             /* L: row i lists the targets of i */
+  void *col_ind_t;           /* L^T: row i lists the sources of i */
+  int index_width;           /* bytes of the col_ind entries */
+  int *out_deg;
+  int *danglings;
+  uint64_t *ids; /* input id of every node */
+  int *order;    /* node of the k-th smallest input id */
+  Cache cache;
+} Graph;
+
+/* Name of the input without directory and extensions (data/web.txt.gz gives
+ * web), at most GRAPH_NAME bytes with the terminator, and cache file names.
+ * Inputs that differ only in directory or extension, such as web.txt and its
+ * edge list web.el, share their caches and outputs. */
+#define GRAPH_NAME 256
+void graph_name(const char input[], char name[]);
+void graph_path(const char name[], const char suffix[], char path[]);
+
+/* Silences the progress of graph_build() and graph_open(), for callers that
+ * build several caches at once; errors still go to stderr */
+void graph_set_quiet(int quiet);
+/* Parses input and writes the cache at path, numbering the nodes with
+ * no_threads threads; timer and prof, when not NULL, get the parse, remap,
+ * build and write phases */
+int graph_build(const char input[], const char path[], int no_threads,
+                Phase_timer *timer, Perf_profile *prof);
+/* Maps the cache at path, building it first if missing or stale */
+int graph_open(Graph *g, const char input[], const char path[],
+               int no_threads, Phase_timer *timer, Perf_profile *prof);
+/* Writes the edges of a text (or binary) input as a binary edge list */
+int graph_convert(const char input[], const char output[], int no_threads);
+/* res[k] = v[node of the k-th smallest input id] */
+void graph_unpermute(const Graph *g, const double *v, double *res);
+/* Writes the input ids in increasing order, as 64-bit integers */
+int graph_write_ids(const Graph *g, const char path[]);
+void graph_close(Graph *g);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "graph.h"
+#include "part.h"
+#include "sell.h"
+
+#define FNAME 256
+#define PATH 1024
+
+/* Preprocessing shared by pagerank and hits: builds the graph cache of every
+ * input (and optionally its SELL layouts and its partition for pagerank -N)
+ * once, so that the solvers only map it. Caches that are up to date are left
+ * alone unless -f is given; -v reads them against their checksums, which the
+ * solvers do not, and rebuilds those that fail. */
+int main(int argc, char *argv[]) {
+  char fname[FNAME];
+  char cache_p[PATH];
+  char sell_p[PATH], sell_tp[PATH];
+  char part_p[PATH];
+  Graph graph;
+  SELL_matrix sell, sell_t;
+  Partition part;
+  int no_parts = 0;
+  Cache cache;
+  Phase_timer timer;
+  char *json_p = NULL;
+  FILE *pjson;
+  int force = 0;
+  int verify = 0;
+  int status;
+  int use_sell = 0;
+  int sigma = SELL_SIGMA;
+  int no_threads = 1;
+  int opt;
+  int err = 0;
+  int i;
+
+  while ((opt = getopt(argc, argv, "fvl:s:t:T:N:")) != -1) {
+    switch (opt) {
+    case 'f':
+      force = 1;
+      break;
+    case 'v':
+      verify = 1;
+      break;
+    case 'l':
+      if (strcmp(optarg, "sell") == 0)
+        use_sell = 1;
+      else if (strcmp(optarg, "csr") != 0) {
+        fprintf(stderr, " [ERROR] unknown layout \"%s\" (csr, sell)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      sigma = atoi(optarg);
+      break;
+    case 't':
+      no_threads = atoi(optarg);
+      break;
+    case 'T':
+      json_p = optarg;
+      break;
+    case 'N':
+      no_parts = atoi(optarg);
+      if (no_parts < 1 || no_parts > PART_MAX) {
+        fprintf(stderr, " [ERROR] -N takes 1 to %d parts\n", PART_MAX);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./graphbuild [-f] [-v] [-l csr|sell] "
+                      "[-s <sigma>] [-t <threads>] [-N <parts>] "
+                      "[-T <timings.json>] <arg_name>...\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind == argc) {
+    fprintf(stderr, " [ERROR] at least *1* argument required: ./graphbuild "
+                    "<arg_name>...\n");
+    exit(EXIT_FAILURE);
+  }
+
+  timer_init(&timer);
+  for (i = optind; i < argc && !err; ++i) {
+    graph_name(argv[i], fname);
+    graph_path(fname, ".graph", cache_p);
+    graph_path(fname, ".sell", sell_p);
+    graph_path(fname, ".sell_t", sell_tp);
+    graph_path(fname, ".part", part_p);
+
+    timer_start(&timer);
+    status = force ? CACHE_STALE
+                   : cache_open(&cache, cache_p, argv[i], 0,
+                                GRAPH_OFFSET_WIDTH);
+    if (status == CACHE_OK && verify) {
+      status = cache_verify(&cache);
+      if (status != CACHE_OK) {
+        cache_close(&cache);
+        printf("Cache \"%s\" is %s, it will be rebuilt\n", cache_p,
+               cache_error(status));
+      }
+    }
+    if (status == CACHE_OK) {
+      printf("Cache \"%s\" is up to date\n", cache_p);
+      cache_close(&cache);
+    } else if (graph_build(argv[i], cache_p, no_threads, &timer, NULL) ==
+               EXIT_FAILURE)
+      err = 1;
+    if (err || (!use_sell && no_parts == 0))
+      continue;
+
+    if (graph_open(&graph, argv[i], cache_p, no_threads, &timer,
+                   NULL) == EXIT_FAILURE) {
+      err = 1;
+      continue;
+    }
+
+    /* Edge-cut partition of the processes of pagerank -N */
+    if (no_parts > 0) {
+      timer_start(&timer);
+      if (force)
+        remove(part_p);
+      if (part_open(&part, part_p, argv[i], graph.row_ptr, graph.col_ind,
+                    graph.row_ptr_t, graph.col_ind_t, graph.index_width,
+                    graph.data.no_nodes, no_parts) == EXIT_FAILURE) {
+        fprintf(stderr, " [ERROR] Partition could not be built.\n");
+        err = 1;
+      } else {
+        printf("Partition \"%s\": %d parts, %ld of %ld edges cut (%ld for "
+               "row ranges)\n",
+               part_p, no_parts, part.data.cut, part.data.no_edges,
+               part.data.range_cut);
+        part_free(&part);
+      }
+      timer_stop(&timer, "partition");
+    }
+    if (err || !use_sell) {
+      graph_close(&graph);
+      continue;
+    }
+
+    /* Layouts of both L (hits) and L^T (pagerank and hits) */
+    if (no_parts > 0)
+      timer_start(&timer);
+    if (force) {
+      remove(sell_p);
+      remove(sell_tp);
+    }
+    err = sell_open(&sell, sell_p, argv[i], graph.row_ptr, graph.col_ind,
+                    graph.index_width, NULL, graph.data.no_nodes,
+                    sigma) == EXIT_FAILURE ||
+          sell_open(&sell_t, sell_tp, argv[i], graph.row_ptr_t,
+                    graph.col_ind_t, graph.index_width, NULL,
+                    graph.data.no_nodes, sigma) == EXIT_FAILURE;
+    if (err)
+      fprintf(stderr, " [ERROR] SELL layouts could not be built.\n");
+    else {
+      sell_free(&sell);
+      sell_free(&sell_t);
+    }
+    graph_close(&graph);
+    timer_stop(&timer, "sell");
+  }
+
+  /* Phase timings for the benchmarks */
+  if (json_p != NULL) {
+    if ((pjson = fopen(json_p, "w")) == NULL) {
+      fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", json_p);
+      exit(EXIT_FAILURE);
+    }
+    fprintf(pjson, "{\"tool\": \"graphbuild\", \"inputs\": %d, \"phases\": ",
+            argc - optind);
+    timer_json(&timer, pjson);
+    fprintf(pjson, "}\n");
+    fclose(pjson);
+  }
+
+  if (err)
+    exit(EXIT_FAILURE);
+  exit(EXIT_SUCCESS);
+}
@@ -1,4 +1,3 @@
-#include <dirent.h>
 #include <fcntl.h>
 #include <float.h>
 #include <math.h>
@@ -11,310 +10,320 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "graph.h"
+#include "lanczos.h"
+#include "mem.h"
+#include "perf.h"
+#include "query.h"
+#include "spmv.h"
+#include "team.h"
+#include "timer.h"
+#include "topk.h"
+
 #define TOL 1.e-10
 #define MAX_ITER 200
 #define MOD_ITER 10
+#define MAX_PRINT 32
 #define FNAME 256
-#define DNAME 1024
 #define PATH 1024
-#define MMAP 2048
 /*#define DEBUG*/
 
-/* Data for compression */
+/* Per-thread reductions, one cache line each */
 typedef struct {
-  int no_nodes;
-  int no_edges;
-  int no_danglings;
-} LCSR_data;
+  double a_sum, h_sum;
+  double a_dist, h_dist;
+  char pad[32];
+} HITS_partial;
+
+/* Shared state of the HITS iteration: a is computed from L^T (rows of
+ * thread t in bounds_t), h from L (rows in bounds) */
+typedef struct {
+  const SpMV_kernel *kernel;
+  const long *row_ptr, *row_ptr_t;
+  const void *col_ind, *col_ind_t;
+  const SELL_matrix *sell, *sell_t;
+  double *a, *a_new;
+  double *h, *h_new;
+  double a_sum, h_sum;
+  int *bounds, *bounds_t;
+  int *chunk_bounds, *chunk_bounds_t;
+  HITS_partial *partial;
+  Topk *a_topk, *h_topk; /* top-K of a_new and h_new, tracked by each
+                            normalization */
+  int trans;      /* product of the Lanczos solver: y = L x, or L^T x */
+  const double *x;
+  double *y;
+  Team *team;
+} HITS_iteration;
 
 /* Helper functions */
 int write_data(char path[], void *data, size_t nmemb, size_t size);
-void delete_folder(char dir[]);
-void *mmap_data(char path[], size_t nmemb, size_t size);
 void print_vec_f(double *v, int n);
 void print_vec_d(int *v, int n);
-void double_merge(int *from, int *to, int lo, int mid, int hi);
-void double_merge_sort(int *from, int *to, int lo, int hi);
-void sort_input_data(int *from, int *to, int n);
+void print_vec_id(const uint64_t *ids, int *v, int n);
 int *index_sort_top_K(const double *v, size_t n, int top_K);
+double jaccard(const long *row_ptr, const void *col_ind, int index_width,
+               int u, int v);
+void hits_init_task(int tid, void *arg);
+void hits_spmv_task(int tid, void *arg);
+void hits_normalize_task(int tid, void *arg);
+void hits_product_task(int tid, void *arg);
+void hits_product(void *ctx, int trans, const double *x, double *y);
+double hits_sign(const double *v, int n);
+void partition(Team *team, const long *row_ptr, const SELL_matrix *sell,
+               int no_nodes, int *bounds, int *chunk_bounds);
+int run_queries(const Graph *g, FILE *in, int top_K);
 
 int main(int argc, char *argv[]) {
-  /* Data to save/load LCSR matrix */
-  FILE *pdata;
+  /* Graph cache */
   char fname[FNAME];
-  char dir[DNAME];
-  /*   Matrix L            Matrix L^T         */
-  char row_ptr_p[PATH], row_ptr_tp[PATH];
-  char col_ind_p[PATH], col_ind_tp[PATH];
-  char lcsr_data_p[PATH];
-  LCSR_data lcsr_data;
+  char cache_p[PATH];
+  char sell_p[PATH], sell_tp[PATH];
+  Graph graph;
   struct stat st = {0};
-
-  /* Reading data from input file */
   FILE *pf;
-  int no_nodes, no_edges;
-  char *s = NULL;
-  size_t slen = 0;
-  ssize_t bytes;
-  int ri, ci;
-  int *from, *to;
-  int f, t;
+  int no_nodes;
+  long no_edges;
+  int t;
   int i;
 
   /* LCSR matrix representation */
-  int *col_ind, *col_ind_t;
-  int *row_ptr, *row_ptr_t;
+  void *col_ind, *col_ind_t;
+  long *row_ptr, *row_ptr_t;
 
   /* HITS computation data */
   double *a, *a_new;
   double *h, *h_new;
   double a_dist, h_dist;
+  Topk a_topk, h_topk;
+  int track_k = 0, rounds = TOPK_ROUNDS;
+  int *early_a = NULL, *early_h = NULL;
+  int audit = 0, stop_iter = 0, stable;
+  Lanczos lanczos;
+  int no_pairs = 0;
+  double scale;
+  char fpair[PATH];
+  char *query_p = NULL;
+  FILE *pquery;
   int iter;
   char fauth[FNAME];
   char fhub[FNAME];
+  char fids[FNAME];
   int top_K;
+  HITS_iteration it;
+
+  /* Threads and memory placement */
+  Team *team;
+  int no_threads = 1;
+  int place = MEM_PLACE_NONE;
+  int pages = MEM_PAGES_THP;
+  int *nodes;
+  Perf_counters counters;
+  double counts[PERF_EVENTS], iter_counts[PERF_EVENTS];
+  Perf_profile prof;
+  char *prof_p = NULL;
+  char prof_label[PERF_LABEL];
+  double peak_bw = 0.;
+  int profile = 0;
 
   /* Time elapsed data */
-  clock_t begin, end;
+  Phase_timer timer;
   double elapsed_time;
+  double spmv_begin, spmv_time;
+  char *json_p = NULL;
+  FILE *pjson;
+
+  /* SpMV kernel and matrix layout */
+  const SpMV_kernel *kernel;
+  char *kernel_name = NULL;
+  SELL_matrix sell, sell_t;
+  int use_sell = 0;
+  int sigma = SELL_SIGMA;
+  double bytes_per_iter;
+  char *input;
+  int opt;
 
   /* Extra data */
   double sum;
   int err;
 
-  if (argc != 2 && argc != 3) {
+  timer_init(&timer);
+  while ((opt = getopt(argc, argv, "k:l:s:t:m:H:T:pP:K:R:AS:Q:")) != -1) {
+    switch (opt) {
+    case 'k':
+      kernel_name = optarg;
+      break;
+    case 'l':
+      if (strcmp(optarg, "sell") == 0)
+        use_sell = 1;
+      else if (strcmp(optarg, "csr") != 0) {
+        fprintf(stderr, " [ERROR] unknown layout \"%s\" (csr, sell)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      sigma = atoi(optarg);
+      break;
+    case 't':
+      no_threads = atoi(optarg);
+      break;
+    case 'T':
+      json_p = optarg;
+      break;
+    case 'p':
+      profile = 1;
+      break;
+    case 'P':
+      profile = 1;
+      prof_p = optarg;
+      break;
+    case 'K':
+      track_k = atoi(optarg);
+      break;
+    case 'R':
+      rounds = atoi(optarg);
+      break;
+    case 'A':
+      audit = 1;
+      break;
+    case 'S':
+      no_pairs = atoi(optarg);
+      break;
+    case 'Q':
+      query_p = optarg;
+      break;
+    case 'm':
+      if ((place = mem_parse_place(optarg)) == -1) {
+        fprintf(stderr, " [ERROR] unknown placement \"%s\" "
+                        "(none, interleave, partition)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'H':
+      if ((pages = mem_parse_pages(optarg)) == -1) {
+        fprintf(stderr, " [ERROR] unknown pages \"%s\" (none, thp, hugetlb)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./hits [-k <kernel>] [-l csr|sell] "
+                      "[-s <sigma>] [-t <threads>] "
+                      "[-m none|interleave|partition] "
+                      "[-H none|thp|hugetlb] [-T <timings.json>] "
+                      "[-p] [-P <profile.csv>] "
+                      "[-K <top-k> [-R <rounds>] [-A]] [-S <pairs>] "
+                      "[-Q <queries>|-] <arg_name> [<K>]\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (argc - optind != 1 && argc - optind != 2) {
     fprintf(stderr,
-            " [ERROR] *1* argument required: ./pagerank <arg_name> [<K>]\n");
+            " [ERROR] *1* argument required: ./hits <arg_name> [<K>]\n");
+    exit(EXIT_FAILURE);
+  }
+  input = argv[optind];
+  if (track_k < 0 || rounds < 1) {
+    fprintf(stderr, " [ERROR] -K needs k >= 0 and -R rounds >= 1\n");
+    exit(EXIT_FAILURE);
+  }
+  if (no_pairs < 0 || (no_pairs > 0 && track_k > 0)) {
+    fprintf(stderr, " [ERROR] -S needs pairs >= 1 and the power iteration "
+                    "for -K\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Select the SpMV kernel supported by the CPU */
+  if ((kernel = spmv_select(kernel_name, GRAPH_INDEX_WIDTH)) == NULL) {
+    fprintf(stderr, " [ERROR] SpMV kernel \"%s\" is not available (",
+            kernel_name);
+    spmv_list(stderr);
+    fprintf(stderr, ")\n");
     exit(EXIT_FAILURE);
   }
 
-  /* Init data folder name */
-  strncpy(fname, argv[1] + 5, strlen(argv[1]) - 9);
-  fname[strlen(argv[1]) - 8] = '\0';
-  strcpy(dir, "HITS_");
-  dir[5] = '\0';
-  strcat(dir, fname);
-  dir[5 + strlen(fname)] = '/';
-  dir[5 + strlen(fname) + 1] = '\0';
-
-  /* Create LCSR file names */
-  strcpy(row_ptr_p, dir);
-  strcat(row_ptr_p, "row_ptr.bin");
-  strcpy(col_ind_p, dir);
-  strcat(col_ind_p, "col_ind.bin");
-
-  /* Create transposed LCSR file names */
-  strcpy(row_ptr_tp, dir);
-  strcat(row_ptr_tp, "row_ptr_t.bin");
-  strcpy(col_ind_tp, dir);
-  strcat(col_ind_tp, "col_ind_t.bin");
-
-  /* Create LCSR metadata file */
-  strcpy(lcsr_data_p, dir);
-  strcat(lcsr_data_p, "lcsr_data.bin");
-
-  /* Create file to save HITS result */
+  /* Counting from here, so that the threads created later are counted too */
+  perf_open(&counters);
+  perf_profile_init(&prof, &counters, profile);
+
+  /* Init cache file names */
+  graph_name(input, fname);
+  graph_path(fname, ".graph", cache_p);
+  graph_path(fname, ".sell", sell_p);
+  graph_path(fname, ".sell_t", sell_tp);
+
+  /* Create file to save HITS result, and the input ids if sparse */
   strcpy(fauth, fname);
   strcat(fauth, "_a.hits");
   strcpy(fhub, fname);
   strcat(fhub, "_h.hits");
+  graph_path(fname, ".ids", fids);
 
-  /* Check if input data has already been compressed.
-   * If data has NOT yet been compressed, then perform compression */
-  if (stat(dir, &st) == -1) {
-    printf("Input file data \"%s\" is not compressed, ready to perform "
-           "compression...\n\n",
-           argv[1]);
-    mkdir(dir, 0700);
-
-    if ((pf = fopen(argv[1], "r")) == NULL) {
-      fprintf(stderr, " [ERROR] cannot open input file \"%s\"\n", argv[1]);
-      exit(EXIT_FAILURE);
-    }
-
-    /* Parsing input file header */
-    printf("Parsing input data...\n");
-    bytes = getline(&s, &slen, pf);
-    bytes = getline(&s, &slen, pf);
-    bytes = getline(&s, &slen, pf);
-    sscanf(s, "# Nodes: %d Edges: %d", &no_nodes, &no_edges);
-    printf("This graph has %d nodes and %d edges\n", no_nodes, no_edges);
-    bytes = getline(&s, &slen, pf);
-
-    lcsr_data.no_nodes = no_nodes;
-    lcsr_data.no_edges = no_edges;
-
-    /* Reading data from input file */
-    i = 0;
-    from = (int *)malloc(sizeof(int) * no_edges);
-    to = (int *)malloc(sizeof(int) * no_edges);
-    while ((bytes = getline(&s, &slen, pf)) != -1) {
-      sscanf(s, "%d %d", from + i, to + i);
-      if (i % 10 == 0)
-        printf("\rEdge %d/%d", i, no_edges);
-      ++i;
-    }
-    printf("\rEdge %d/%d\n", i, no_edges);
-    printf("Done\n\n");
-    fclose(pf);
-    free(s);
-
-    /* LCSR matrix initialization */
-    col_ind = (int *)malloc(sizeof(int) * no_edges);
-    row_ptr = (int *)malloc(sizeof(int) * (no_nodes + 1));
-    ri = 0;
-    row_ptr[ri] = 0;
-    ci = 0;
-
-    /* Writing data in LCSR matrix */
-    for (ci = 0; ci < no_edges; ++ci) {
-      f = from[ci];
-      t = to[ci];
-      if (f > ri) {
-        for (i = ri + 1; i <= f; ++i)
-          row_ptr[i] = ci;
-        ri = f;
-      }
-      col_ind[ci] = t;
-    }
-    while (ri < no_nodes)
-      row_ptr[++ri] = ci;
-
-#ifdef DEBUG
-    printf("LCSR matrix\n");
-    printf("---------------------\n");
-
-    printf("col_ind: [ ");
-    for (i = 0; i < no_edges; ++i)
-      printf("%d ", col_ind[i]);
-    printf("]\n");
-
-    printf("row_ptr: [ ");
-    for (i = 0; i < no_nodes + 1; ++i)
-      printf("%d ", row_ptr[i]);
-    printf("]\n\n");
-#endif
-
-    printf("Sorting edges for transposed matrix...\n");
-    sort_input_data(from, to, no_edges);
-    printf("Done.\n\n");
-
-    /* Transposed LCSR matrix initialization */
-    col_ind_t = (int *)malloc(sizeof(int) * no_edges);
-    row_ptr_t = (int *)malloc(sizeof(int) * (no_nodes + 1));
-    ri = 0;
-    row_ptr_t[ri] = 0;
-    ci = 0;
-
-    /* Writing data in Transposed LCSR matrix */
-    for (ci = 0; ci < no_edges; ++ci) {
-      f = from[ci];
-      t = to[ci];
-      if (t > ri) {
-        for (i = ri + 1; i <= t; ++i)
-          row_ptr_t[i] = ci;
-        ri = t;
-      }
-      col_ind_t[ci] = f;
-    }
-    while (ri < no_nodes)
-      row_ptr_t[++ri] = ci;
-
-#ifdef DEBUG
-    printf("Transposed LCSR matrix\n");
-    printf("---------------------\n");
-
-    printf("col_ind_t: [ ");
-    for (i = 0; i < no_edges; ++i)
-      printf("%d ", col_ind_t[i]);
-    printf("]\n");
-
-    printf("row_ptr_t: [ ");
-    for (i = 0; i < no_nodes + 1; ++i)
-      printf("%d ", row_ptr_t[i]);
-    printf("]\n\n");
-#endif
-
-    /* Writing data back to memory */
-    err = (write_data(row_ptr_p, (void *)row_ptr, sizeof(int), no_nodes + 1) ==
-           EXIT_FAILURE) ||
-          (write_data(col_ind_p, (void *)col_ind, sizeof(int), no_edges) ==
-           EXIT_FAILURE) ||
-          (write_data(row_ptr_tp, (void *)row_ptr_t, sizeof(int),
-                      no_nodes + 1) == EXIT_FAILURE) ||
-          (write_data(col_ind_tp, (void *)col_ind_t, sizeof(int), no_edges) ==
-           EXIT_FAILURE) ||
-          (write_data(lcsr_data_p, (void *)&lcsr_data, sizeof(LCSR_data), 1) ==
-           EXIT_FAILURE);
-
-    /* Input data */
-    free(from);
-    free(to);
-    from = NULL;
-    to = NULL;
-    /* CSR data structure */
-    free(col_ind);
-    free(row_ptr);
-    free(col_ind_t);
-    free(row_ptr_t);
-    col_ind = NULL;
-    row_ptr = NULL;
-    col_ind_t = NULL;
-    row_ptr_t = NULL;
-
-    /* Manage error from writing data to memory */
-    if (err) {
-      delete_folder(dir);
-      fprintf(stderr, " [ERROR] data could not be written in memory.\n");
+  /* Mapping the graph cache, built from the input data the first time */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  if (graph_open(&graph, input, cache_p, no_threads, &timer, &prof) ==
+      EXIT_FAILURE)
+    exit(EXIT_FAILURE);
+  printf("Reading CLSR matrix data...\n");
+  no_nodes = graph.data.no_nodes;
+  no_edges = graph.data.no_edges;
+  printf("no_nodes: %d\nno_edges: %ld\n\n", no_nodes, no_edges);
+  row_ptr = graph.row_ptr;
+  col_ind = graph.col_ind;
+  row_ptr_t = graph.row_ptr_t;
+  col_ind_t = graph.col_ind_t;
+
+  /* Kernels specialized for the width of the node ids in the cache */
+  kernel = spmv_select(kernel_name, graph.index_width);
+  printf("Node ids: %d bits\n", 8 * graph.index_width);
+
+  /* Query mode: HITS on the base set of every root set read, instead of the
+   * whole graph; from stdin a resident process answers them as they come */
+  if (query_p != NULL) {
+    timer_stop(&timer, "mmap");
+    perf_profile_stop(&prof, "mmap", 0.);
+    top_K = 10;
+    if (argc - optind == 2)
+      sscanf(argv[optind + 1], "%d", &top_K);
+    if (strcmp(query_p, "-") == 0)
+      pquery = stdin;
+    else if ((pquery = fopen(query_p, "r")) == NULL) {
+      fprintf(stderr, " [ERROR] cannot open queries \"%s\"\n", query_p);
       exit(EXIT_FAILURE);
     }
+    printf("\n");
+    err = run_queries(&graph, pquery, top_K) == EXIT_FAILURE;
+    if (pquery != stdin)
+      fclose(pquery);
+    printf("Peak memory: %.1f MB\n", mem_peak_rss() / 1e6);
+    graph_close(&graph);
+    perf_close(&counters);
+    perf_profile_free(&prof);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
-  /* Reading LCSR matrix metadata info from file */
-  printf("Reading CLSR matrix data...\n");
-  pdata = fopen(lcsr_data_p, "rb");
-  bytes = fread(&no_nodes, sizeof(lcsr_data.no_nodes), 1, pdata);
-  bytes = fread(&no_edges, sizeof(lcsr_data.no_edges), 1, pdata);
-  fclose(pdata);
-  printf("no_nodes: %d\nno_edges: %d\n\n", no_nodes, no_edges);
-
-  /* mmapping the CSR matrix data from files */
-  err = 0;
-  if ((row_ptr = (int *)mmap_data(row_ptr_p, sizeof(int), no_nodes + 1)) ==
-      NULL)
-    ++i;
-  else if ((row_ptr_t = (int *)mmap_data(row_ptr_tp, sizeof(int),
-                                         no_nodes + 1)) == NULL)
-    ++i;
-  else if ((col_ind = (int *)mmap_data(col_ind_p, sizeof(int), no_edges)) ==
-           NULL)
-    ++i;
-  else if ((col_ind_t = (int *)mmap_data(col_ind_tp, sizeof(int), no_edges)) ==
-           NULL)
-    ++i;
-
-  if (err > 0) {
-    fprintf(stderr, " [ERROR] data could not be mmapped from memory.\n");
-    fprintf(stderr,
-            "         Data is corrupted, the folder will be destroyed.\n");
-    delete_folder(dir);
-    /* Un-mmaping mmapped files */
-    switch (err) {
-    case 1:
-      do {
-        munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-      case 2:
-        munmap(row_ptr_t, (no_nodes + 1) * sizeof(int));
-      case 3:
-        munmap(col_ind, no_edges * sizeof(int));
-      case 4:
-        munmap(col_ind_t, no_edges * sizeof(int));
-      } while (--err > 0);
-    }
+  /* Loading the SELL-C-sigma layouts, building them from the LCSR matrices
+   * the first time they are requested for this input */
+  if (use_sell &&
+      (sell_open(&sell, sell_p, input, row_ptr, col_ind, graph.index_width,
+                 NULL, no_nodes, sigma) == EXIT_FAILURE ||
+       sell_open(&sell_t, sell_tp, input, row_ptr_t, col_ind_t,
+                 graph.index_width, NULL, no_nodes, sigma) == EXIT_FAILURE)) {
+    fprintf(stderr, " [ERROR] SELL layouts could not be built.\n");
     exit(EXIT_FAILURE);
   }
+  if (use_sell)
+    printf("SELL-%d-%d: %d chunks, fill ratio %.3f (L), %.3f (L^T)\n", SELL_C,
+           sell.data.sigma, sell.data.no_chunks, sell_fill(&sell, no_edges),
+           sell_fill(&sell_t, no_edges));
 
   printf("Done.\n\n");
+  timer_stop(&timer, "mmap");
+  perf_profile_stop(&prof, "mmap", 0.);
 
 #ifdef DEBUG
   printf("LCSR matrix\n");
@@ -322,12 +331,12 @@ int main(int argc, char *argv[]) {
 
   printf("col_ind: [ ");
   for (i = 0; i < no_edges; ++i)
-    printf("%d ", col_ind[i]);
+    printf("%d ", GRAPH_ID(col_ind, graph.index_width, i));
   printf("]\n");
 
   printf("row_ptr: [ ");
   for (i = 0; i < no_nodes + 1; ++i)
-    printf("%d ", row_ptr[i]);
+    printf("%ld ", row_ptr[i]);
   printf("]\n\n");
 
   printf("Transposed LCSR matrix\n");
@@ -335,85 +344,248 @@ int main(int argc, char *argv[]) {
 
   printf("col_ind_t: [ ");
   for (i = 0; i < no_edges; ++i)
-    printf("%d ", col_ind_t[i]);
+    printf("%d ", GRAPH_ID(col_ind_t, graph.index_width, i));
   printf("]\n");
 
   printf("row_ptr_t: [ ");
   for (i = 0; i < no_nodes + 1; ++i)
-    printf("%d ", row_ptr_t[i]);
+    printf("%ld ", row_ptr_t[i]);
   printf("]\n\n");
 #endif
 
+  /* Setting up the threads and the rows each of them owns */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  if (no_threads < 1)
+    no_threads = 1;
+  if ((team = team_create(no_threads, 1)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot start %d threads\n", no_threads);
+    exit(EXIT_FAILURE);
+  }
+  nodes = (int *)malloc(sizeof(int) * no_threads);
+  for (t = 0; t < no_threads; ++t)
+    nodes[t] = mem_cpu_node(team_cpu(team, t));
+  it.bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.bounds_t = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.chunk_bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.chunk_bounds_t = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.sell = use_sell ? &sell : NULL;
+  it.sell_t = use_sell ? &sell_t : NULL;
+  partition(team, row_ptr, it.sell, no_nodes, it.bounds, it.chunk_bounds);
+  partition(team, row_ptr_t, it.sell_t, no_nodes, it.bounds_t,
+            it.chunk_bounds_t);
+
+  /* Copying the matrices where their rows are used */
+  if (place != MEM_PLACE_NONE) {
+    printf("Placing matrix data (%s)...\n", mem_place_name(place));
+    if (use_sell)
+      err = sell_place(&sell, team, it.chunk_bounds, place, pages) ==
+                EXIT_FAILURE ||
+            sell_place(&sell_t, team, it.chunk_bounds_t, place, pages) ==
+                EXIT_FAILURE;
+    else
+      err = (row_ptr = (long *)mem_place_array(
+                 team, row_ptr, (no_nodes + 1) * sizeof(long), it.bounds,
+                 NULL, sizeof(long), place, pages)) == NULL ||
+            (col_ind = mem_place_array(team, col_ind,
+                                       no_edges * graph.index_width,
+                                       it.bounds, row_ptr, graph.index_width,
+                                       place, pages)) == NULL ||
+            (row_ptr_t = (long *)mem_place_array(
+                 team, row_ptr_t, (no_nodes + 1) * sizeof(long), it.bounds_t,
+                 NULL, sizeof(long), place, pages)) == NULL ||
+            (col_ind_t = mem_place_array(
+                 team, col_ind_t, no_edges * graph.index_width, it.bounds_t,
+                 row_ptr_t, graph.index_width, place, pages)) == NULL;
+    if (err) {
+      fprintf(stderr, " [ERROR] matrix data could not be placed.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
   /* Setting data up for HITS computation */
-  a = (double *)malloc(sizeof(double) * no_nodes);
-  h = (double *)malloc(sizeof(double) * no_nodes);
-  for (i = 0; i < no_nodes; ++i) {
-    a[i] = 1.;
-    h[i] = 1.;
+  a = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  h = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  a_new = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  h_new = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  if (place == MEM_PLACE_INTERLEAVE) {
+    mem_interleave(a, sizeof(double) * no_nodes);
+    mem_interleave(h, sizeof(double) * no_nodes);
+    mem_interleave(a_new, sizeof(double) * no_nodes);
+    mem_interleave(h_new, sizeof(double) * no_nodes);
   }
-  a_new = (double *)malloc(sizeof(double) * no_nodes);
-  h_new = (double *)malloc(sizeof(double) * no_nodes);
+  it.kernel = kernel;
+  it.row_ptr = row_ptr;
+  it.row_ptr_t = row_ptr_t;
+  it.col_ind = col_ind;
+  it.col_ind_t = col_ind_t;
+  it.a = a;
+  it.h = h;
+  it.a_new = a_new;
+  it.h_new = h_new;
+  it.partial = (HITS_partial *)malloc(sizeof(HITS_partial) * no_threads);
+  it.a_topk = it.h_topk = NULL;
+  if (track_k > 0) {
+    if (track_k > no_nodes)
+      track_k = no_nodes;
+    if (topk_create(&a_topk, track_k, no_threads) == EXIT_FAILURE ||
+        topk_create(&h_topk, track_k, no_threads) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Not enough memory for the top-K\n");
+      exit(EXIT_FAILURE);
+    }
+    it.a_topk = &a_topk;
+    it.h_topk = &h_topk;
+    early_a = (int *)malloc(sizeof(int) * track_k);
+    early_h = (int *)malloc(sizeof(int) * track_k);
+  }
+  team_run(team, hits_init_task, &it);
   a_dist = DBL_MAX;
   h_dist = DBL_MAX;
   iter = 0;
+  spmv_time = 0.;
+  bytes_per_iter = use_sell ? sell_bytes(&sell, 0) + sell_bytes(&sell_t, 0)
+                            : 2. * spmv_bytes(no_nodes, no_edges,
+                                              graph.index_width, 0);
+  timer_stop(&timer, "setup");
+  perf_profile_stop(&prof, "setup", 0.);
+  perf_read(&counters, iter_counts);
+
+  /* Computing HITS, a and h being the dominant right and left singular
+   * vectors of L, by Lanczos bidiagonalization instead of the power
+   * iteration */
+  if (no_pairs > 0) {
+    printf("Computing HITS by Lanczos bidiagonalization, %d pair%s (%s "
+           "kernel, %s layout, %d thread%s)...\n",
+           no_pairs, no_pairs > 1 ? "s" : "", kernel->name,
+           use_sell ? "sell" : "csr", no_threads, no_threads > 1 ? "s" : "");
+    it.team = team;
+    spmv_begin = timer_now();
+    if (lanczos_svd(&lanczos, team, no_nodes, hits_product, &it, no_pairs,
+                    LANCZOS_DIM, TOL, 2 * MAX_ITER) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Not enough memory for the Lanczos bases\n");
+      exit(EXIT_FAILURE);
+    }
+    spmv_time = timer_now() - spmv_begin;
 
-  /* Computing HITS */
-  printf("Computing HITS...\n");
-  begin = clock();
+    /* The dominant pair, nonnegative, normalized as the power iteration */
+    scale = hits_sign(lanczos.v, no_nodes);
+    for (i = 0, sum = 0.; i < no_nodes; ++i)
+      sum += scale * lanczos.v[i];
+    for (i = 0; i < no_nodes; ++i)
+      a[i] = scale * lanczos.v[i] / sum;
+    for (i = 0, sum = 0.; i < no_nodes; ++i)
+      sum += scale * lanczos.u[i];
+    for (i = 0; i < no_nodes; ++i)
+      h[i] = scale * lanczos.u[i] / sum;
+    a_dist = h_dist = 0.;
+  } else
+    printf("Computing HITS (%s kernel, %s layout, %d thread%s)...\n",
+           kernel->name, use_sell ? "sell" : "csr", no_threads,
+           no_threads > 1 ? "s" : "");
   while ((a_dist > TOL || h_dist > TOL) && iter < MAX_ITER) {
     if (iter % MOD_ITER == 0) {
       printf("\riter %d", iter);
 #ifdef DEBUG
       printf("\n");
       printf("a: ");
-      print_vec_f(a, no_nodes);
+      print_vec_f(it.a, no_nodes);
       printf("h: ");
-      print_vec_f(h, no_nodes);
+      print_vec_f(it.h, no_nodes);
 #endif
     }
 
     /* a_new = Lt @ h, h_new = L @ a */
-    for (ri = 0; ri < no_nodes; ++ri) {
-      a_new[ri] = 0.;
-      for (ci = row_ptr_t[ri]; ci < row_ptr_t[ri + 1]; ++ci)
-        a_new[ri] += h[col_ind_t[ci]];
-      h_new[ri] = .0;
-      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
-        h_new[ri] += a[col_ind[ci]];
-    }
+    spmv_begin = timer_now();
+    team_run(team, hits_spmv_task, &it);
+    spmv_time += timer_now() - spmv_begin;
 
     /* Normalization step */
-    sum = 0.;
-    for (i = 0; i < no_nodes; ++i)
-      sum += a_new[i];
-    for (i = 0; i < no_nodes; ++i)
-      a_new[i] /= sum;
-    sum = 0.;
-    for (i = 0; i < no_nodes; ++i)
-      sum += h_new[i];
-    for (i = 0; i < no_nodes; ++i)
-      h_new[i] /= sum;
+    it.a_sum = 0.;
+    it.h_sum = 0.;
+    for (t = 0; t < no_threads; ++t) {
+      it.a_sum += it.partial[t].a_sum;
+      it.h_sum += it.partial[t].h_sum;
+    }
+    team_run(team, hits_normalize_task, &it);
 
     /* Computing distance between current and old a/h */
     a_dist = 0.;
     h_dist = 0.;
-    for (i = 0; i < no_nodes; ++i) {
-      a_dist += (a[i] - a_new[i]) * (a[i] - a_new[i]);
-      h_dist += (h[i] - h_new[i]) * (h[i] - h_new[i]);
+    for (t = 0; t < no_threads; ++t) {
+      a_dist += it.partial[t].a_dist;
+      h_dist += it.partial[t].h_dist;
     }
     a_dist = sqrt(a_dist);
     h_dist = sqrt(h_dist);
 
-    /* Copy new values in a/h */
-    for (i = 0; i < no_nodes; ++i) {
-      a[i] = a_new[i];
-      h[i] = h_new[i];
-    }
+    /* New values become the current a/h */
+    a = it.a_new;
+    it.a_new = it.a;
+    it.a = a;
+    h = it.h_new;
+    it.h_new = it.h;
+    it.h = h;
 
     ++iter;
+
+    /* Top-K workloads stop once the orders of both top-K settle; audited,
+     * the iterations go on to the tolerance */
+    if (it.a_topk != NULL) {
+      stable = topk_merge(it.a_topk);
+      if (topk_merge(it.h_topk) < stable)
+        stable = it.h_topk->stable;
+      if (stable >= rounds && stop_iter == 0 &&
+          (a_dist > TOL || h_dist > TOL)) {
+        stop_iter = iter;
+        memcpy(early_a, it.a_topk->top, sizeof(int) * track_k);
+        memcpy(early_h, it.h_topk->top, sizeof(int) * track_k);
+        if (!audit)
+          break;
+      }
+    }
+
+    /* SpMV traffic plus the normalization reading the old and new vectors
+     * and writing the new ones */
+    if (profile) {
+      sprintf(prof_label, "iter %d", iter);
+      perf_profile_stop(&prof, prof_label,
+                        bytes_per_iter + 6. * sizeof(double) * no_nodes);
+    }
   }
-  end = clock();
+  elapsed_time = timer_stop(&timer, "iterate");
+  perf_read(&counters, counts);
+  for (t = 0; t < PERF_EVENTS; ++t)
+    counts[t] = counts[t] >= 0. ? counts[t] - iter_counts[t] : -1.;
+  a_new = it.a_new;
+  h_new = it.h_new;
+  if (no_pairs > 0)
+    iter = lanczos.no_products / 2; /* one product with L and one with L^T */
   printf("\riter %d\n", iter);
+
+  /* Where the top-K stopped, and audited what the tolerance changed in them */
+  if (it.a_topk != NULL) {
+    if (stop_iter == 0)
+      printf("Top-%d not stable before the tolerance\n", track_k);
+    else if (!audit)
+      printf("Top-%d stable for %d iterations: stopped at iteration %d, "
+             "distances %.2e (a), %.2e (h)\n",
+             track_k, rounds, stop_iter, a_dist, h_dist);
+    else {
+      for (i = 0, t = 0, stable = 0; i < track_k; ++i) {
+        t += early_a[i] == it.a_topk->top[i];
+        stable += early_h[i] == it.h_topk->top[i];
+      }
+      printf("Top-%d stable for %d iterations at iteration %d, tolerance "
+             "at %d: %d iterations saved, %d (a) and %d (h) of %d in the "
+             "same place\n",
+             track_k, rounds, stop_iter, iter, iter - stop_iter, t, stable,
+             track_k);
+    }
+    topk_free(it.a_topk);
+    topk_free(it.h_topk);
+    free(early_a);
+    free(early_h);
+  }
 #ifdef DEBUG
   printf("a: ");
   print_vec_f(a, no_nodes);
@@ -432,21 +604,66 @@ int main(int argc, char *argv[]) {
     sum += h[i];
   printf("sum(h) = %f\n\n", sum);
 
-  elapsed_time = (double)(end - begin) / CLOCKS_PER_SEC;
   printf("Elapsed time: %.3fs\n", elapsed_time);
+  if (no_pairs > 0) {
+    printf("Lanczos: %d SpMVs, %d restart%s, %d of %d pairs converged\n",
+           lanczos.no_products, lanczos.no_restarts,
+           lanczos.no_restarts != 1 ? "s" : "", lanczos.no_converged,
+           lanczos.no_pairs);
+    for (i = 0; i < lanczos.no_pairs; ++i)
+      printf("  sigma_%d = %.6f (residual %.1e)\n", i + 1, lanczos.sigma[i],
+             lanczos.resid[i]);
+  } else
+    printf("SpMVs: %d\n", 2 * iter);
+  printf("Peak memory: %.1f MB (%.1f bytes per edge)\n", mem_peak_rss() / 1e6,
+         no_edges > 0 ? (double)mem_peak_rss() / no_edges : 0.);
+  if (iter > 0 && spmv_time > 0.)
+    printf("SpMV (%s, %s): %.3fs, %.2f GB/s, %.2f GFLOP/s\n", kernel->name,
+           use_sell ? "sell" : "csr", spmv_time,
+           bytes_per_iter * iter / spmv_time / 1e9,
+           2. * spmv_flops(no_edges, 0) * iter / spmv_time / 1e9);
+
+  /* Memory placement report */
+  printf("\nMemory: %d thread%s, %d NUMA node%s, placement %s, %s pages\n",
+         no_threads, no_threads > 1 ? "s" : "", mem_no_nodes(),
+         mem_no_nodes() > 1 ? "s" : "", mem_place_name(place),
+         mem_pages_name(pages));
+  if (counts[PERF_DTLB_MISSES] >= 0. && iter > 0)
+    printf("dTLB load misses: %.0f (%.3f per edge per iteration)\n",
+           counts[PERF_DTLB_MISSES],
+           counts[PERF_DTLB_MISSES] / iter /
+               (no_edges > 0 ? 2. * no_edges : 1.));
+  else
+    printf("dTLB load misses: n/a\n");
+  if (counts[PERF_NODE_LOADS] > 0. && counts[PERF_NODE_MISSES] >= 0.)
+    printf("Remote accesses: %.2f%% of node loads\n",
+           100. * counts[PERF_NODE_MISSES] / counts[PERF_NODE_LOADS]);
+  else
+    printf("Remote accesses: n/a\n");
+  mem_print_placement("authority vector", a, it.bounds_t, NULL,
+                      sizeof(double), nodes, no_threads);
+  mem_print_placement("hub vector", h, it.bounds, NULL, sizeof(double), nodes,
+                      no_threads);
+  if (!use_sell)
+    mem_print_placement("col_ind_t", col_ind_t, it.bounds_t, row_ptr_t,
+                        graph.index_width, nodes, no_threads);
+  if (profile)
+    peak_bw = perf_peak_bandwidth(team, pages);
+  team_destroy(team);
+  printf("\n");
 
   /* Computing top-K Jaccard coefficients */
-  if (argc > 2) {
+  if (argc - optind > 1) {
     double **jaccard_coefficients_a, **jaccard_coefficients_h;
     int *sorted_idx_a, *sorted_idx_h;
     int *degs;
     char topk_jac_fname[512];
     double jaccard_coefficient;
-    int size_int, size_uni;
     int i, j, k;
-    int ii, jj;
 
-    sscanf(argv[2], "%d", &top_K);
+    timer_start(&timer);
+    perf_profile_start(&prof);
+    sscanf(argv[optind + 1], "%d", &top_K);
 
     /* Creating the K x K matrixes for the top-K Jaccard Coefficients */
     jaccard_coefficients_a = (double **)malloc(top_K * sizeof(double *));
@@ -461,14 +678,16 @@ int main(int argc, char *argv[]) {
     sorted_idx_h = index_sort_top_K(h, no_nodes, top_K);
 
     printf("Top-K nodes (a): ");
-    print_vec_d(sorted_idx_a, top_K);
+    print_vec_id(graph.ids, sorted_idx_a, top_K);
     printf("Top-K nodes (h): ");
-    print_vec_d(sorted_idx_h, top_K);
+    print_vec_id(graph.ids, sorted_idx_h, top_K);
+    timer_stop(&timer, "topk");
+    perf_profile_stop(&prof, "topk", 0.);
 
     degs = (int *)malloc(sizeof(int) * top_K);
     for (k = 0; k < top_K; ++k) {
       i = sorted_idx_a[k];
-      degs[k] = row_ptr_t[i + 1] - row_ptr_t[i];
+      degs[k] = (int)(row_ptr_t[i + 1] - row_ptr_t[i]);
     }
     printf("Degree distribution (a): ");
     print_vec_d(degs, top_K);
@@ -486,38 +705,17 @@ int main(int argc, char *argv[]) {
     /* Computing Jaccard with a */
     for (i = 0; i < top_K; ++i) {
       for (j = i + 1; j < top_K; ++j) {
-        size_int = 0;
-        size_uni = 0;
-
-        ii = row_ptr_t[sorted_idx_a[i]];
-        jj = row_ptr_t[sorted_idx_a[j]];
-        while (ii < row_ptr_t[ii + 1] && jj < row_ptr_t[jj + 1]) {
-          if (col_ind_t[ii] < col_ind_t[jj])
-            ++ii;
-          else if (col_ind_t[ii] > col_ind_t[jj])
-            ++jj;
-          else {
-            ++size_int;
-            ++ii;
-            ++jj;
-          }
-          ++size_uni;
-        }
-        while (ii < row_ptr_t[ii + 1]) {
-          ++ii;
-          ++size_uni;
-        }
-        while (jj < row_ptr_t[jj + 1]) {
-          ++jj;
-          ++size_uni;
-        }
-        jaccard_coefficient = ((double)size_int) / ((double)size_uni);
+        jaccard_coefficient =
+            jaccard(row_ptr_t, col_ind_t, graph.index_width, sorted_idx_a[i],
+                    sorted_idx_a[j]);
         jaccard_coefficients_a[i][j] = jaccard_coefficient;
         jaccard_coefficients_a[j][i] = jaccard_coefficient;
-        printf("J(%d,%d) = %.3f\n", sorted_idx_a[i], sorted_idx_a[j],
-               jaccard_coefficient);
-        fprintf(pf, "%d,%d,%.3f\n", sorted_idx_a[i], sorted_idx_a[j],
-                jaccard_coefficient);
+        printf("J(%lu,%lu) = %.3f\n",
+               (unsigned long)graph.ids[sorted_idx_a[i]],
+               (unsigned long)graph.ids[sorted_idx_a[j]], jaccard_coefficient);
+        fprintf(pf, "%lu,%lu,%.3f\n",
+                (unsigned long)graph.ids[sorted_idx_a[i]],
+                (unsigned long)graph.ids[sorted_idx_a[j]], jaccard_coefficient);
       }
     }
     printf("\n");
@@ -527,35 +725,22 @@ int main(int argc, char *argv[]) {
     /* Computing Jaccard with h */
     for (k = 0; k < top_K; ++k) {
       i = sorted_idx_h[k];
-      degs[k] = row_ptr_t[i + 1] - row_ptr_t[i];
+      degs[k] = (int)(row_ptr_t[i + 1] - row_ptr_t[i]);
     }
     printf("Degree distribution (h): ");
     print_vec_d(degs, top_K);
 
     for (i = 0; i < top_K; ++i) {
-      for (j = i; j < top_K; ++j) {
-        size_int = 0;
-        size_uni = 0;
-
-        ii = row_ptr_t[sorted_idx_h[i]];
-        jj = row_ptr_t[sorted_idx_h[j]];
-        while (ii < row_ptr_t[i + 1] && jj < row_ptr_t[j + 1]) {
-          if (col_ind_t[ii] < col_ind_t[jj])
-            ++ii;
-          else if (col_ind_t[ii] < col_ind_t[jj])
-            ++jj;
-          else {
-            ++size_int;
-            ++ii;
-            ++jj;
-          }
-          ++size_uni;
-        }
-        jaccard_coefficient = ((double)size_int) / ((double)size_uni);
+      for (j = i + 1; j < top_K; ++j) {
+        jaccard_coefficient =
+            jaccard(row_ptr_t, col_ind_t, graph.index_width, sorted_idx_h[i],
+                    sorted_idx_h[j]);
         jaccard_coefficients_h[i][j] = jaccard_coefficient;
         jaccard_coefficients_h[j][i] = jaccard_coefficient;
       }
     }
+    timer_stop(&timer, "jaccard");
+    perf_profile_stop(&prof, "jaccard", 0.);
 
     free(degs);
 
@@ -570,21 +755,87 @@ int main(int argc, char *argv[]) {
   }
 
   /* un-mmapping data */
-  munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-  munmap(row_ptr_t, (no_nodes + 1) * sizeof(int));
-  munmap(col_ind, no_edges * sizeof(int));
-  munmap(col_ind_t, no_edges * sizeof(int));
+  if (use_sell) {
+    sell_free(&sell);
+    sell_free(&sell_t);
+  }
+  if (place != MEM_PLACE_NONE && !use_sell) {
+    mem_free(row_ptr, (no_nodes + 1) * sizeof(long));
+    mem_free(row_ptr_t, (no_nodes + 1) * sizeof(long));
+    mem_free(col_ind, no_edges * graph.index_width);
+    mem_free(col_ind_t, no_edges * graph.index_width);
+  }
 
-  /* Writing data back to memory */
-  err = (write_data(fauth, (void *)a, sizeof(double), no_nodes) ==
+  /* Writing data back to memory, in increasing input id order */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  graph_unpermute(&graph, a, a_new);
+  graph_unpermute(&graph, h, h_new);
+  err = (write_data(fauth, (void *)a_new, sizeof(double), no_nodes) ==
          EXIT_FAILURE) ||
-        (write_data(fhub, (void *)h, sizeof(double), no_nodes) == EXIT_FAILURE);
+        (write_data(fhub, (void *)h_new, sizeof(double), no_nodes) ==
+         EXIT_FAILURE);
+  /* Further pairs as they are, unit 2-norm and signed, in <name>_a<i>.hits
+   * and <name>_h<i>.hits */
+  if (no_pairs > 0) {
+    for (t = 1; t < lanczos.no_pairs && !err; ++t) {
+      graph_unpermute(&graph, lanczos.v + (long)t * no_nodes, a_new);
+      graph_unpermute(&graph, lanczos.u + (long)t * no_nodes, h_new);
+      sprintf(fpair, "%s_a%d.hits", fname, t + 1);
+      err = write_data(fpair, (void *)a_new, sizeof(double), no_nodes) ==
+            EXIT_FAILURE;
+      sprintf(fpair, "%s_h%d.hits", fname, t + 1);
+      err = err || write_data(fpair, (void *)h_new, sizeof(double),
+                              no_nodes) == EXIT_FAILURE;
+    }
+    lanczos_free(&lanczos);
+  }
+  if (graph.data.sparse_ids)
+    err = graph_write_ids(&graph, fids) == EXIT_FAILURE || err;
+  graph_close(&graph);
+  timer_stop(&timer, "output");
+  perf_profile_stop(&prof, "output", 0.);
+  perf_close(&counters);
+
+  /* Per phase and per iteration counters */
+  if (profile) {
+    printf("\nProfile:\n");
+    perf_profile_print(&prof, peak_bw, stdout);
+    if (prof_p != NULL)
+      err = err || perf_profile_csv(&prof, prof_p) == EXIT_FAILURE;
+  }
+  perf_profile_free(&prof);
+
+  /* Phase timings for the benchmarks */
+  if (json_p != NULL) {
+    if ((pjson = fopen(json_p, "w")) == NULL) {
+      fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", json_p);
+      err = 1;
+    } else {
+      fprintf(pjson,
+              "{\"tool\": \"hits\", \"input\": \"%s\", \"nodes\": %d, "
+              "\"edges\": %ld, \"kernel\": \"%s\", \"layout\": \"%s\", "
+              "\"threads\": %d, \"iterations\": %d, \"peak_rss\": %ld, "
+              "\"phases\": ",
+              input, no_nodes, no_edges, kernel->name,
+              use_sell ? "sell" : "csr", no_threads, iter, mem_peak_rss());
+      timer_json(&timer, pjson);
+      fprintf(pjson, "}\n");
+      fclose(pjson);
+    }
+  }
 
   /* Vectors of probability */
-  free(a);
-  free(a_new);
-  free(h);
-  free(h_new);
+  mem_free(a, sizeof(double) * no_nodes);
+  mem_free(a_new, sizeof(double) * no_nodes);
+  mem_free(h, sizeof(double) * no_nodes);
+  mem_free(h_new, sizeof(double) * no_nodes);
+  free(it.partial);
+  free(it.bounds);
+  free(it.bounds_t);
+  free(it.chunk_bounds);
+  free(it.chunk_bounds_t);
+  free(nodes);
 
   /* Manage error from writing data to memory */
   if (err) {
@@ -612,118 +863,180 @@ int write_data(char path[], void *data, size_t nmemb, size_t size) {
   return EXIT_SUCCESS;
 }
 
-void delete_folder(char dir[]) {
-  DIR *pf = opendir(dir);
-  struct dirent *next_file;
-  char fpath[PATH];
-
-  while ((next_file = readdir(pf)) != NULL) {
-    sprintf(fpath, "%s/%s", dir, next_file->d_name);
-    remove(fpath);
+/* Jaccard coefficient of the (sorted) neighbourhoods of rows u and v */
+double jaccard(const long *row_ptr, const void *col_ind, int index_width,
+               int u, int v) {
+  long ii = row_ptr[u], jj = row_ptr[v];
+  long size_int = 0, size_uni = 0;
+  int ci, cj;
+
+  while (ii < row_ptr[u + 1] && jj < row_ptr[v + 1]) {
+    ci = GRAPH_ID(col_ind, index_width, ii);
+    cj = GRAPH_ID(col_ind, index_width, jj);
+    if (ci < cj)
+      ++ii;
+    else if (ci > cj)
+      ++jj;
+    else {
+      ++size_int;
+      ++ii;
+      ++jj;
+    }
+    ++size_uni;
   }
-  closedir(pf);
-  rmdir(dir);
-}
-
-void *mmap_data(char path[], size_t nmemb, size_t size) {
-  int fd;
-  char mmap_p[MMAP];
-  void *mp;
-  sprintf(mmap_p, "./%s", path);
-#ifdef DEBUG
-  printf("mmapping \"%s\"\n", mmap_p);
-#endif
-  fd = open(mmap_p, O_RDONLY);
-  mp = mmap(NULL, nmemb * size, PROT_READ, MAP_SHARED, fd, 0);
-  if (mp == MAP_FAILED)
-    mp = NULL;
-  close(fd);
-  return mp;
+  size_uni += (row_ptr[u + 1] - ii) + (row_ptr[v + 1] - jj);
+  return size_uni > 0 ? (double)size_int / (double)size_uni : 0.;
 }
 
-void print_vec_f(double *v, int n) {
+void hits_init_task(int tid, void *arg) {
+  HITS_iteration *it = (HITS_iteration *)arg;
   int i;
-  printf("[ ");
-  for (i = 0; i < n; ++i)
-    printf("%.3f ", v[i]);
-  printf("]\n");
+
+  /* First touch of the vectors by the threads owning the rows */
+  for (i = it->bounds_t[tid]; i < it->bounds_t[tid + 1]; ++i) {
+    it->a[i] = 1.;
+    it->a_new[i] = 0.;
+  }
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i) {
+    it->h[i] = 1.;
+    it->h_new[i] = 0.;
+  }
 }
 
-void print_vec_d(int *v, int n) {
+void hits_spmv_task(int tid, void *arg) {
+  HITS_iteration *it = (HITS_iteration *)arg;
+  double sum;
   int i;
-  printf("[ ");
-  for (i = 0; i < n; ++i)
-    printf("%d ", v[i]);
-  printf("]\n");
-}
 
-void double_merge(int *from, int *to, int lo, int mid, int hi) {
-  int *FL, *TL;
-  int *FR, *TR;
-  int i, j;
-  int NL, NR;
+  if (it->sell != NULL) {
+    it->kernel->sell_pattern(it->sell_t, it->h, it->a_new,
+                             it->chunk_bounds_t[tid],
+                             it->chunk_bounds_t[tid + 1]);
+    it->kernel->sell_pattern(it->sell, it->a, it->h_new,
+                             it->chunk_bounds[tid], it->chunk_bounds[tid + 1]);
+  } else {
+    it->kernel->pattern(it->row_ptr_t, it->col_ind_t, it->h, it->a_new,
+                        it->bounds_t[tid], it->bounds_t[tid + 1]);
+    it->kernel->pattern(it->row_ptr, it->col_ind, it->a, it->h_new,
+                        it->bounds[tid], it->bounds[tid + 1]);
+  }
 
-  NL = mid - lo;
-  NR = hi - mid;
+  sum = 0.;
+  for (i = it->bounds_t[tid]; i < it->bounds_t[tid + 1]; ++i)
+    sum += it->a_new[i];
+  it->partial[tid].a_sum = sum;
+  sum = 0.;
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i)
+    sum += it->h_new[i];
+  it->partial[tid].h_sum = sum;
+}
 
-  FL = (int *)malloc(sizeof(int) * NL);
-  TL = (int *)malloc(sizeof(int) * NL);
-  FR = (int *)malloc(sizeof(int) * NR);
-  TR = (int *)malloc(sizeof(int) * NR);
+void hits_normalize_task(int tid, void *arg) {
+  HITS_iteration *it = (HITS_iteration *)arg;
+  double dist;
+  int i;
 
-  for (i = 0; i < NL; ++i) {
-    FL[i] = from[lo + i];
-    TL[i] = to[lo + i];
+  dist = 0.;
+  for (i = it->bounds_t[tid]; i < it->bounds_t[tid + 1]; ++i) {
+    it->a_new[i] /= it->a_sum;
+    dist += (it->a[i] - it->a_new[i]) * (it->a[i] - it->a_new[i]);
   }
-
-  for (j = 0; j < NR; ++j) {
-    FR[j] = from[mid + j];
-    TR[j] = to[mid + j];
+  it->partial[tid].a_dist = dist;
+  dist = 0.;
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i) {
+    it->h_new[i] /= it->h_sum;
+    dist += (it->h[i] - it->h_new[i]) * (it->h[i] - it->h_new[i]);
   }
-
-  i = 0;
-  j = 0;
-  while (i < NL && j < NR) {
-    if (TL[i] < TR[j] || (TL[i] == TR[j] && FL[i] <= FR[j])) {
-      from[lo + i + j] = FL[i];
-      to[lo + i + j] = TL[i];
-      ++i;
-    } else {
-      from[lo + i + j] = FR[j];
-      to[lo + i + j] = TR[j];
-      ++j;
-    }
+  it->partial[tid].h_dist = dist;
+  if (it->a_topk != NULL) {
+    topk_scan(it->a_topk, tid, it->a_new, it->bounds_t[tid],
+              it->bounds_t[tid + 1]);
+    topk_scan(it->h_topk, tid, it->h_new, it->bounds[tid],
+              it->bounds[tid + 1]);
   }
+}
 
-  while (i < NL) {
-    from[lo + i + j] = FL[i];
-    to[lo + i + j] = TL[i];
-    ++i;
-  }
+void hits_product_task(int tid, void *arg) {
+  HITS_iteration *it = (HITS_iteration *)arg;
+
+  if (it->trans && it->sell != NULL)
+    it->kernel->sell_pattern(it->sell_t, it->x, it->y,
+                             it->chunk_bounds_t[tid],
+                             it->chunk_bounds_t[tid + 1]);
+  else if (it->sell != NULL)
+    it->kernel->sell_pattern(it->sell, it->x, it->y, it->chunk_bounds[tid],
+                             it->chunk_bounds[tid + 1]);
+  else if (it->trans)
+    it->kernel->pattern(it->row_ptr_t, it->col_ind_t, it->x, it->y,
+                        it->bounds_t[tid], it->bounds_t[tid + 1]);
+  else
+    it->kernel->pattern(it->row_ptr, it->col_ind, it->x, it->y,
+                        it->bounds[tid], it->bounds[tid + 1]);
+}
 
-  while (j < NR) {
-    from[lo + i + j] = FR[j];
-    to[lo + i + j] = TR[j];
-    ++j;
-  }
+/* y = L x or L^T x on all the threads, for the Lanczos solver */
+void hits_product(void *ctx, int trans, const double *x, double *y) {
+  HITS_iteration *it = (HITS_iteration *)ctx;
 
-  free(FL);
-  free(TL);
-  free(FR);
-  free(TR);
+  it->trans = trans;
+  it->x = x;
+  it->y = y;
+  team_run(it->team, hits_product_task, it);
 }
 
-void double_merge_sort(int *from, int *to, int lo, int hi) {
-  if (hi - lo > 1) {
-    int mid = (lo + hi) / 2;
-    double_merge_sort(from, to, lo, mid);
-    double_merge_sort(from, to, mid, hi);
-    double_merge(from, to, lo, mid, hi);
-  }
+/* Sign making the largest entry of a singular vector positive; the
+ * dominant ones of L are nonnegative up to that sign */
+double hits_sign(const double *v, int n) {
+  double max = 0.;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (fabs(v[i]) > fabs(max))
+      max = v[i];
+  return max < 0. ? -1. : 1.;
+}
+
+void partition(Team *team, const long *row_ptr, const SELL_matrix *sell,
+               int no_nodes, int *bounds, int *chunk_bounds) {
+  int no_threads = team_size(team);
+  int t;
+
+  if (sell != NULL) {
+    /* Chunk ranges cover whole sigma windows, so rows are not shared */
+    team_partition(sell->chunk_ptr, sell->data.no_chunks, no_threads,
+                   sell->data.sigma / SELL_C, chunk_bounds);
+    for (t = 0; t <= no_threads; ++t)
+      bounds[t] = (chunk_bounds[t] * SELL_C < no_nodes)
+                      ? chunk_bounds[t] * SELL_C
+                      : no_nodes;
+  } else
+    team_partition(row_ptr, no_nodes, no_threads, 1, bounds);
+}
+
+void print_vec_f(double *v, int n) {
+  int i;
+  printf("[ ");
+  for (i = 0; i < n && i < MAX_PRINT; ++i)
+    printf("%.3f ", v[i]);
+  if (n > MAX_PRINT)
+    printf("... (%d more) ", n - MAX_PRINT);
+  printf("]\n");
 }
 
-void sort_input_data(int *from, int *to, int n) {
-  double_merge_sort(from, to, 0, n);
+void print_vec_d(int *v, int n) {
+  int i;
+  printf("[ ");
+  for (i = 0; i < n; ++i)
+    printf("%d ", v[i]);
+  printf("]\n");
+}
+
+void print_vec_id(const uint64_t *ids, int *v, int n) {
+  int i;
+  printf("[ ");
+  for (i = 0; i < n; ++i)
+    printf("%lu ", (unsigned long)ids[v[i]]);
+  printf("]\n");
 }
 
 int cmp_ptr(const void *a, const void *b) {
@@ -749,4 +1062,96 @@ int *index_sort_top_K(const double *v, size_t n, int top_K) {
     idx[i] = ptrs[n - i - 1] - v;
   free(ptrs);
   return idx;
-}
\ No newline at end of file
+}
+
+/* One query per line of in, the input ids of its root set separated by
+ * blanks or commas; answered one by one, with the top-K of each ranking */
+int run_queries(const Graph *g, FILE *in, int top_K) {
+  Query_engine q;
+  Query_result r;
+  Topk a_top, h_top;
+  uint64_t *ids = NULL;
+  int no_ids, max_ids = 0, no_queries = 0, k;
+  char *line = NULL, *s, *p;
+  size_t len = 0;
+  double begin, elapsed, total = 0.;
+  int i;
+
+  if (top_K < 1)
+    top_K = 1;
+  if (query_init(&q, g, QUERY_MAX_IN, TOL, MAX_ITER) == EXIT_FAILURE ||
+      topk_create(&a_top, top_K, 1) == EXIT_FAILURE ||
+      topk_create(&h_top, top_K, 1) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Not enough memory for the queries\n");
+    return EXIT_FAILURE;
+  }
+
+  while (getline(&line, &len, in) != -1) {
+    /* At most one id every two characters */
+    if ((int)len / 2 + 1 > max_ids) {
+      max_ids = (int)len / 2 + 1;
+      free(ids);
+      if ((ids = (uint64_t *)malloc(sizeof(uint64_t) * max_ids)) == NULL) {
+        fprintf(stderr, " [ERROR] Not enough memory for the queries\n");
+        break;
+      }
+    }
+    no_ids = 0;
+    for (s = line;; s = p) {
+      while (*s == ' ' || *s == '\t' || *s == ',')
+        ++s;
+      ids[no_ids] = strtoul(s, &p, 10);
+      if (p == s)
+        break;
+      ++no_ids;
+    }
+    if (no_ids == 0 && *s != '\n' && *s != '\r' && *s != '\0') {
+      s[strcspn(s, "\r\n")] = '\0';
+      fprintf(stderr, " [ERROR] Query %d: expected node ids, got \"%s\"\n",
+              no_queries + 1, s);
+      continue;
+    }
+    if (no_ids == 0)
+      continue;
+
+    begin = timer_now();
+    if (query_run(&q, ids, no_ids, &r) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Not enough memory for query %d\n",
+              no_queries + 1);
+      continue;
+    }
+    topk_scan(&a_top, 0, r.a, 0, r.no_base);
+    topk_merge(&a_top);
+    topk_scan(&h_top, 0, r.h, 0, r.no_base);
+    topk_merge(&h_top);
+    elapsed = timer_now() - begin;
+    total += elapsed;
+    ++no_queries;
+
+    printf("Query %d: %d of %d roots, %d base nodes, %ld edges, "
+           "%d iterations, %.3f ms\n",
+           no_queries, r.no_roots, no_ids, r.no_base, r.no_edges, r.iter,
+           elapsed * 1e3);
+    k = r.no_base < top_K ? r.no_base : top_K;
+    printf("Top-K nodes (a): [ ");
+    for (i = 0; i < k; ++i)
+      printf("%lu:%.4f ", (unsigned long)g->ids[r.nodes[a_top.top[i]]],
+             r.a[a_top.top[i]]);
+    printf("]\nTop-K nodes (h): [ ");
+    for (i = 0; i < k; ++i)
+      printf("%lu:%.4f ", (unsigned long)g->ids[r.nodes[h_top.top[i]]],
+             r.h[h_top.top[i]]);
+    printf("]\n\n");
+    fflush(stdout);
+  }
+  if (no_queries > 0)
+    printf("Queries: %d, %.3f ms on average\n", no_queries,
+           total * 1e3 / no_queries);
+
+  free(line);
+  free(ids);
+  topk_free(&a_top);
+  topk_free(&h_top);
+  query_free(&q);
+  return EXIT_SUCCESS;
+}
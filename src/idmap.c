@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "idmap.h"
+
+/* Work of one parallel pass over ids[0, n), of width bytes each */
+typedef struct {
+  Id_map *m;
+  void *ids;
+  int width;
+  long n;
+  long limit;
+  int no_threads;
+} Idmap_task;
+
+static uint64_t idmap_get(const Idmap_task *task, long k) {
+  return task->width == 4 ? ((const uint32_t *)task->ids)[k]
+                          : ((const uint64_t *)task->ids)[k];
+}
+
+/* splitmix64 finalizer */
+static uint64_t idmap_hash(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+  return x ^ (x >> 31);
+}
+
+static int idmap_alloc(Id_map *m, size_t capacity) {
+  m->keys = (uint64_t *)malloc(sizeof(uint64_t) * capacity);
+  m->vals = (int *)malloc(sizeof(int) * capacity);
+  if (m->keys == NULL || m->vals == NULL) {
+    idmap_free(m);
+    return EXIT_FAILURE;
+  }
+  memset(m->keys, 0xff, sizeof(uint64_t) * capacity);
+  m->mask = capacity - 1;
+  m->no_ids = 0;
+  m->overflow = 0;
+  return EXIT_SUCCESS;
+}
+
+/* Slot of id, or the empty slot where it would go */
+static size_t idmap_slot(const Id_map *m, uint64_t id) {
+  size_t h = idmap_hash(id) & m->mask;
+
+  while (m->keys[h] != id && m->keys[h] != IDMAP_EMPTY)
+    h = (h + 1) & m->mask;
+  return h;
+}
+
+int idmap_create(Id_map *m, long max_ids) {
+  size_t capacity = 64;
+
+  memset(m, 0, sizeof(Id_map));
+  while (capacity < 2 * (size_t)max_ids)
+    capacity <<= 1;
+  return idmap_alloc(m, capacity);
+}
+
+void idmap_free(Id_map *m) {
+  free(m->keys);
+  free(m->vals);
+  m->keys = NULL;
+  m->vals = NULL;
+}
+
+/* Doubles the table, rehashing the ids found so far */
+static int idmap_grow(Id_map *m) {
+  Id_map old = *m;
+  size_t h;
+  long no_ids = 0;
+
+  if (idmap_alloc(m, 2 * (old.mask + 1)) == EXIT_FAILURE) {
+    *m = old;
+    return EXIT_FAILURE;
+  }
+  for (h = 0; h <= old.mask; ++h)
+    if (old.keys[h] != IDMAP_EMPTY) {
+      m->keys[idmap_slot(m, old.keys[h])] = old.keys[h];
+      ++no_ids;
+    }
+  m->no_ids = no_ids;
+  idmap_free(&old);
+  return EXIT_SUCCESS;
+}
+
+static void idmap_insert_task(int tid, void *arg) {
+  Idmap_task *task = (Idmap_task *)arg;
+  Id_map *m = task->m;
+  volatile uint64_t *keys = m->keys;
+  volatile int *overflow = &m->overflow;
+  long lo = task->n * tid / task->no_threads;
+  long hi = task->n * (tid + 1) / task->no_threads;
+  uint64_t id, key;
+  size_t h;
+  long k;
+
+  for (k = lo; k < hi && !*overflow; ++k) {
+    id = idmap_get(task, k);
+    for (h = idmap_hash(id) & m->mask;; h = (h + 1) & m->mask) {
+      if ((key = keys[h]) == id)
+        break;
+      if (key != IDMAP_EMPTY)
+        continue;
+      /* Claiming the slot, unless another thread got it first */
+      if ((key = __sync_val_compare_and_swap(keys + h, IDMAP_EMPTY, id)) ==
+          IDMAP_EMPTY) {
+        if (__sync_add_and_fetch(&m->no_ids, 1) > task->limit)
+          *overflow = 1;
+        break;
+      }
+      if (key == id)
+        break;
+    }
+  }
+}
+
+int idmap_insert(Id_map *m, Team *team, const void *ids, int width,
+                 long n) {
+  Idmap_task task;
+
+  task.m = m;
+  task.ids = (void *)ids;
+  task.width = width;
+  task.n = n;
+  task.no_threads = team_size(team);
+  for (;;) {
+    task.limit = (long)((m->mask + 1) / 2);
+    team_run(team, idmap_insert_task, &task);
+    if (!m->overflow)
+      return EXIT_SUCCESS;
+    /* Too many ids for the table: growing it and inserting them again */
+    if (idmap_grow(m) == EXIT_FAILURE)
+      return EXIT_FAILURE;
+  }
+}
+
+static int idmap_cmp(const void *x, const void *y) {
+  uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+
+  return (a > b) - (a < b);
+}
+
+static void idmap_number_task(int tid, void *arg) {
+  Idmap_task *task = (Idmap_task *)arg;
+  long lo = task->n * tid / task->no_threads;
+  long hi = task->n * (tid + 1) / task->no_threads;
+  long k;
+
+  for (k = lo; k < hi; ++k)
+    task->m->vals[idmap_slot(task->m, idmap_get(task, k))] = (int)k;
+}
+
+uint64_t *idmap_number(Id_map *m, Team *team) {
+  Idmap_task task;
+  uint64_t *sorted;
+  size_t h;
+  long k;
+
+  if (m->no_ids > 0x7fffffffL ||
+      (sorted = (uint64_t *)malloc(sizeof(uint64_t) *
+                                   (m->no_ids > 0 ? m->no_ids : 1))) == NULL)
+    return NULL;
+  for (h = 0, k = 0; h <= m->mask; ++h)
+    if (m->keys[h] != IDMAP_EMPTY)
+      sorted[k++] = m->keys[h];
+  qsort(sorted, m->no_ids, sizeof(uint64_t), idmap_cmp);
+
+  task.m = m;
+  task.ids = sorted;
+  task.width = sizeof(uint64_t);
+  task.n = m->no_ids;
+  task.no_threads = team_size(team);
+  team_run(team, idmap_number_task, &task);
+  return sorted;
+}
+
+static void idmap_translate_task(int tid, void *arg) {
+  Idmap_task *task = (Idmap_task *)arg;
+  long lo = task->n * tid / task->no_threads;
+  long hi = task->n * (tid + 1) / task->no_threads;
+  long k;
+  int val;
+
+  for (k = lo; k < hi; ++k) {
+    val = task->m->vals[idmap_slot(task->m, idmap_get(task, k))];
+    if (task->width == 4)
+      ((uint32_t *)task->ids)[k] = (uint32_t)val;
+    else
+      ((uint64_t *)task->ids)[k] = (uint64_t)val;
+  }
+}
+
+void idmap_translate(const Id_map *m, Team *team, void *ids, int width,
+                     long n) {
+  Idmap_task task;
+
+  task.m = (Id_map *)m;
+  task.ids = ids;
+  task.width = width;
+  task.n = n;
+  task.no_threads = team_size(team);
+  team_run(team, idmap_translate_task, &task);
+}
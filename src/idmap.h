@@ -0,0 +1,35 @@
+#ifndef IDMAP_H
+#define IDMAP_H
+
+#include <stdint.h>
+
+#include "team.h"
+
+/* Open addressing hash map from the node ids of an input, which may be sparse
+ * and arbitrarily large, to dense numbers in [0, no_ids). Slots are claimed
+ * with an atomic compare-and-swap, so all the threads of a team insert at
+ * once; probing is linear and the table is kept at most half full. */
+#define IDMAP_EMPTY UINT64_MAX
+
+typedef struct {
+  uint64_t *keys;
+  int *vals;
+  size_t mask;
+  long no_ids;
+  int overflow;
+} Id_map;
+
+/* Room for about max_ids distinct ids; the table grows if more are found */
+int idmap_create(Id_map *m, long max_ids);
+void idmap_free(Id_map *m);
+/* Inserts ids[0, n), of width 4 or 8 bytes, which must not be IDMAP_EMPTY */
+int idmap_insert(Id_map *m, Team *team, const void *ids, int width,
+                 long n);
+/* Numbers the distinct ids in increasing order and returns them sorted
+ * (malloc'd), NULL if there are more than 2^31 - 1 */
+uint64_t *idmap_number(Id_map *m, Team *team);
+/* Replaces ids[0, n) with their numbers, in the same width */
+void idmap_translate(const Id_map *m, Team *team, void *ids, int width,
+                     long n);
+
+#endif
@@ -0,0 +1,351 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lanczos.h"
+
+#define JACOBI_SWEEPS 60
+
+/* Shared state of the vector operations, every thread owning an even share
+ * of [0, n) */
+typedef struct {
+  int n;
+  int no_threads;
+  const double *basis; /* k vectors of n */
+  int k;
+  double *w;
+  const double *coef; /* of the combinations, coef[i * ld + j] */
+  int ld, r;
+  double *out; /* r vectors of n */
+  double scale;
+  double *partial; /* stride sums per thread */
+  int stride;
+} Lanczos_vec;
+
+static void lanczos_range(const Lanczos_vec *lv, int tid, long *lo,
+                          long *hi) {
+  *lo = (long)lv->n * tid / lv->no_threads;
+  *hi = (long)lv->n * (tid + 1) / lv->no_threads;
+}
+
+/* partial[i] = basis_i . w */
+static void lanczos_dot_task(int tid, void *arg) {
+  Lanczos_vec *lv = (Lanczos_vec *)arg;
+  double *partial = lv->partial + (long)tid * lv->stride;
+  const double *b;
+  double sum;
+  long lo, hi, x;
+  int i;
+
+  lanczos_range(lv, tid, &lo, &hi);
+  for (i = 0; i < lv->k; ++i) {
+    b = lv->basis + (long)i * lv->n;
+    for (x = lo, sum = 0.; x < hi; ++x)
+      sum += b[x] * lv->w[x];
+    partial[i] = sum;
+  }
+}
+
+/* w -= sum_i coef[i] basis_i, then partial[k] = w . w */
+static void lanczos_sub_task(int tid, void *arg) {
+  Lanczos_vec *lv = (Lanczos_vec *)arg;
+  const double *b;
+  double sum;
+  long lo, hi, x;
+  int i;
+
+  lanczos_range(lv, tid, &lo, &hi);
+  for (i = 0; i < lv->k; ++i) {
+    b = lv->basis + (long)i * lv->n;
+    for (x = lo; x < hi; ++x)
+      lv->w[x] -= lv->coef[i] * b[x];
+  }
+  for (x = lo, sum = 0.; x < hi; ++x)
+    sum += lv->w[x] * lv->w[x];
+  lv->partial[(long)tid * lv->stride + lv->k] = sum;
+}
+
+/* out_j = sum_i coef[i * ld + j] basis_i, j < r */
+static void lanczos_combine_task(int tid, void *arg) {
+  Lanczos_vec *lv = (Lanczos_vec *)arg;
+  const double *b;
+  double *out, c;
+  long lo, hi, x;
+  int i, j;
+
+  lanczos_range(lv, tid, &lo, &hi);
+  for (j = 0; j < lv->r; ++j) {
+    out = lv->out + (long)j * lv->n;
+    for (x = lo; x < hi; ++x)
+      out[x] = 0.;
+    for (i = 0; i < lv->k; ++i) {
+      b = lv->basis + (long)i * lv->n;
+      c = lv->coef[i * lv->ld + j];
+      for (x = lo; x < hi; ++x)
+        out[x] += c * b[x];
+    }
+  }
+}
+
+static void lanczos_scale_task(int tid, void *arg) {
+  Lanczos_vec *lv = (Lanczos_vec *)arg;
+  long lo, hi, x;
+
+  lanczos_range(lv, tid, &lo, &hi);
+  for (x = lo; x < hi; ++x)
+    lv->w[x] *= lv->scale;
+}
+
+/* Orthogonalizes w against the k vectors of basis by classical Gram-Schmidt
+ * applied twice, adding the projections to c. Returns ||w||. */
+static double lanczos_orth(Lanczos_vec *lv, Team *team, const double *basis,
+                           int k, double *w, double *c) {
+  double coef[2 * LANCZOS_DIM + 2];
+  double norm = 0.;
+  int pass, t, i;
+
+  lv->basis = basis;
+  lv->k = k;
+  lv->w = w;
+  lv->coef = coef;
+  for (pass = 0; pass < 2; ++pass) {
+    if (k > 0)
+      team_run(team, lanczos_dot_task, lv);
+    for (i = 0; i < k; ++i) {
+      for (t = 0, coef[i] = 0.; t < lv->no_threads; ++t)
+        coef[i] += lv->partial[(long)t * lv->stride + i];
+      c[i] += coef[i];
+    }
+    team_run(team, lanczos_sub_task, lv);
+    for (t = 0, norm = 0.; t < lv->no_threads; ++t)
+      norm += lv->partial[(long)t * lv->stride + k];
+    if (k == 0)
+      break;
+  }
+  return sqrt(norm);
+}
+
+static void lanczos_scale(Lanczos_vec *lv, Team *team, double *w, double s) {
+  lv->w = w;
+  lv->scale = s;
+  team_run(team, lanczos_scale_task, lv);
+}
+
+/* out_j = basis coef_j for the first r columns of the k x k coef */
+static void lanczos_combine(Lanczos_vec *lv, Team *team, const double *basis,
+                            int k, const double *coef, int r, double *out) {
+  lv->basis = basis;
+  lv->k = k;
+  lv->coef = coef;
+  lv->ld = k;
+  lv->r = r;
+  lv->out = out;
+  team_run(team, lanczos_combine_task, lv);
+}
+
+/* SVD B = X diag(sigma) Y^T of the k x k matrix B (leading dimension ld) by
+ * one-sided Jacobi rotations of its columns, largest sigma first; X and Y
+ * are k x k, pair j in column j */
+static void lanczos_jacobi(int k, const double *B, int ld, double *sigma,
+                           double *X, double *Y) {
+  double alpha, beta, gamma, zeta, t, c, s, tmp, off;
+  int sweep, i, j, p, q;
+
+  for (i = 0; i < k; ++i)
+    for (j = 0; j < k; ++j) {
+      X[i * k + j] = B[i * ld + j];
+      Y[i * k + j] = i == j;
+    }
+  for (sweep = 0; sweep < JACOBI_SWEEPS; ++sweep) {
+    off = 0.;
+    for (p = 0; p < k - 1; ++p)
+      for (q = p + 1; q < k; ++q) {
+        alpha = beta = gamma = 0.;
+        for (i = 0; i < k; ++i) {
+          alpha += X[i * k + p] * X[i * k + p];
+          beta += X[i * k + q] * X[i * k + q];
+          gamma += X[i * k + p] * X[i * k + q];
+        }
+        if (gamma == 0. || fabs(gamma) <= 1.e-15 * sqrt(alpha * beta))
+          continue;
+        if (fabs(gamma) / sqrt(alpha * beta) > off)
+          off = fabs(gamma) / sqrt(alpha * beta);
+        zeta = (beta - alpha) / (2. * gamma);
+        t = (zeta >= 0. ? 1. : -1.) / (fabs(zeta) + sqrt(1. + zeta * zeta));
+        c = 1. / sqrt(1. + t * t);
+        s = c * t;
+        for (i = 0; i < k; ++i) {
+          tmp = X[i * k + p];
+          X[i * k + p] = c * tmp - s * X[i * k + q];
+          X[i * k + q] = s * tmp + c * X[i * k + q];
+          tmp = Y[i * k + p];
+          Y[i * k + p] = c * tmp - s * Y[i * k + q];
+          Y[i * k + q] = s * tmp + c * Y[i * k + q];
+        }
+      }
+    if (off <= 1.e-15)
+      break;
+  }
+
+  /* Column norms are the singular values */
+  for (j = 0; j < k; ++j) {
+    for (i = 0, sigma[j] = 0.; i < k; ++i)
+      sigma[j] += X[i * k + j] * X[i * k + j];
+    sigma[j] = sqrt(sigma[j]);
+    for (i = 0; i < k; ++i)
+      X[i * k + j] = sigma[j] > 0. ? X[i * k + j] / sigma[j] : 0.;
+  }
+  for (j = 0; j < k; ++j) {
+    for (p = j, q = j + 1; q < k; ++q)
+      if (sigma[q] > sigma[p])
+        p = q;
+    if (p == j)
+      continue;
+    tmp = sigma[j];
+    sigma[j] = sigma[p];
+    sigma[p] = tmp;
+    for (i = 0; i < k; ++i) {
+      tmp = X[i * k + j];
+      X[i * k + j] = X[i * k + p];
+      X[i * k + p] = tmp;
+      tmp = Y[i * k + j];
+      Y[i * k + j] = Y[i * k + p];
+      Y[i * k + p] = tmp;
+    }
+  }
+}
+
+int lanczos_svd(Lanczos *l, Team *team, int n, lanczos_op op, void *ctx,
+                int no_pairs, int max_dim, double tol, int max_products) {
+  Lanczos_vec lv;
+  double *U, *V, *B, *X, *Y, *sigma, *c, *work;
+  double alpha, beta = 0.;
+  int no_threads = team_size(team);
+  int j, k, r, i, done;
+
+  memset(l, 0, sizeof(Lanczos));
+  if (max_dim > 2 * LANCZOS_DIM)
+    max_dim = 2 * LANCZOS_DIM;
+  if (max_dim > n)
+    max_dim = n;
+  if (no_pairs > max_dim - 1)
+    no_pairs = max_dim > 1 ? max_dim - 1 : 1;
+  if (max_dim < no_pairs + 1)
+    max_dim = no_pairs + 1;
+  l->n = n;
+  l->no_pairs = no_pairs;
+
+  lv.n = n;
+  lv.no_threads = no_threads;
+  lv.stride = (max_dim + 2 + 7) / 8 * 8;
+  U = (double *)malloc(sizeof(double) * max_dim * n);
+  V = (double *)malloc(sizeof(double) * (max_dim + 1) * n);
+  work = (double *)malloc(sizeof(double) * no_pairs * n);
+  B = (double *)calloc(max_dim * max_dim, sizeof(double));
+  X = (double *)malloc(sizeof(double) * max_dim * max_dim);
+  Y = (double *)malloc(sizeof(double) * max_dim * max_dim);
+  sigma = (double *)malloc(sizeof(double) * max_dim);
+  c = (double *)malloc(sizeof(double) * (max_dim + 1));
+  lv.partial = (double *)malloc(sizeof(double) * lv.stride * no_threads);
+  l->sigma = (double *)malloc(sizeof(double) * no_pairs);
+  l->resid = (double *)malloc(sizeof(double) * no_pairs);
+  l->u = (double *)malloc(sizeof(double) * no_pairs * n);
+  l->v = (double *)malloc(sizeof(double) * no_pairs * n);
+  if (U == NULL || V == NULL || work == NULL || B == NULL || X == NULL ||
+      Y == NULL || sigma == NULL || c == NULL || lv.partial == NULL ||
+      l->sigma == NULL || l->resid == NULL || l->u == NULL || l->v == NULL) {
+    free(U);
+    free(V);
+    free(work);
+    free(B);
+    free(X);
+    free(Y);
+    free(sigma);
+    free(c);
+    free(lv.partial);
+    lanczos_free(l);
+    return EXIT_FAILURE;
+  }
+
+  /* v_0 = e / sqrt(n) */
+  for (i = 0; i < n; ++i)
+    V[i] = 1. / sqrt((double)n);
+
+  for (j = 0, done = 0; !done;) {
+    /* u_j = A v_j without its projections on u_0..u_(j-1), which are
+     * column j of B */
+    op(ctx, 0, V + (long)j * n, U + (long)j * n);
+    ++l->no_products;
+    memset(c, 0, sizeof(double) * (j + 1));
+    alpha = lanczos_orth(&lv, team, U, j, U + (long)j * n, c);
+    for (i = 0; i < j; ++i)
+      B[i * max_dim + j] = c[i];
+    B[j * max_dim + j] = alpha;
+    lanczos_scale(&lv, team, U + (long)j * n, alpha > 0. ? 1. / alpha : 0.);
+
+    /* v_(j+1) = A^T u_j without its projections on v_0..v_j */
+    op(ctx, 1, U + (long)j * n, V + (long)(j + 1) * n);
+    ++l->no_products;
+    memset(c, 0, sizeof(double) * (j + 2));
+    beta = lanczos_orth(&lv, team, V, j + 1, V + (long)(j + 1) * n, c);
+    k = j + 1;
+
+    /* Ritz pairs of B: A^T u_i - sigma_i v_i = beta v_(j+1) X[j][i] */
+    lanczos_jacobi(k, B, max_dim, sigma, X, Y);
+    r = k < no_pairs ? k : no_pairs;
+    for (i = 0, l->no_converged = 0; i < r; ++i) {
+      l->resid[i] = beta * fabs(X[(k - 1) * k + i]);
+      l->no_converged += l->resid[i] <= tol * sigma[0];
+    }
+    done = l->no_converged == no_pairs || beta <= 1.e-14 * sigma[0] ||
+           k == n || l->no_products + 2 > max_products;
+    if (done)
+      break;
+    lanczos_scale(&lv, team, V + (long)(j + 1) * n, 1. / beta);
+
+    if (k < max_dim) {
+      ++j;
+      continue;
+    }
+
+    /* Thick restart: the wanted Ritz vectors and v_(j+1) start the new
+     * bases, B holding their singular values */
+    lanczos_combine(&lv, team, V, k, Y, no_pairs, work);
+    memcpy(V, work, sizeof(double) * no_pairs * n);
+    memcpy(V + (long)no_pairs * n, V + (long)k * n, sizeof(double) * n);
+    lanczos_combine(&lv, team, U, k, X, no_pairs, work);
+    memcpy(U, work, sizeof(double) * no_pairs * n);
+    memset(B, 0, sizeof(double) * max_dim * max_dim);
+    for (i = 0; i < no_pairs; ++i)
+      B[i * max_dim + i] = sigma[i];
+    j = no_pairs;
+    ++l->no_restarts;
+  }
+
+  /* The wanted pairs from the bases */
+  r = k < no_pairs ? k : no_pairs;
+  l->no_pairs = r;
+  memcpy(l->sigma, sigma, sizeof(double) * r);
+  lanczos_combine(&lv, team, V, k, Y, r, l->v);
+  lanczos_combine(&lv, team, U, k, X, r, l->u);
+
+  free(U);
+  free(V);
+  free(work);
+  free(B);
+  free(X);
+  free(Y);
+  free(sigma);
+  free(c);
+  free(lv.partial);
+  return EXIT_SUCCESS;
+}
+
+void lanczos_free(Lanczos *l) {
+  free(l->sigma);
+  free(l->resid);
+  free(l->u);
+  free(l->v);
+  l->sigma = l->resid = l->u = l->v = NULL;
+}
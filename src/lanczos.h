@@ -0,0 +1,35 @@
+#ifndef LANCZOS_H
+#define LANCZOS_H
+
+/* Largest singular triplets of a square sparse matrix A by Golub-Kahan-Lanczos
+ * bidiagonalization: A V = U B, V and U orthonormal bases grown by one
+ * product with A and one with A^T per step, B upper triangular. The singular
+ * values of the small B converge to the largest ones of A, the wanted ones
+ * well before the basis is complete. The bases are fully reorthogonalized,
+ * and once max_dim vectors long the wanted Ritz vectors and the last v are
+ * kept (thick restart), so memory stays 2 (max_dim + 1) vectors. */
+#define LANCZOS_DIM 24 /* basis vectors before a restart */
+
+#include "team.h"
+
+/* y = A x, or A^T x when trans, for the vectors of the caller */
+typedef void (*lanczos_op)(void *ctx, int trans, const double *x, double *y);
+
+typedef struct {
+  int n;
+  int no_pairs;
+  double *sigma; /* no_pairs singular values, largest first */
+  double *u, *v; /* their left and right vectors, n each, unit 2-norm */
+  double *resid; /* ||A^T u - sigma v|| of every pair */
+  int no_products; /* with A or A^T */
+  int no_restarts;
+  int no_converged; /* pairs with resid <= tol * sigma[0] */
+} Lanczos;
+
+/* no_pairs triplets of the n x n matrix behind op, starting from v = e; the
+ * bases grow to max_dim vectors at most max_products products */
+int lanczos_svd(Lanczos *l, Team *team, int n, lanczos_op op, void *ctx,
+                int no_pairs, int max_dim, double tol, int max_products);
+void lanczos_free(Lanczos *l);
+
+#endif
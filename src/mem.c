@@ -0,0 +1,343 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mem.h"
+
+#define HUGE_PAGE (2UL << 20)
+#define MAX_NODES 64
+#define MAX_SAMPLES 4096
+
+/* Memory policies, see mbind(2) */
+#define POLICY_PREFERRED 1
+#define POLICY_INTERLEAVE 3
+#define POLICY_MOVE (1 << 1)
+
+/* Mappings are always a whole number of huge pages, whatever backs them; an
+ * empty request still maps one, so that it gets a valid pointer */
+static size_t mem_round(size_t size) {
+  if (size == 0)
+    return HUGE_PAGE;
+  return (size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+}
+
+void *mem_alloc(size_t size, int pages) {
+  void *ptr = MAP_FAILED;
+  size_t len = mem_round(size);
+
+#ifdef MAP_HUGETLB
+  if (pages == MEM_PAGES_HUGETLB)
+    ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (ptr == MAP_FAILED) {
+    ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+               -1, 0);
+    if (ptr == MAP_FAILED)
+      return NULL;
+#ifdef MADV_HUGEPAGE
+    if (pages != MEM_PAGES_DEFAULT)
+      madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+  }
+  return ptr;
+}
+
+void mem_free(void *ptr, size_t size) {
+  if (ptr != NULL)
+    munmap(ptr, mem_round(size));
+}
+
+/* Online nodes as a bitmask, read from sysfs ("0", "0-1", "0,2-3") */
+static unsigned long mem_online_mask(void) {
+  static unsigned long mask = 0;
+  FILE *pf;
+  int lo, hi, i;
+  char sep;
+
+  if (mask != 0)
+    return mask;
+  mask = 1;
+  if ((pf = fopen("/sys/devices/system/node/online", "r")) == NULL)
+    return mask;
+  mask = 0;
+  while (fscanf(pf, "%d", &lo) == 1) {
+    hi = lo;
+    sep = (char)fgetc(pf);
+    if (sep == '-' && fscanf(pf, "%d", &hi) == 1)
+      sep = (char)fgetc(pf);
+    for (i = lo; i <= hi && i < MAX_NODES; ++i)
+      mask |= 1UL << i;
+    if (sep != ',')
+      break;
+  }
+  fclose(pf);
+  if (mask == 0)
+    mask = 1;
+  return mask;
+}
+
+int mem_no_nodes(void) {
+  unsigned long mask = mem_online_mask();
+  int n = 0;
+
+  while (mask) {
+    n += mask & 1;
+    mask >>= 1;
+  }
+  return n;
+}
+
+int mem_cpu_node(int cpu) {
+  char path[64];
+  DIR *pd;
+  struct dirent *next_file;
+  int node = 0;
+
+  if (cpu < 0)
+    return 0;
+  sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+  if ((pd = opendir(path)) == NULL)
+    return 0;
+  while ((next_file = readdir(pd)) != NULL)
+    if (sscanf(next_file->d_name, "node%d", &node) == 1)
+      break;
+  closedir(pd);
+  return node;
+}
+
+static int mem_policy(void *ptr, size_t size, int mode, unsigned long mask) {
+  unsigned long start = (unsigned long)ptr & ~(sysconf(_SC_PAGESIZE) - 1UL);
+
+  if (mem_no_nodes() < 2 || size == 0)
+    return EXIT_SUCCESS;
+  if (syscall(SYS_mbind, start, (unsigned long)ptr + size - start, mode, &mask,
+              MAX_NODES, POLICY_MOVE) != 0)
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
+
+int mem_interleave(void *ptr, size_t size) {
+  return mem_policy(ptr, size, POLICY_INTERLEAVE, mem_online_mask());
+}
+
+int mem_bind(void *ptr, size_t size, int node) {
+  return mem_policy(ptr, size, POLICY_PREFERRED, 1UL << node);
+}
+
+double mem_remote_ratio(const void *ptr, const size_t *bounds,
+                        const int *nodes, int no_parts) {
+  long page = sysconf(_SC_PAGESIZE);
+  void *pages[MAX_SAMPLES];
+  int status[MAX_SAMPLES];
+  unsigned long first, last, stride;
+  long located = 0, remote = 0;
+  int count, t, i;
+
+  for (t = 0; t < no_parts; ++t) {
+    if (bounds[t + 1] <= bounds[t])
+      continue;
+    first = ((unsigned long)ptr + bounds[t]) / page;
+    last = ((unsigned long)ptr + bounds[t + 1] - 1) / page;
+    stride = (last - first) / MAX_SAMPLES + 1;
+    for (count = 0; first + count * stride <= last; ++count) {
+      pages[count] = (void *)((first + count * stride) * page);
+      status[count] = -1;
+    }
+    if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0)
+      return -1.;
+    for (i = 0; i < count; ++i) {
+      if (status[i] < 0)
+        continue;
+      ++located;
+      remote += status[i] != nodes[t];
+    }
+  }
+  return located > 0 ? (double)remote / (double)located : -1.;
+}
+
+void *mem_place(Team *team, const void *src, size_t size,
+                const size_t *bounds, int place, int pages) {
+  Mem_copy copy;
+  void *dst;
+  int t;
+
+  if ((dst = mem_alloc(size, pages)) == NULL)
+    return NULL;
+  if (place == MEM_PLACE_INTERLEAVE)
+    mem_interleave(dst, size);
+  else if (place == MEM_PLACE_PARTITION)
+    for (t = 0; t < team_size(team); ++t)
+      mem_bind((char *)dst + bounds[t], bounds[t + 1] - bounds[t],
+               mem_cpu_node(team_cpu(team, t)));
+
+  /* Each thread copies (and so first touches) its own part */
+  copy.src = src;
+  copy.dst = dst;
+  copy.bounds = bounds;
+  team_run(team, mem_copy_task, &copy);
+  return dst;
+}
+
+void mem_copy_task(int tid, void *arg) {
+  Mem_copy *copy = (Mem_copy *)arg;
+
+  memcpy((char *)copy->dst + copy->bounds[tid],
+         (const char *)copy->src + copy->bounds[tid],
+         copy->bounds[tid + 1] - copy->bounds[tid]);
+}
+
+/* Thread t owns the units (rows or edges) [units[bounds[t]],
+ * units[bounds[t + 1]]) of the array, or [bounds[t], bounds[t + 1]) when
+ * units is NULL */
+static size_t *mem_unit_bounds(const int *bounds, const long *units,
+                               size_t unit_size, size_t size,
+                               int no_threads) {
+  size_t *b = (size_t *)malloc(sizeof(size_t) * (no_threads + 1));
+  int t;
+
+  if (b == NULL)
+    return NULL;
+  for (t = 0; t < no_threads; ++t)
+    b[t] = (units != NULL ? units[bounds[t]] : bounds[t]) * unit_size;
+  b[no_threads] = size;
+  return b;
+}
+
+void *mem_place_array(Team *team, void *data, size_t size, const int *bounds,
+                      const long *units, size_t unit_size, int place,
+                      int pages) {
+  size_t *b;
+  void *placed;
+
+  if ((b = mem_unit_bounds(bounds, units, unit_size, size,
+                           team_size(team))) == NULL)
+    return NULL;
+  placed = mem_place(team, data, size, b, place, pages);
+  free(b);
+  /* The pages of data are dropped, but the range stays mapped, so that
+   * later allocations cannot land inside it */
+  if (placed != NULL)
+    madvise(data, size, MADV_DONTNEED);
+  return placed;
+}
+
+void mem_print_placement(const char *name, const void *data,
+                         const int *bounds, const long *units,
+                         size_t unit_size, const int *nodes, int no_threads) {
+  size_t *b;
+  double ratio = -1.;
+
+  if ((b = mem_unit_bounds(bounds, units, unit_size,
+                           bounds[no_threads] * unit_size, no_threads)) !=
+      NULL) {
+    if (units != NULL)
+      b[no_threads] = units[bounds[no_threads]] * unit_size;
+    ratio = mem_remote_ratio(data, b, nodes, no_threads);
+    free(b);
+  }
+  if (ratio < 0.)
+    printf("Remote pages (%s): n/a\n", name);
+  else
+    printf("Remote pages (%s): %.2f%%\n", name, 100. * ratio);
+}
+
+int mem_arena_init(Mem_arena *a, size_t size) {
+  memset(a, 0, sizeof(Mem_arena));
+  if (size > 0 && (a->block = (char *)aligned_alloc(
+                       MEM_ARENA_ALIGN, (size + MEM_ARENA_ALIGN - 1) /
+                                            MEM_ARENA_ALIGN *
+                                            MEM_ARENA_ALIGN)) == NULL)
+    return EXIT_FAILURE;
+  a->size = a->block != NULL ? size : 0;
+  return EXIT_SUCCESS;
+}
+
+void *mem_arena_alloc(Mem_arena *a, size_t size) {
+  char *p;
+
+  size = (size + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN;
+  a->batch += size;
+  if (a->used + size <= a->size) {
+    p = a->block + a->used;
+    a->used += size;
+    return p;
+  }
+
+  /* Apart, after a header holding the previous spilled allocation */
+  if ((p = (char *)aligned_alloc(MEM_ARENA_ALIGN, size + MEM_ARENA_ALIGN)) ==
+      NULL)
+    return NULL;
+  *(void **)p = a->spill;
+  a->spill = p;
+  return p + MEM_ARENA_ALIGN;
+}
+
+void mem_arena_reset(Mem_arena *a) {
+  void *next;
+
+  while (a->spill != NULL) {
+    next = *(void **)a->spill;
+    free(a->spill);
+    a->spill = next;
+  }
+  if (a->batch > a->size) {
+    free(a->block);
+    a->size = 0;
+    if ((a->block = (char *)aligned_alloc(MEM_ARENA_ALIGN, a->batch)) != NULL)
+      a->size = a->batch;
+  }
+  a->used = 0;
+  a->batch = 0;
+}
+
+void mem_arena_free(Mem_arena *a) {
+  a->batch = 0;
+  mem_arena_reset(a);
+  free(a->block);
+  memset(a, 0, sizeof(Mem_arena));
+}
+
+long mem_peak_rss(void) {
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return usage.ru_maxrss * 1024L;
+}
+
+int mem_parse_pages(const char *s) {
+  if (strcmp(s, "none") == 0)
+    return MEM_PAGES_DEFAULT;
+  if (strcmp(s, "thp") == 0)
+    return MEM_PAGES_THP;
+  if (strcmp(s, "hugetlb") == 0)
+    return MEM_PAGES_HUGETLB;
+  return -1;
+}
+
+int mem_parse_place(const char *s) {
+  if (strcmp(s, "none") == 0)
+    return MEM_PLACE_NONE;
+  if (strcmp(s, "interleave") == 0)
+    return MEM_PLACE_INTERLEAVE;
+  if (strcmp(s, "partition") == 0)
+    return MEM_PLACE_PARTITION;
+  return -1;
+}
+
+const char *mem_pages_name(int pages) {
+  static const char *names[] = {"none", "thp", "hugetlb"};
+  return names[pages];
+}
+
+const char *mem_place_name(int place) {
+  static const char *names[] = {"none", "interleave", "partition"};
+  return names[place];
+}
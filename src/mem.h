@@ -0,0 +1,86 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+
+#include "team.h"
+
+/* Page backing of anonymous allocations */
+#define MEM_PAGES_DEFAULT 0
+#define MEM_PAGES_THP 1     /* transparent huge pages (madvise) */
+#define MEM_PAGES_HUGETLB 2 /* explicit huge pages, THP if none reserved */
+
+/* Placement of the cached matrix */
+#define MEM_PLACE_NONE 0       /* use the mmapped cache files directly */
+#define MEM_PLACE_INTERLEAVE 1 /* copy, pages interleaved on all nodes */
+#define MEM_PLACE_PARTITION 2  /* copy, each thread's rows on its own node */
+
+/* Anonymous allocation backed by the requested kind of pages */
+void *mem_alloc(size_t size, int pages);
+void mem_free(void *ptr, size_t size);
+
+/* NUMA topology and memory policies (no-ops on single node hosts) */
+int mem_no_nodes(void);
+int mem_cpu_node(int cpu);
+int mem_interleave(void *ptr, size_t size);
+int mem_bind(void *ptr, size_t size, int node);
+
+/* Fraction of the pages of [ptr + bounds[t], ptr + bounds[t + 1]) that are
+ * not on nodes[t], sampled; negative if page locations cannot be queried */
+double mem_remote_ratio(const void *ptr, const size_t *bounds,
+                        const int *nodes, int no_parts);
+
+/* Parallel copy: thread t copies bytes [bounds[t], bounds[t + 1]) */
+typedef struct {
+  const void *src;
+  void *dst;
+  const size_t *bounds;
+} Mem_copy;
+
+void mem_copy_task(int tid, void *arg);
+
+/* Copy of src laid out according to place: interleaved on all nodes, or with
+ * the bytes [bounds[t], bounds[t + 1]) on the node of thread t */
+void *mem_place(Team *team, const void *src, size_t size,
+                const size_t *bounds, int place, int pages);
+
+/* mem_place() of an array whose thread t owns the units (rows or edges)
+ * [units[bounds[t]], units[bounds[t + 1]]) of unit_size bytes, or
+ * [bounds[t], bounds[t + 1]) when units is NULL; the pages of data are
+ * dropped once copied */
+void *mem_place_array(Team *team, void *data, size_t size, const int *bounds,
+                      const long *units, size_t unit_size, int place,
+                      int pages);
+/* Prints the share of remote pages of such an array, or n/a */
+void mem_print_placement(const char *name, const void *data,
+                         const int *bounds, const long *units,
+                         size_t unit_size, const int *nodes, int no_threads);
+
+/* Bump allocator for batches of allocations released together: what does
+ * not fit in the block is allocated apart until mem_arena_reset(), which
+ * grows the block to the size of the whole batch, so repeated batches of
+ * similar sizes allocate nothing. Allocations are aligned to MEM_ARENA_ALIGN
+ * bytes. */
+#define MEM_ARENA_ALIGN 64
+
+typedef struct {
+  char *block;
+  size_t size, used;
+  size_t batch; /* bytes asked for since the last reset */
+  void *spill;  /* allocations outside the block, linked by their header */
+} Mem_arena;
+
+int mem_arena_init(Mem_arena *a, size_t size);
+void *mem_arena_alloc(Mem_arena *a, size_t size);
+void mem_arena_reset(Mem_arena *a);
+void mem_arena_free(Mem_arena *a);
+
+/* Peak resident set size of the process so far, in bytes */
+long mem_peak_rss(void);
+
+int mem_parse_pages(const char *s);
+int mem_parse_place(const char *s);
+const char *mem_pages_name(int pages);
+const char *mem_place_name(int place);
+
+#endif
@@ -1,4 +1,3 @@
-#include <dirent.h>
 #include <fcntl.h>
 #include <float.h>
 #include <math.h>
@@ -11,334 +10,476 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "dist.h"
+#include "graph.h"
+#include "mem.h"
+#include "part.h"
+#include "perf.h"
+#include "scc.h"
+#include "spmv.h"
+#include "stream.h"
+#include "team.h"
+#include "timer.h"
+#include "topk.h"
+
 #define TOL 1.e-10
 #define MAX_ITER 200
 #define MOD_ITER 10
+#define MAX_PRINT 32
+#define SCC_TEAM_NODES 4096 /* components solved by all the threads */
+#define MAX_FACTORS 16       /* damping factors of a single run */
+#define PULL_RATIO 20 /* residuals pulled once the frontier has 1 / 20 of
+                         the edges */
 #define FNAME 256
-#define DNAME 1024
 #define PATH 1024
-#define MMAP 2048
 /*#define DEBUG*/
 
-/* Data for compression */
+/* Per-thread reductions, one cache line each */
 typedef struct {
+  double dist;
+  double danglings_sum;
+  char pad[48];
+} PR_partial;
+
+/* Shared state of the PageRank iteration */
+typedef struct {
+  const SpMV_kernel *kernel;
+  const long *row_ptr;
+  const void *col_ind;
+  const SELL_matrix *sell;
+  const Stream_graph *stream;
+  double *updates;     /* values of the updates of the edge stream */
+  long *stream_start;  /* update offsets of thread t, no_parts each */
+  long *stream_pos;
+  int *scatter_bounds; /* source partitions of thread t */
+  const int *out_deg;
+  const int *danglings;
+  const int *dangling_edges; /* lumped: edges of each node to danglings */
   int no_nodes;
-  int no_edges;
-  int no_danglings;
-} CSR_data;
+  int no_rows; /* iterated: the non-dangling nodes when lumped */
+  double d;
+  double *p, *p_new;
+  double *x; /* p scaled by the out-degrees, the input of the SpMV */
+  double danglings_dot_product;
+  double danglings_mass; /* lumped: rank of all the danglings */
+  int *bounds;          /* rows of thread t: [bounds[t], bounds[t + 1]) */
+  int *chunk_bounds;    /* SELL chunks, or target partitions, of thread t */
+  int *dangling_bounds; /* danglings[] entries inside the rows of thread t */
+  PR_partial *partial;
+  Topk *topk; /* top-K of p_new, tracked by each update */
+  int no_factors;
+  double *series; /* several factors: no_nodes * no_factors partial sums */
+  double coeff[MAX_FACTORS]; /* of p in the series of every factor */
+} PR_iteration;
+
+/* Per-thread results of the solver by components, one cache line each */
+typedef struct {
+  double dist;
+  double dot;   /* of the last two steps */
+  long updates; /* rows computed */
+  int max_iter;
+  char pad[36];
+} PR_block_partial;
+
+/* Convergence of a component: last distance and ratio of distances, and
+ * iterations since the last extrapolation */
+typedef struct {
+  double dist;
+  double ratio;
+  int since;
+} PR_block_conv;
+
+/* Shared state of the solver by components: (I - d A) y = e / n, the teleport
+ * term of every row being 1 / n, where A = L^T D^-1 without the danglings,
+ * block by block in topological order, the components of a level at once */
+typedef struct {
+  const Scc *scc;
+  const long *row_ptr;
+  const void *col_ind;
+  int index_width;
+  const int *out_deg;
+  double d, teleport;
+  double *y, *y_new, *x;
+  double *step; /* last change of every y */
+  int first, last;   /* components of the level */
+  volatile int next; /* next component of the level to claim */
+  int comp;          /* large component solved by all the threads */
+  double f;          /* its extrapolation factor */
+  int no_threads;
+  PR_block_partial *partial;
+} PR_blocks;
+
+/* Work of the residual solver, by direction, and the frontier and norm of
+ * the residuals it stopped with */
+typedef struct {
+  int no_pull, no_push;
+  long pull_edges, push_edges;
+  int no_front;
+  double dist;
+} PR_residual;
 
 /* Helper functions */
 int write_data(char path[], void *data, size_t nmemb, size_t size);
-void delete_folder(char dir[]);
-void *mmap_data(char path[], size_t nmemb, size_t size);
 void print_vec_f(double *v, int n);
 void print_vec_d(int *v, int n);
-void double_merge(int *from, int *to, int lo, int mid, int hi);
-void double_merge_sort(int *from, int *to, int lo, int hi);
-void sort_input_data(int *from, int *to, int n);
+void pr_init_task(int tid, void *arg);
+void pr_spmv_task(int tid, void *arg);
+void pr_scatter_task(int tid, void *arg);
+int pr_blocks(Team *team, const Scc *scc, const long *row_ptr,
+              const void *col_ind, int index_width, const int *out_deg,
+              double d, double *y, double *y_new, double *x, long *updates);
+int pr_residual(Team *team, PR_iteration *it, const long *row_ptr,
+                const void *col_ind, int index_width, PR_residual *res);
+void pr_update_task(int tid, void *arg);
+void pr_series_task(int tid, void *arg);
+int parse_damping(const char *list, double *d);
+int write_series(const char fname[], const Graph *graph, const double *series,
+                 const double *d, int m, double *x);
+int *lump_edges(const long *row_ptr, const void *col_ind, int index_width,
+                int no_rows, int no_nodes);
+int cmp_int(const void *a, const void *b);
+int pr_plan(const Graph *g, const Partition *part, Dist *dist, long **row_ptr,
+            int **col_ind);
+int pr_procs(Graph *g, const char input[], const char fname[],
+             const char *kernel_name, double d, int no_procs, int transport,
+             Phase_timer *timer);
 
 int main(int argc, char *argv[]) {
-  /* Data to save/load CSR matrix */
-  FILE *pdata;
+  /* Graph cache */
   char fname[FNAME];
-  char dir[DNAME];
-  char row_ptr_p[PATH];
-  char col_ind_p[PATH];
-  char val_p[PATH];
-  char danglings_p[PATH];
-  char csr_data_p[PATH];
-  CSR_data csr_data;
-  struct stat st = {0};
-
-  /* Reading data from input file */
-  FILE *pf;
-  int no_nodes, no_edges;
-  char *s = NULL;
-  size_t slen = 0;
-  ssize_t bytes;
-  int ri, ci;
-  int *from, *to;
-  int f, t;
+  char cache_p[PATH];
+  char sell_p[PATH];
+  char stream_p[PATH];
+  Graph graph;
+  int no_nodes;
+  long no_edges;
+  int t;
   int i, j;
 
-  /* CSR matrix representation */
-  double *val;
-  int *col_ind;
-  int *row_ptr;
+  /* Transposed CSR matrix representation */
+  void *col_ind;
+  long *row_ptr;
+  int *out_deg;
 
   /* Pagerank computation data */
   int *danglings;
   int no_danglings;
-  double danglings_dot_product;
+  int lumped = 1;
+  Scc scc;
+  int use_scc = 0;
+  PR_residual resid;
+  int residual = 0;
+  Topk topk;
+  int top_k = 0, rounds = TOPK_ROUNDS;
+  int *early_top = NULL;
+  int audit = 0, stop_iter = 0;
+  long updates;
+  double lump_sum, mass;
   double *p, *p_new;
   double d;
+  double damping[MAX_FACTORS] = {0.85};
+  int no_factors = 1;
+  int conv_iter[MAX_FACTORS];
+  int no_procs = 1;
+  int transport = DIST_SHM;
+  double chain_dist;
   double dist;
   int iter;
   char fres[PATH];
+  char fids[PATH];
+  PR_iteration it;
+
+  /* Threads and memory placement */
+  Team *team;
+  int no_threads = 1;
+  int place = MEM_PLACE_NONE;
+  int pages = MEM_PAGES_THP;
+  int *nodes;
+  Perf_counters counters;
+  double counts[PERF_EVENTS], iter_counts[PERF_EVENTS];
+  Perf_profile prof;
+  char *prof_p = NULL;
+  char prof_label[PERF_LABEL];
+  double peak_bw = 0.;
+  int profile = 0;
 
   /* Time elapsed data */
-  clock_t begin, end;
+  Phase_timer timer;
   double elapsed_time;
+  double spmv_begin, spmv_time;
+  char *json_p = NULL;
+  FILE *pjson;
+
+  /* SpMV kernel and matrix layout */
+  const SpMV_kernel *kernel;
+  char *kernel_name = NULL;
+  SELL_matrix sell;
+  int use_sell = 0;
+  Stream_graph stream;
+  int use_stream = 0;
+  const char *layout = "csr";
+  int sigma = SELL_SIGMA;
+  double bytes_per_iter;
+  char *input;
+  int opt;
 
   /* Extra data */
-  int *out_links;
+  double *x;
   double sum;
   int err;
 
-  if (argc != 2) {
+  timer_init(&timer);
+  while ((opt = getopt(argc, argv, "k:l:s:t:m:H:T:pP:FCDK:R:Ad:N:X:")) != -1) {
+    switch (opt) {
+    case 'k':
+      kernel_name = optarg;
+      break;
+    case 'l':
+      if (strcmp(optarg, "sell") == 0)
+        use_sell = 1;
+      else if (strcmp(optarg, "stream") == 0)
+        use_stream = 1;
+      else if (strcmp(optarg, "csr") != 0) {
+        fprintf(stderr,
+                " [ERROR] unknown layout \"%s\" (csr, sell, stream)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      layout = optarg;
+      break;
+    case 's':
+      sigma = atoi(optarg);
+      break;
+    case 't':
+      no_threads = atoi(optarg);
+      break;
+    case 'T':
+      json_p = optarg;
+      break;
+    case 'p':
+      profile = 1;
+      break;
+    case 'F':
+      lumped = 0;
+      break;
+    case 'C':
+      use_scc = 1;
+      break;
+    case 'D':
+      residual = 1;
+      break;
+    case 'K':
+      top_k = atoi(optarg);
+      break;
+    case 'R':
+      rounds = atoi(optarg);
+      break;
+    case 'A':
+      audit = 1;
+      break;
+    case 'd':
+      if ((no_factors = parse_damping(optarg, damping)) < 1) {
+        fprintf(stderr, " [ERROR] -d takes 1 to %d damping factors in (0, 1), "
+                        "separated by commas\n",
+                MAX_FACTORS);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'P':
+      profile = 1;
+      prof_p = optarg;
+      break;
+    case 'N':
+      no_procs = atoi(optarg);
+      break;
+    case 'X':
+      if ((transport = dist_parse_transport(optarg)) == -1) {
+        fprintf(stderr, " [ERROR] unknown transport \"%s\" (shm, socket)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'm':
+      if ((place = mem_parse_place(optarg)) == -1) {
+        fprintf(stderr, " [ERROR] unknown placement \"%s\" "
+                        "(none, interleave, partition)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'H':
+      if ((pages = mem_parse_pages(optarg)) == -1) {
+        fprintf(stderr, " [ERROR] unknown pages \"%s\" (none, thp, hugetlb)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./pagerank [-k <kernel>] "
+                      "[-l csr|sell|stream] [-F] [-C] [-D] [-d <d1,d2,...>] "
+                      "[-s <sigma>] "
+                      "[-K <top-k> [-R <rounds>] [-A]] "
+                      "[-N <processes> [-X shm|socket]] [-t <threads>] "
+                      "[-m none|interleave|partition] "
+                      "[-H none|thp|hugetlb] [-T <timings.json>] "
+                      "[-p] [-P <profile.csv>] "
+                      "<arg_name>\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (argc - optind != 1) {
     fprintf(stderr, " [ERROR] *1* argument required: ./pagerank <arg_name>\n");
     exit(EXIT_FAILURE);
   }
+  input = argv[optind];
 
-  /* Init data folder name */
-  strncpy(fname, argv[1] + 5, strlen(argv[1]) - 9);
-  fname[strlen(argv[1]) - 8] = '\0';
-  strcpy(dir, "PR_");
-  dir[3] = '\0';
-  strcat(dir, fname);
-  dir[3 + strlen(fname)] = '/';
-  dir[3 + strlen(fname) + 1] = '\0';
-
-  /* Create CSR file names */
-  strcpy(row_ptr_p, dir);
-  strcat(row_ptr_p, "row_ptr.bin");
-  strcpy(col_ind_p, dir);
-  strcat(col_ind_p, "col_ind.bin");
-  strcpy(val_p, dir);
-  strcat(val_p, "val.bin");
-  strcpy(danglings_p, dir);
-  strcat(danglings_p, "danglings.bin");
-
-  /* Create CSR metadata file */
-  strcpy(csr_data_p, dir);
-  strcat(csr_data_p, "csr_data.bin");
-
-  /* Create file to save PageRank result */
-  strcpy(fres, fname);
-  strcat(fres, ".pr");
-
-  /* Check if input data has already been compressed.
-   * If data has NOT yet been compressed, then perform compression */
-  if (stat(dir, &st) == -1) {
-    printf("Input file data \"%s\" is not compressed, ready to perform "
-           "compression...\n\n",
-           argv[1]);
-    begin = clock();
-    mkdir(dir, 0700);
-
-    if ((pf = fopen(argv[1], "r")) == NULL) {
-      fprintf(stderr, " [ERROR] Cannot open input file \"%s\"\n", argv[1]);
-      exit(EXIT_FAILURE);
-    }
+  /* The SELL and stream layouts iterate all the rows, the components are
+   * solved on CSR rows */
+  if (use_scc && (use_sell || use_stream)) {
+    fprintf(stderr, " [ERROR] -C needs the csr layout\n");
+    exit(EXIT_FAILURE);
+  }
+  /* The top-K is tracked on the iterated ranks, so the danglings are kept in
+   * the iterations */
+  if (top_k < 0 || rounds < 1) {
+    fprintf(stderr, " [ERROR] -K needs k >= 0 and -R rounds >= 1\n");
+    exit(EXIT_FAILURE);
+  }
+  if (use_scc && top_k > 0) {
+    fprintf(stderr, " [ERROR] -K needs the power iteration, not -C\n");
+    exit(EXIT_FAILURE);
+  }
+  /* Several damping factors share the iterates of every node */
+  if (no_factors > 1 && (use_scc || top_k > 0)) {
+    fprintf(stderr, " [ERROR] Several damping factors need the power "
+                    "iteration, without -C or -K\n");
+    exit(EXIT_FAILURE);
+  }
+  /* The processes iterate their CSR rows, one thread each */
+  if (no_procs < 1 || no_procs > DIST_MAX) {
+    fprintf(stderr, " [ERROR] -N takes 1 to %d processes\n", DIST_MAX);
+    exit(EXIT_FAILURE);
+  }
+  if (no_procs > 1 && (use_sell || use_stream || use_scc || top_k > 0 ||
+                       no_factors > 1 || place != MEM_PLACE_NONE ||
+                       profile || json_p != NULL)) {
+    fprintf(stderr, " [ERROR] -N needs the csr layout and the power "
+                    "iteration, without -C, -K, -d lists, -m, -p, -P or "
+                    "-T\n");
+    exit(EXIT_FAILURE);
+  }
+  /* Residuals are pushed along L or pulled along L^T, from CSR rows */
+  if (residual && (use_sell || use_stream || use_scc || top_k > 0 ||
+                   no_factors > 1 || no_procs > 1)) {
+    fprintf(stderr, " [ERROR] -D needs the csr layout and one damping "
+                    "factor, without -C, -K or -N\n");
+    exit(EXIT_FAILURE);
+  }
+  if (use_sell || use_stream || use_scc || top_k > 0 || no_factors > 1 ||
+      residual)
+    lumped = 0;
+
+  /* Select the SpMV kernel supported by the CPU */
+  if ((kernel = spmv_select(kernel_name, GRAPH_INDEX_WIDTH)) == NULL) {
+    fprintf(stderr, " [ERROR] SpMV kernel \"%s\" is not available (",
+            kernel_name);
+    spmv_list(stderr);
+    fprintf(stderr, ")\n");
+    exit(EXIT_FAILURE);
+  }
 
-    /* Parsing input file header */
-    printf("Parsing input data...\n");
-    bytes = getline(&s, &slen, pf);
-    bytes = getline(&s, &slen, pf);
-    bytes = getline(&s, &slen, pf);
-    sscanf(s, "# Nodes: %d Edges: %d", &no_nodes, &no_edges);
-    printf("This graph has %d nodes and %d edges\n", no_nodes, no_edges);
-    bytes = getline(&s, &slen, pf);
-
-    csr_data.no_nodes = no_nodes;
-    csr_data.no_edges = no_edges;
-
-    /* Reading data from input file */
-    i = 0;
-    from = (int *)malloc(sizeof(int) * no_edges);
-    to = (int *)malloc(sizeof(int) * no_edges);
-    out_links = (int *)calloc(no_nodes, sizeof(int));
-    while ((bytes = getline(&s, &slen, pf)) != -1) {
-      sscanf(s, "%d %d", from + i, to + i);
-      out_links[from[i]] += 1;
-      if (i % 10 == 0)
-        printf("\rEdge %d/%d", i, no_edges);
-      ++i;
-    }
-    printf("\rEdge %d/%d\n", i, no_edges);
-    printf("Done\n\n");
-    fclose(pf);
-    free(s);
+  /* Counting from here, so that the threads created later are counted too */
+  perf_open(&counters);
+  perf_profile_init(&prof, &counters, profile);
 
-    /* Keeping track of danglings data */
-    no_danglings = 0;
-    for (i = 0; i < no_nodes; ++i)
-      if (out_links[i] == 0)
-        ++no_danglings;
-    danglings = (int *)malloc(sizeof(int) * no_danglings);
-    j = 0;
-    for (i = 0; i < no_nodes; ++i)
-      if (out_links[i] == 0)
-        danglings[j++] = i;
+  /* Init cache file names */
+  graph_name(input, fname);
+  graph_path(fname, ".graph", cache_p);
+  graph_path(fname, ".sell_t", sell_p);
+  graph_path(fname, ".stream", stream_p);
 
-    csr_data.no_danglings = no_danglings;
+  /* Create file to save PageRank result, and the input ids if sparse */
+  strcpy(fres, fname);
+  strcat(fres, ".pr");
+  graph_path(fname, ".ids", fids);
 
-    printf("Sorting edges...\n");
-    sort_input_data(from, to, no_edges);
+  /* Mapping the graph cache, built from the input data the first time */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  if (graph_open(&graph, input, cache_p, no_threads, &timer, &prof) ==
+      EXIT_FAILURE)
+    exit(EXIT_FAILURE);
+  printf("Reading csr matrix data...\n");
+  no_nodes = graph.data.no_nodes;
+  no_edges = graph.data.no_edges;
+  no_danglings = graph.data.no_danglings;
+  printf("no_nodes: %d\nno_edges: %ld\nno_danglings: %d\n", no_nodes,
+         no_edges, no_danglings);
+
+  /* PageRank iterates on L^T, the ranks scaled by the out-degrees */
+  row_ptr = graph.row_ptr_t;
+  col_ind = graph.col_ind_t;
+  out_deg = graph.out_deg;
+  danglings = graph.danglings;
+
+  /* Kernels specialized for the width of the node ids in the cache */
+  kernel = spmv_select(kernel_name, graph.index_width);
+  printf("Node ids: %d bits\n", 8 * graph.index_width);
+
+  /* Several processes, each one iterating the rows of its part */
+  if (no_procs > 1) {
     printf("Done.\n\n");
-
-    /* csr matrix initialization */
-    val = (double *)malloc(sizeof(double) * no_edges);
-    col_ind = (int *)malloc(sizeof(int) * no_edges);
-    row_ptr = (int *)malloc(sizeof(int) * (no_nodes + 1));
-    ri = 0;
-    row_ptr[ri] = 0;
-    ci = 0;
-
-    /* Writing data in CSR matrix */
-    for (ci = 0; ci < no_edges; ++ci) {
-      f = from[ci];
-      t = to[ci];
-      if (t > ri) {
-        for (i = ri + 1; i <= t; ++i)
-          row_ptr[i] = ci;
-        ri = t;
-      }
-      val[ci] = 1. / (double)out_links[f];
-      col_ind[ci] = f;
-    }
-    while (ri < no_nodes)
-      row_ptr[++ri] = ci;
-
-    printf("CSR matrix filled\n");
-
-#ifdef DEBUG
-    printf("CSR Transposed matrix\n");
-    printf("---------------------\n");
-    printf("val:     [ ");
-    for (i = 0; i < no_edges; ++i)
-      printf("%.3f ", val[i]);
-    printf("]\n");
-
-    printf("col_ind: [ ");
-    for (i = 0; i < no_edges; ++i)
-      printf("%d ", col_ind[i]);
-    printf("]\n");
-
-    printf("row_ptr: [ ");
-    for (i = 0; i < no_nodes + 1; ++i)
-      printf("%d ", row_ptr[i]);
-    printf("]\n\n");
-    printf("danglings: [ ");
-    for (j = 0; j < no_danglings; ++j) {
-      printf("%d", danglings[j]);
-      if (j < no_danglings - 1)
-        printf(", ");
-    }
-    printf(" ]\n");
-    printf("Number of danglings nodes: %d\n\n", no_danglings);
-#endif
-
-    /* Writing data back to memory */
-    err = (write_data(row_ptr_p, (void *)row_ptr, sizeof(int), no_nodes + 1) ==
-           EXIT_FAILURE) ||
-          (write_data(col_ind_p, (void *)col_ind, sizeof(int), no_edges) ==
-           EXIT_FAILURE) ||
-          (write_data(val_p, (void *)val, sizeof(double), no_edges) ==
-           EXIT_FAILURE) ||
-          (write_data(danglings_p, (void *)danglings, sizeof(int),
-                      no_danglings) == EXIT_FAILURE) ||
-          (write_data(csr_data_p, (void *)&csr_data, sizeof(CSR_data), 1) ==
-           EXIT_FAILURE);
-
-    /* Input data */
-    free(from);
-    free(to);
-    from = NULL;
-    to = NULL;
-    /* Danglings data */
-    free(out_links);
-    free(danglings);
-    out_links = NULL;
-    danglings = NULL;
-    /* CSR data structure */
-    free(val);
-    free(col_ind);
-    free(row_ptr);
-    val = NULL;
-    col_ind = NULL;
-    row_ptr = NULL;
-
-    /* Manage error from writing data to memory */
-    if (err) {
-      delete_folder(dir);
-      fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
-      exit(EXIT_FAILURE);
-    }
-    printf("Data written successfully!\n");
-
-    elapsed_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
-    printf("Elapsed time: %.3fs\n\n", elapsed_time);
+    timer_stop(&timer, "mmap");
+    err = pr_procs(&graph, input, fname, kernel_name, damping[0], no_procs,
+                   transport, &timer) == EXIT_FAILURE;
+    if (!err && graph.data.sparse_ids)
+      err = graph_write_ids(&graph, fids) == EXIT_FAILURE;
+    graph_close(&graph);
+    perf_close(&counters);
+    perf_profile_free(&prof);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
-  /* Reading CSR matrix metadata info from file */
-  printf("Reading csr matrix data...\n");
-  pdata = fopen(csr_data_p, "rb");
-  bytes = fread(&no_nodes, sizeof(csr_data.no_nodes), 1, pdata);
-  bytes = fread(&no_edges, sizeof(csr_data.no_edges), 1, pdata);
-  bytes = fread(&no_danglings, sizeof(csr_data.no_danglings), 1, pdata);
-  fclose(pdata);
-  printf("no_nodes: %d\nno_edges: %d\nno_danglings: %d\n", no_nodes, no_edges,
-         no_danglings);
-
-  /* mmapping the CSR matrix data from files */
-  i = 0;
-  err =
-      (((row_ptr = (int *)mmap_data(row_ptr_p, sizeof(int), no_nodes + 1)) !=
-        NULL) &&
-       ++i) &&
-      (((col_ind = (int *)mmap_data(col_ind_p, sizeof(int), no_edges)) !=
-        NULL) &&
-       ++i) &&
-      (((val = (double *)mmap_data(val_p, sizeof(double), no_edges)) != NULL) &&
-       ++i) &&
-      (((danglings = (int *)mmap_data(danglings_p, sizeof(int),
-                                      no_danglings)) != NULL) &&
-       ++i);
-
-  if (err == 0) {
-    fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
-    fprintf(stderr,
-            "         Data is corrupted, the folder will be destroyed.\n");
-    delete_folder(dir);
-    /* Un-mmapping mmapped files */
-    do {
-      switch (i) {
-      case 1:
-        munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-        break;
-      case 2:
-        munmap(col_ind, no_edges * sizeof(int));
-        break;
-      case 3:
-        munmap(val, no_edges * sizeof(double));
-        break;
-      case 4:
-        munmap(col_ind, no_nodes * sizeof(int));
-        break;
-      }
-    } while (--i > 0);
+  /* Loading the SELL-C-sigma layout, building it from the CSR matrix the
+   * first time it is requested for this input */
+  if (use_sell && sell_open(&sell, sell_p, input, row_ptr, col_ind,
+                            graph.index_width, NULL, no_nodes,
+                            sigma) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] SELL layout could not be built.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (use_sell)
+    printf("SELL-%d-%d: %d chunks, fill ratio %.3f\n", SELL_C,
+           sell.data.sigma, sell.data.no_chunks, sell_fill(&sell, no_edges));
+
+  /* Or the edges streamed by source partition, taken from L */
+  if (use_stream &&
+      stream_open(&stream, stream_p, input, graph.row_ptr, graph.col_ind,
+                  graph.index_width, no_nodes,
+                  STREAM_PART_BITS) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Edge stream layout could not be built.\n");
     exit(EXIT_FAILURE);
   }
+  if (use_stream)
+    printf("Edge stream: %d partitions of %d nodes\n", stream.data.no_parts,
+           1 << stream.data.part_bits);
 
   printf("Done.\n\n");
+  timer_stop(&timer, "mmap");
+  perf_profile_stop(&prof, "mmap", 0.);
 
 #ifdef DEBUG
   printf("CSR Transposed matrix\n");
   printf("---------------------\n");
-  printf("val:     [ ");
-  for (i = 0; i < no_edges; ++i)
-    printf("%.3f ", val[i]);
-  printf("]\n");
-
   printf("col_ind: [ ");
   for (i = 0; i < no_edges; ++i)
-    printf("%d ", col_ind[i]);
+    printf("%d ", GRAPH_ID(col_ind, graph.index_width, i));
   printf("]\n");
 
   printf("row_ptr: [ ");
   for (i = 0; i < no_nodes + 1; ++i)
-    printf("%d ", row_ptr[i]);
+    printf("%ld ", row_ptr[i]);
   printf("]\n\n");
   printf("danglings: [ ");
   for (j = 0; j < no_danglings; ++j) {
@@ -350,18 +491,244 @@ int main(int argc, char *argv[]) {
   printf("Number of danglings nodes: %d\n\n", no_danglings);
 #endif
 
-  /* Setting data up for PageRank computation */
-  d = 0.85;
-  p = (double *)malloc(sizeof(double) * no_nodes);
-  for (i = 0; i < no_nodes; ++i)
-    p[i] = 1. / (double)no_nodes;
-  p_new = (double *)malloc(sizeof(double) * no_nodes);
+  /* Setting up the threads and the rows each of them owns */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  if (no_threads < 1)
+    no_threads = 1;
+  if ((team = team_create(no_threads, 1)) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot start %d threads\n", no_threads);
+    exit(EXIT_FAILURE);
+  }
+  nodes = (int *)malloc(sizeof(int) * no_threads);
+  for (t = 0; t < no_threads; ++t)
+    nodes[t] = mem_cpu_node(team_cpu(team, t));
+  it.bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.chunk_bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.dangling_bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  it.scatter_bounds = NULL;
+  if (use_stream) {
+    /* Scatter by source partitions balanced by edges, gather and update by
+     * target partitions balanced by updates */
+    it.scatter_bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+    team_partition(stream.edge_ptr, stream.data.no_parts, no_threads, 1,
+                   it.scatter_bounds);
+    team_partition(stream.update_ptr, stream.data.no_parts, no_threads, 1,
+                   it.chunk_bounds);
+    for (t = 0; t <= no_threads; ++t)
+      it.bounds[t] =
+          ((long)it.chunk_bounds[t] << stream.data.part_bits) < no_nodes
+              ? it.chunk_bounds[t] << stream.data.part_bits
+              : no_nodes;
+  } else if (use_sell) {
+    /* Chunk ranges cover whole sigma windows, so rows are not shared */
+    team_partition(sell.chunk_ptr, sell.data.no_chunks, no_threads,
+                   sell.data.sigma / SELL_C, it.chunk_bounds);
+    for (t = 0; t <= no_threads; ++t)
+      it.bounds[t] = (it.chunk_bounds[t] * SELL_C < no_nodes)
+                         ? it.chunk_bounds[t] * SELL_C
+                         : no_nodes;
+  } else
+    team_partition(row_ptr, lumped ? no_nodes - no_danglings : no_nodes,
+                   no_threads, 1, it.bounds);
+  for (t = 0, j = 0; t <= no_threads; ++t) {
+    while (j < no_danglings && danglings[j] < it.bounds[t])
+      ++j;
+    it.dangling_bounds[t] = j;
+  }
+
+  /* Strongly connected components of L, in topological order */
+  if (use_scc) {
+    if (scc_compute(&scc, graph.row_ptr, graph.col_ind, graph.index_width,
+                    no_nodes) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Not enough memory for the components\n");
+      exit(EXIT_FAILURE);
+    }
+    cache_release(&graph.cache, "col_ind");
+    cache_release(&graph.cache, "row_ptr");
+    printf("Components: %d (%d single nodes, largest of %d nodes), %d "
+           "levels\n",
+           scc.no_comps, scc.no_singletons, scc.max_size, scc.no_levels);
+  }
+
+  /* Copying the matrix where its rows are used */
+  if (place != MEM_PLACE_NONE) {
+    printf("Placing matrix data (%s)...\n", mem_place_name(place));
+    err = 0;
+    if (use_sell)
+      err = sell_place(&sell, team, it.chunk_bounds, place, pages) ==
+            EXIT_FAILURE;
+    else if (!use_stream)
+      err = (row_ptr = (long *)mem_place_array(
+                 team, row_ptr, (no_nodes + 1) * sizeof(long), it.bounds,
+                 NULL, sizeof(long), place, pages)) == NULL ||
+            (col_ind = mem_place_array(team, col_ind,
+                                       no_edges * graph.index_width,
+                                       it.bounds, row_ptr, graph.index_width,
+                                       place, pages)) == NULL;
+    err = err || (out_deg = (int *)mem_place_array(
+                      team, out_deg, no_nodes * sizeof(int), it.bounds, NULL,
+                      sizeof(int), place, pages)) == NULL;
+    if (err) {
+      fprintf(stderr, " [ERROR] Matrix data could not be placed.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* The mapped L^T is not iterated either once copied or sliced, and the
+   * edge stream needs neither matrix */
+  if (use_sell || use_stream || place != MEM_PLACE_NONE)
+    cache_release(&graph.cache, "col_ind_t");
+  if (use_stream) {
+    cache_release(&graph.cache, "row_ptr_t");
+    cache_release(&graph.cache, "col_ind");
+    cache_release(&graph.cache, "row_ptr");
+  }
+
+  /* Setting data up for PageRank computation; several factors iterate the
+   * chain without teleportation, d = 1 */
+  d = no_factors > 1 ? 1. : damping[0];
+  p = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  p_new = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  x = (double *)mem_alloc(sizeof(double) * no_nodes, pages);
+  if (place == MEM_PLACE_INTERLEAVE) {
+    mem_interleave(p, sizeof(double) * no_nodes);
+    mem_interleave(p_new, sizeof(double) * no_nodes);
+    mem_interleave(x, sizeof(double) * no_nodes);
+  }
+  it.kernel = kernel;
+  it.row_ptr = row_ptr;
+  it.col_ind = col_ind;
+  it.sell = use_sell ? &sell : NULL;
+  it.stream = use_stream ? &stream : NULL;
+  it.updates = NULL;
+  it.stream_start = it.stream_pos = NULL;
+  if (use_stream) {
+    it.updates = (double *)mem_alloc(sizeof(double) * (no_edges + 1), pages);
+    it.stream_start = stream_offsets(&stream, it.scatter_bounds, no_threads);
+    it.stream_pos = (long *)malloc(sizeof(long) * no_threads *
+                                   stream.data.no_parts);
+    if (it.updates == NULL || it.stream_start == NULL ||
+        it.stream_pos == NULL) {
+      fprintf(stderr, " [ERROR] Not enough memory for the edge stream\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  it.out_deg = out_deg;
+  it.danglings = danglings;
+  it.no_nodes = no_nodes;
+  it.no_rows = lumped ? no_nodes - no_danglings : no_nodes;
+  it.dangling_edges = lumped ? lump_edges(row_ptr, col_ind,
+                                          graph.index_width, it.no_rows,
+                                          no_nodes)
+                             : NULL;
+  it.d = d;
+  it.p = p;
+  it.p_new = p_new;
+  it.x = x;
+  it.partial = (PR_partial *)malloc(sizeof(PR_partial) * no_threads);
+  it.no_factors = no_factors;
+  it.series = NULL;
+  if (no_factors > 1) {
+    if ((it.series = (double *)mem_alloc(sizeof(double) * no_nodes *
+                                         no_factors, pages)) == NULL) {
+      fprintf(stderr, " [ERROR] Not enough memory for %d rank vectors\n",
+              no_factors);
+      exit(EXIT_FAILURE);
+    }
+    for (t = 0; t < no_factors; ++t) {
+      it.coeff[t] = 1. - damping[t];
+      conv_iter[t] = 0;
+    }
+  }
+  it.topk = NULL;
+  if (top_k > 0) {
+    if (topk_create(&topk, top_k < no_nodes ? top_k : no_nodes,
+                    no_threads) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Not enough memory for the top-K\n");
+      exit(EXIT_FAILURE);
+    }
+    it.topk = &topk;
+    early_top = (int *)malloc(sizeof(int) * topk.k);
+  }
+  team_run(team, pr_init_task, &it);
   dist = DBL_MAX;
   iter = 0;
-
-  /* Computing PageRank */
-  printf("Computing PageRank...\n");
-  begin = clock();
+  spmv_time = 0.;
+
+  /* DTp = DanglingsT @ p; lumped, the danglings are a single node, whose
+   * rank also needs the part of ATp going to them */
+  it.danglings_dot_product = 0.;
+  for (j = 0; j < no_danglings; ++j)
+    it.danglings_dot_product += p[danglings[j]];
+  it.danglings_mass = it.danglings_dot_product;
+  it.danglings_dot_product /= (double)no_nodes;
+  lump_sum = 0.;
+  if (lumped) {
+    it.danglings_mass = (double)no_danglings / (double)no_nodes;
+    it.danglings_dot_product = it.danglings_mass / (double)no_nodes;
+    for (i = 0; i < it.no_rows; ++i)
+      lump_sum += x[i] * it.dangling_edges[i];
+    printf("Lumped: %d dangling nodes out of the iterations\n",
+           no_danglings);
+  }
+  if (use_stream)
+    bytes_per_iter = stream_bytes(&stream);
+  else
+    bytes_per_iter =
+        use_sell ? sell_bytes(&sell, 0)
+                 : spmv_bytes(it.no_rows, row_ptr[it.no_rows] - row_ptr[0],
+                              graph.index_width, 0);
+  timer_stop(&timer, "setup");
+  perf_profile_stop(&prof, "setup", 0.);
+  perf_read(&counters, iter_counts);
+
+  /* Computing PageRank, by components instead of the power iteration */
+  if (use_scc) {
+    printf("Computing PageRank by components (%d thread%s)...\n",
+           no_threads, no_threads > 1 ? "s" : "");
+    spmv_begin = timer_now();
+    iter = pr_blocks(team, &scc, row_ptr, col_ind, graph.index_width,
+                     out_deg, d, p, p_new, x, &updates);
+    spmv_time = timer_now() - spmv_begin;
+    printf("Rows computed: %ld, %.2f per node\n", updates,
+           no_nodes > 0 ? (double)updates / no_nodes : 0.);
+    scc_free(&scc);
+    dist = 0.;
+  } else if (residual) {
+    /* Or by residuals, only those of the frontier propagated */
+    printf("Computing PageRank by residuals (%s kernel, %d thread%s)...\n",
+           kernel->name, no_threads, no_threads > 1 ? "s" : "");
+    spmv_begin = timer_now();
+    if ((iter = pr_residual(team, &it, graph.row_ptr, graph.col_ind,
+                            graph.index_width, &resid)) < 0) {
+      fprintf(stderr, " [ERROR] Not enough memory for the residuals\n");
+      exit(EXIT_FAILURE);
+    }
+    spmv_time = timer_now() - spmv_begin;
+    printf("\riter %d\nResidual iterations: %d pull, %d push\n", iter,
+           resid.no_pull, resid.no_push);
+    if (resid.no_front > 0)
+      fprintf(stderr, " [WARNING] No convergence in %d iterations: %d nodes "
+                      "left in the frontier, residual %.2e\n",
+              iter, resid.no_front, resid.dist);
+    printf("Edges visited: %.2f sweeps, %.2f in the push iterations (%.2f%% "
+           "of a sweep each)\n",
+           (double)(resid.pull_edges + resid.push_edges) /
+               (no_edges > 0 ? no_edges : 1),
+           (double)resid.push_edges / (no_edges > 0 ? no_edges : 1),
+           resid.no_push > 0 ? 100. * resid.push_edges / resid.no_push /
+                                   (no_edges > 0 ? no_edges : 1)
+                             : 0.);
+    dist = 0.;
+  } else if (no_factors > 1)
+    printf("Computing PageRank for %d damping factors (%s kernel, %s "
+           "layout, %d thread%s)...\n",
+           no_factors, kernel->name, layout, no_threads,
+           no_threads > 1 ? "s" : "");
+  else
+    printf("Computing PageRank (%s kernel, %s layout, %d thread%s)...\n",
+           kernel->name, layout, no_threads, no_threads > 1 ? "s" : "");
   while (dist > TOL && iter < MAX_ITER) {
 #ifdef DEBUG
     if (iter % MOD_ITER == 0) {
@@ -370,39 +737,138 @@ int main(int argc, char *argv[]) {
 #ifdef DEBUG
       printf("\n");
       printf("p: ");
-      print_vec_f(p, no_nodes);
+      print_vec_f(it.p, no_nodes);
     }
 #endif
 
-    /* DTp = DanglingsT @ p */
-    danglings_dot_product = 0.;
-    for (j = 0; j < no_danglings; ++j)
-      danglings_dot_product += p[danglings[j]];
-    danglings_dot_product /= (double)no_nodes;
-
-    /* ATp = AT @ p + DTp */
-    for (ri = 0; ri < no_nodes; ++ri) {
-      p_new[ri] = danglings_dot_product;
-      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
-        p_new[ri] += p[col_ind[ci]] * val[ci];
-    }
-
-    /* d*AT @ p + (1-d)eeT @ p */
-    for (i = 0; i < no_nodes; ++i)
-      p_new[i] = d * p_new[i] + (1. - d) / (double)no_nodes;
+    /* ATp = LT @ (p / out_deg), p scaled in the previous update; streamed,
+     * all the updates are scattered before any partition is gathered */
+    spmv_begin = timer_now();
+    if (use_stream)
+      team_run(team, pr_scatter_task, &it);
+    team_run(team, pr_spmv_task, &it);
+    spmv_time += timer_now() - spmv_begin;
 
+    /* d*(ATp + DTp) + (1-d)eeT @ p, distance, next DTp and scaled p */
+    team_run(team, pr_update_task, &it);
     dist = 0.;
-    for (i = 0; i < no_nodes; ++i)
-      dist += (p[i] - p_new[i]) * (p[i] - p_new[i]);
+    it.danglings_dot_product = 0.;
+    for (t = 0; t < no_threads; ++t) {
+      dist += it.partial[t].dist;
+      it.danglings_dot_product += it.partial[t].danglings_sum;
+    }
+    if (lumped) {
+      /* s' = d * (ATp of the danglings + no_danglings * s / n) +
+       * no_danglings * (1 - d) / n, from the p the SpMV used */
+      mass = d * lump_sum + no_danglings * (d * it.danglings_mass + 1. - d) /
+                                (double)no_nodes;
+      dist += (mass - it.danglings_mass) * (mass - it.danglings_mass);
+      it.danglings_mass = mass;
+      lump_sum = it.danglings_dot_product;
+      it.danglings_dot_product = mass;
+    }
     dist = sqrt(dist);
+    it.danglings_dot_product /= (double)no_nodes;
 
-    for (i = 0; i < no_nodes; ++i)
-      p[i] = p_new[i];
+    p = it.p_new;
+    it.p_new = it.p;
+    it.p = p;
 
     ++iter;
+
+    /* Several factors: with x_k = P^k e / n, the iterates of factor d are
+     * (1 - d) (x_0 + d x_1 + ... + d^(k-1) x_(k-1)) + d^k x_k, summed as the
+     * updates go, and two of them differ by d^k times the distance of x_k
+     * to x_(k-1). A converged factor adds its last term and drops out. */
+    if (no_factors > 1) {
+      chain_dist = dist;
+      dist = 0.;
+      for (t = 0; t < no_factors; ++t) {
+        if (conv_iter[t] > 0) {
+          it.coeff[t] = 0.;
+          continue;
+        }
+        it.coeff[t] = pow(damping[t], iter);
+        if (it.coeff[t] * chain_dist <= TOL)
+          conv_iter[t] = iter;
+        else {
+          if (it.coeff[t] * chain_dist > dist)
+            dist = it.coeff[t] * chain_dist;
+          it.coeff[t] *= 1. - damping[t];
+        }
+      }
+    }
+
+    /* Top-K workloads stop once the order of the top-K settles, usually well
+     * before the ranks themselves; audited, the iterations go on to the
+     * tolerance to measure what stopping saves */
+    if (it.topk != NULL && topk_merge(it.topk) >= rounds && stop_iter == 0 &&
+        dist > TOL) {
+      stop_iter = iter;
+      memcpy(early_top, it.topk->top, sizeof(int) * it.topk->k);
+      if (!audit)
+        break;
+    }
+
+    /* SpMV traffic plus reading p, p_new and out_deg and writing p_new and
+     * the scaled p */
+    if (profile) {
+      sprintf(prof_label, "iter %d", iter);
+      perf_profile_stop(&prof, prof_label,
+                        bytes_per_iter +
+                            (4. * sizeof(double) + sizeof(int)) *
+                                it.no_rows);
+    }
   }
-  end = clock();
+  elapsed_time = timer_stop(&timer, "iterate");
+  perf_read(&counters, counts);
+  for (t = 0; t < PERF_EVENTS; ++t)
+    counts[t] = counts[t] >= 0. ? counts[t] - iter_counts[t] : -1.;
+  p_new = it.p_new;
   printf("\riter %d\n", iter);
+  if (iter == MAX_ITER && dist > TOL)
+    fprintf(stderr, " [WARNING] No convergence in %d iterations: distance "
+                    "%.2e\n",
+            iter, dist);
+
+  /* The last terms of the factors converged at the last iteration, or cut
+   * at MAX_ITER; p becomes the ranks of the first factor */
+  if (no_factors > 1) {
+    for (t = 0; t < no_factors; ++t)
+      if (conv_iter[t] == 0 || conv_iter[t] == iter)
+        it.coeff[t] = pow(damping[t], iter);
+    team_run(team, pr_series_task, &it);
+    for (i = 0; i < no_nodes; ++i)
+      p[i] = it.series[(long)i * no_factors];
+  }
+
+  /* Where the top-K stopped, and audited what the tolerance changed in it */
+  if (it.topk != NULL) {
+    if (stop_iter == 0)
+      printf("Top-%d not stable before the tolerance\n", it.topk->k);
+    else if (!audit)
+      printf("Top-%d stable for %d iterations: stopped at iteration %d, "
+             "distance %.2e\n",
+             it.topk->k, rounds, stop_iter, dist);
+    else {
+      for (i = 0, j = 0; i < it.topk->k; ++i)
+        j += early_top[i] == it.topk->top[i];
+      printf("Top-%d stable for %d iterations at iteration %d, tolerance "
+             "at %d: %d iterations saved, %d of %d in the same place\n",
+             it.topk->k, rounds, stop_iter, iter, iter - stop_iter, j,
+             it.topk->k);
+    }
+    topk_free(it.topk);
+    free(early_top);
+  }
+
+  /* Lumped, the danglings get their ranks from a single SpMV of their rows */
+  if (lumped) {
+    kernel->pattern(row_ptr, col_ind, it.x, p, it.no_rows, no_nodes);
+    for (i = it.no_rows; i < no_nodes; ++i)
+      p[i] = d * (p[i] + it.danglings_mass / (double)no_nodes) +
+             (1. - d) / (double)no_nodes;
+  }
 #ifdef DEBUG
   printf("p: ");
   print_vec_f(p, no_nodes);
@@ -415,21 +881,129 @@ int main(int argc, char *argv[]) {
   printf("Proof of correctness:\n");
   printf("sum(p) = %f\n\n", sum);
 
-  elapsed_time = (double)(end - begin) / CLOCKS_PER_SEC;
+  /* Iterations of every factor, all of them sharing the same SpMVs */
+  if (no_factors > 1) {
+    for (t = 0, j = 0; t < no_factors; ++t) {
+      for (i = 0, sum = 0.; i < no_nodes; ++i)
+        sum += it.series[(long)i * no_factors + t];
+      printf("d = %.2f: %3d iterations, sum(p) = %f\n", damping[t],
+             conv_iter[t] > 0 ? conv_iter[t] : iter, sum);
+      j += conv_iter[t] > 0 ? conv_iter[t] : iter;
+    }
+    printf("SpMVs: %d, against %d for one run per factor\n\n", iter, j);
+  }
+
   printf("Elapsed time: %.3fs\n", elapsed_time);
+  if (use_scc)
+    printf("Components solved in %.3fs, at most %d iterations each\n",
+           spmv_time, iter);
+  printf("Peak memory: %.1f MB (%.1f bytes per edge)\n", mem_peak_rss() / 1e6,
+         no_edges > 0 ? (double)mem_peak_rss() / no_edges : 0.);
+  if (!use_scc && !residual && iter > 0 && spmv_time > 0.)
+    printf("SpMV (%s, %s): %.3fs, %.2f GB/s, %.2f GFLOP/s\n", kernel->name,
+           layout, spmv_time,
+           bytes_per_iter * iter / spmv_time / 1e9,
+           spmv_flops(no_edges, 0) * iter / spmv_time / 1e9);
+
+  /* Memory placement report */
+  printf("\nMemory: %d thread%s, %d NUMA node%s, placement %s, %s pages\n",
+         no_threads, no_threads > 1 ? "s" : "", mem_no_nodes(),
+         mem_no_nodes() > 1 ? "s" : "", mem_place_name(place),
+         mem_pages_name(pages));
+  if (counts[PERF_DTLB_MISSES] >= 0. && iter > 0)
+    printf("dTLB load misses: %.0f (%.3f per edge per iteration)\n",
+           counts[PERF_DTLB_MISSES],
+           counts[PERF_DTLB_MISSES] / iter / (no_edges > 0 ? no_edges : 1));
+  else
+    printf("dTLB load misses: n/a\n");
+  if (counts[PERF_NODE_LOADS] > 0. && counts[PERF_NODE_MISSES] >= 0.)
+    printf("Remote accesses: %.2f%% of node loads\n",
+           100. * counts[PERF_NODE_MISSES] / counts[PERF_NODE_LOADS]);
+  else
+    printf("Remote accesses: n/a\n");
+  mem_print_placement("rank vector", p, it.bounds, NULL, sizeof(double),
+                      nodes, no_threads);
+  if (!use_sell && !use_stream)
+    mem_print_placement("col_ind", col_ind, it.bounds, row_ptr,
+                        graph.index_width, nodes, no_threads);
+  if (profile)
+    peak_bw = perf_peak_bandwidth(team, pages);
+  team_destroy(team);
 
   /* un-mmapping data */
-  munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-  munmap(col_ind, no_edges * sizeof(int));
-  munmap(val, no_edges * sizeof(double));
-  munmap(col_ind, no_nodes * sizeof(int));
+  if (use_sell)
+    sell_free(&sell);
+  if (use_stream) {
+    stream_free(&stream);
+    mem_free(it.updates, sizeof(double) * (no_edges + 1));
+  }
+  if (place != MEM_PLACE_NONE && !use_sell && !use_stream) {
+    mem_free(row_ptr, (no_nodes + 1) * sizeof(long));
+    mem_free(col_ind, no_edges * graph.index_width);
+  }
+  if (place != MEM_PLACE_NONE)
+    mem_free(out_deg, no_nodes * sizeof(int));
+
+  /* Writing data back to memory, in increasing input id order */
+  timer_start(&timer);
+  perf_profile_start(&prof);
+  if (no_factors > 1) {
+    err = write_series(fname, &graph, it.series, damping, no_factors, x) ==
+          EXIT_FAILURE;
+    mem_free(it.series, sizeof(double) * no_nodes * no_factors);
+  } else {
+    graph_unpermute(&graph, p, x);
+    err = write_data(fres, (void *)x, sizeof(double), no_nodes) ==
+          EXIT_FAILURE;
+  }
+  if (graph.data.sparse_ids)
+    err = graph_write_ids(&graph, fids) == EXIT_FAILURE || err;
+  graph_close(&graph);
+  timer_stop(&timer, "output");
+  perf_profile_stop(&prof, "output", 0.);
+  perf_close(&counters);
+
+  /* Per phase and per iteration counters */
+  if (profile) {
+    printf("\nProfile:\n");
+    perf_profile_print(&prof, peak_bw, stdout);
+    if (prof_p != NULL)
+      err = err || perf_profile_csv(&prof, prof_p) == EXIT_FAILURE;
+  }
+  perf_profile_free(&prof);
 
-  /* Writing data back to memory */
-  err = (write_data(fres, (void *)p, sizeof(double), no_nodes) == EXIT_FAILURE);
+  /* Phase timings for the benchmarks */
+  if (json_p != NULL) {
+    if ((pjson = fopen(json_p, "w")) == NULL) {
+      fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", json_p);
+      err = 1;
+    } else {
+      fprintf(pjson,
+              "{\"tool\": \"pagerank\", \"input\": \"%s\", \"nodes\": %d, "
+              "\"edges\": %ld, \"kernel\": \"%s\", \"layout\": \"%s\", "
+              "\"threads\": %d, \"iterations\": %d, \"peak_rss\": %ld, "
+              "\"phases\": ",
+              input, no_nodes, no_edges, kernel->name,
+              layout, no_threads, iter, mem_peak_rss());
+      timer_json(&timer, pjson);
+      fprintf(pjson, "}\n");
+      fclose(pjson);
+    }
+  }
 
   /* Vectors of probability */
-  free(p);
-  free(p_new);
+  mem_free(p, sizeof(double) * no_nodes);
+  mem_free(p_new, sizeof(double) * no_nodes);
+  mem_free(x, sizeof(double) * no_nodes);
+  free(it.partial);
+  free(it.bounds);
+  free(it.chunk_bounds);
+  free(it.dangling_bounds);
+  free(it.scatter_bounds);
+  free((int *)it.dangling_edges);
+  free(it.stream_start);
+  free(it.stream_pos);
+  free(nodes);
 
   /* Manage error from writing data to memory */
   if (err) {
@@ -455,59 +1029,520 @@ int write_data(char path[], void *data, size_t nmemb, size_t size) {
   return EXIT_SUCCESS;
 }
 
-void delete_folder(char dir[]) {
-  DIR *pf = opendir(dir);
-  struct dirent *next_file;
-  char fpath[PATH];
+void pr_init_task(int tid, void *arg) {
+  PR_iteration *it = (PR_iteration *)arg;
+  int i;
 
-  while ((next_file = readdir(pf)) != NULL) {
-    sprintf(fpath, "%s/%s", dir, next_file->d_name);
-    remove(fpath);
+  /* First touch of the rank vectors by the thread owning the rows */
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i) {
+    it->p[i] = 1. / (double)it->no_nodes;
+    it->p_new[i] = 0.;
+    it->x[i] = it->out_deg[i] > 0 ? it->p[i] / (double)it->out_deg[i] : 0.;
   }
-  closedir(pf);
-  rmdir(dir);
 }
 
-void *mmap_data(char path[], size_t nmemb, size_t size) {
-  int fd;
-  char mmap_p[MMAP];
-  void *mp = NULL;
-  struct stat st;
+void pr_scatter_task(int tid, void *arg) {
+  PR_iteration *it = (PR_iteration *)arg;
+  int no_parts = it->stream->data.no_parts;
+  long *pos = it->stream_pos + (long)tid * no_parts;
 
-  sprintf(mmap_p, "./%s", path);
-#ifdef DEBUG
-  printf("mmapping \"%s\"... ", mmap_p);
-#endif
-  stat(path, &st);
-  if (access(path, F_OK) != 0) {
-#ifdef DEBUG
-    printf("file does not exist.\n");
-#endif
-  } else if (st.st_size != nmemb * size) {
-    printf("unexpected file size.\n");
-  } else {
-    fd = open(mmap_p, O_RDONLY);
-    mp = mmap(NULL, nmemb * size, PROT_READ, MAP_SHARED, fd, 0);
-    if (mp == MAP_FAILED)
-#ifdef DEBUG
-    {
-      printf("failed.\n");
-#endif
-      mp = NULL;
-#ifdef DEBUG
-    } else
-      printf("success.\n");
-#endif
-    close(fd);
+  memcpy(pos, it->stream_start + (long)tid * no_parts,
+         sizeof(long) * no_parts);
+  stream_scatter(it->stream, it->x, it->updates, pos,
+                 it->scatter_bounds[tid], it->scatter_bounds[tid + 1]);
+}
+
+void pr_spmv_task(int tid, void *arg) {
+  PR_iteration *it = (PR_iteration *)arg;
+
+  if (it->stream != NULL)
+    stream_gather(it->stream, it->updates, it->p_new, it->chunk_bounds[tid],
+                  it->chunk_bounds[tid + 1]);
+  else if (it->sell != NULL)
+    it->kernel->sell_pattern(it->sell, it->x, it->p_new,
+                             it->chunk_bounds[tid], it->chunk_bounds[tid + 1]);
+  else
+    it->kernel->pattern(it->row_ptr, it->col_ind, it->x, it->p_new,
+                        it->bounds[tid], it->bounds[tid + 1]);
+}
+
+void pr_update_task(int tid, void *arg) {
+  PR_iteration *it = (PR_iteration *)arg;
+  double *p = it->p, *p_new = it->p_new, *x = it->x;
+  const int *out_deg = it->out_deg;
+  double d = it->d, teleport = (1. - it->d) / (double)it->no_nodes;
+  double dtp = it->danglings_dot_product;
+  double dist = 0., danglings_sum = 0.;
+  int i, j;
+
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i) {
+    p_new[i] = d * (p_new[i] + dtp) + teleport;
+    x[i] = out_deg[i] > 0 ? p_new[i] / (double)out_deg[i] : 0.;
+  }
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i)
+    dist += (p[i] - p_new[i]) * (p[i] - p_new[i]);
+  for (j = it->dangling_bounds[tid]; j < it->dangling_bounds[tid + 1]; ++j)
+    danglings_sum += p_new[it->danglings[j]];
+  if (it->dangling_edges != NULL)
+    for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i)
+      danglings_sum += x[i] * it->dangling_edges[i];
+  it->partial[tid].dist = dist;
+  it->partial[tid].danglings_sum = danglings_sum;
+  if (it->topk != NULL)
+    topk_scan(it->topk, tid, p_new, it->bounds[tid], it->bounds[tid + 1]);
+  if (it->series != NULL)
+    pr_series_task(tid, arg);
+}
+
+/* Adds coeff[f] p to the series of every factor f, over the rows of tid */
+void pr_series_task(int tid, void *arg) {
+  PR_iteration *it = (PR_iteration *)arg;
+  const double *p = it->p;
+  double *series;
+  int m = it->no_factors;
+  int i, f;
+
+  for (i = it->bounds[tid]; i < it->bounds[tid + 1]; ++i) {
+    series = it->series + (long)i * m;
+    for (f = 0; f < m; ++f)
+      series[f] += it->coeff[f] * p[i];
   }
-  return mp;
+}
+
+/* Damping factors separated by commas, at most MAX_FACTORS of them; returns
+ * their number, 0 if the list is invalid */
+int parse_damping(const char *list, double *d) {
+  char *end;
+  int m = 0;
+
+  do {
+    if (m == MAX_FACTORS)
+      return 0;
+    d[m] = strtod(list, &end);
+    if (end == list || d[m] <= 0. || d[m] >= 1. ||
+        (*end != ',' && *end != '\0'))
+      return 0;
+    ++m;
+    list = end + 1;
+  } while (*end == ',');
+  return m;
+}
+
+/* One result file per factor, <fname>_d<factor>.pr */
+int write_series(const char fname[], const Graph *graph, const double *series,
+                 const double *d, int m, double *x) {
+  char path[PATH];
+  double *v;
+  int no_nodes = graph->data.no_nodes;
+  int f, i;
+
+  if ((v = (double *)malloc(sizeof(double) * no_nodes)) == NULL)
+    return EXIT_FAILURE;
+  for (f = 0; f < m; ++f) {
+    for (i = 0; i < no_nodes; ++i)
+      v[i] = series[(long)i * m + f];
+    graph_unpermute(graph, v, x);
+    sprintf(path, "%s_d%g.pr", fname, d[f]);
+    if (write_data(path, (void *)x, sizeof(double), no_nodes) ==
+        EXIT_FAILURE) {
+      free(v);
+      return EXIT_FAILURE;
+    }
+  }
+  free(v);
+  return EXIT_SUCCESS;
+}
+
+/* d * (A y)_i + 1 / n for row i of L^T, x holding y / out_deg */
+static double pr_block_row(const PR_blocks *b, int i) {
+  double sum = 0.;
+  long k;
+
+  for (k = b->row_ptr[i]; k < b->row_ptr[i + 1]; ++k)
+    sum += b->x[GRAPH_ID(b->col_ind, b->index_width, k)];
+  return b->d * sum + b->teleport;
+}
+
+static void pr_block_set(PR_blocks *b, int i, double y) {
+  b->y[i] = y;
+  b->x[i] = b->out_deg[i] > 0 ? y / (double)b->out_deg[i] : 0.;
+}
+
+/* Single node: y_i = (d * (A y)_i without the self loops + 1 / n) /
+ * (1 - d * self loops / out_deg), no iteration needed */
+static void pr_block_single(PR_blocks *b, int i) {
+  double sum = 0.;
+  long k;
+  int j, loops = 0;
+
+  for (k = b->row_ptr[i]; k < b->row_ptr[i + 1]; ++k) {
+    j = GRAPH_ID(b->col_ind, b->index_width, k);
+    if (j == i)
+      ++loops;
+    else
+      sum += b->x[j];
+  }
+  pr_block_set(b, i,
+               (b->d * sum + b->teleport) /
+                   (loops > 0 ? 1. - b->d * loops / (double)b->out_deg[i]
+                              : 1.));
+}
+
+/* Once every step is the previous one times a steady ratio r, the error is
+ * dominated by the slowest mode of the component and the remaining steps
+ * form a geometric series: their sum, r / (1 - r) times the last step, is
+ * added at once. dist and dot are the squared norm of the step and its
+ * product with the previous one. Returns the factor, 0 when not
+ * extrapolating. */
+static double pr_block_extrapolate(PR_block_conv *conv, double dist,
+                                   double dot) {
+  double ratio = conv->dist > 0. ? dot / conv->dist : 0.;
+  double f = 0.;
+
+  if (++conv->since > 2 && fabs(ratio) < 1. &&
+      dot * dot > 0.999 * dist * conv->dist &&
+      fabs(ratio - conv->ratio) < 1.e-2 * fabs(ratio)) {
+    f = ratio / (1. - ratio);
+    conv->since = 0;
+  }
+  conv->dist = dist;
+  conv->ratio = ratio;
+  return f;
+}
+
+/* Jacobi iterations over the nodes of component c, those of the earlier
+ * components being final */
+static void pr_block_solve(PR_blocks *b, int c, PR_block_partial *part) {
+  const int *nodes = b->scc->nodes;
+  int lo = b->scc->comp_ptr[c], hi = b->scc->comp_ptr[c + 1];
+  PR_block_conv conv = {0., 0., 0};
+  double dist = DBL_MAX, dot, f = 0.;
+  int iter, i, j;
+
+  if (hi - lo == 1) {
+    pr_block_single(b, nodes[lo]);
+    ++part->updates;
+    return;
+  }
+  for (iter = 0; (dist > TOL * TOL || f > 0.) && iter < MAX_ITER; ++iter) {
+    dist = dot = 0.;
+    for (j = lo; j < hi; ++j) {
+      i = nodes[j];
+      b->y_new[i] = pr_block_row(b, i);
+      dist += (b->y_new[i] - b->y[i]) * (b->y_new[i] - b->y[i]);
+      dot += (b->y_new[i] - b->y[i]) * b->step[i];
+    }
+    f = pr_block_extrapolate(&conv, dist, dot);
+    for (j = lo; j < hi; ++j) {
+      i = nodes[j];
+      b->step[i] = b->y_new[i] - b->y[i];
+      pr_block_set(b, i, b->y_new[i] + f * b->step[i]);
+    }
+    part->updates += hi - lo;
+  }
+  if (iter > part->max_iter)
+    part->max_iter = iter;
+}
+
+/* The small components of a level, claimed one at a time */
+static void pr_blocks_task(int tid, void *arg) {
+  PR_blocks *b = (PR_blocks *)arg;
+  const int *comp_ptr = b->scc->comp_ptr;
+  int c;
+
+  while ((c = __sync_fetch_and_add(&b->next, 1)) < b->last)
+    if (b->no_threads == 1 || comp_ptr[c + 1] - comp_ptr[c] < SCC_TEAM_NODES)
+      pr_block_solve(b, c, b->partial + tid);
+}
+
+/* One Jacobi iteration of a large component, split among the threads */
+static void pr_block_row_task(int tid, void *arg) {
+  PR_blocks *b = (PR_blocks *)arg;
+  const int *nodes = b->scc->nodes;
+  int lo = b->scc->comp_ptr[b->comp], n = b->scc->comp_ptr[b->comp + 1] - lo;
+  double dist = 0., dot = 0.;
+  int i, j;
+
+  for (j = lo + (int)((long)n * tid / b->no_threads);
+       j < lo + (int)((long)n * (tid + 1) / b->no_threads); ++j) {
+    i = nodes[j];
+    b->y_new[i] = pr_block_row(b, i);
+    dist += (b->y_new[i] - b->y[i]) * (b->y_new[i] - b->y[i]);
+    dot += (b->y_new[i] - b->y[i]) * b->step[i];
+  }
+  b->partial[tid].dist = dist;
+  b->partial[tid].dot = dot;
+}
+
+static void pr_block_set_task(int tid, void *arg) {
+  PR_blocks *b = (PR_blocks *)arg;
+  const int *nodes = b->scc->nodes;
+  int lo = b->scc->comp_ptr[b->comp], n = b->scc->comp_ptr[b->comp + 1] - lo;
+  int i, j;
+
+  for (j = lo + (int)((long)n * tid / b->no_threads);
+       j < lo + (int)((long)n * (tid + 1) / b->no_threads); ++j) {
+    i = nodes[j];
+    b->step[i] = b->y_new[i] - b->y[i];
+    pr_block_set(b, i, b->y_new[i] + b->f * b->step[i]);
+  }
+}
+
+/* Solves the components level by level and returns y normalized, that is
+ * PageRank, with the iterations of the slowest component; *updates gets the
+ * rows computed, against no_nodes per power iteration */
+int pr_blocks(Team *team, const Scc *scc, const long *row_ptr,
+              const void *col_ind, int index_width, const int *out_deg,
+              double d, double *y, double *y_new, double *x, long *updates) {
+  PR_blocks b;
+  PR_block_conv conv;
+  int no_nodes = scc->comp_ptr[scc->no_comps];
+  double dist, dot, sum;
+  int max_iter = 0, iter;
+  int l, c, t, i;
+
+  b.scc = scc;
+  b.row_ptr = row_ptr;
+  b.col_ind = col_ind;
+  b.index_width = index_width;
+  b.out_deg = out_deg;
+  b.d = d;
+  b.teleport = 1. / (double)no_nodes;
+  b.y = y;
+  b.y_new = y_new;
+  b.x = x;
+  b.f = 0.;
+  b.no_threads = team_size(team);
+  b.partial = (PR_block_partial *)calloc(b.no_threads,
+                                         sizeof(PR_block_partial));
+  b.step = (double *)calloc(no_nodes + 1, sizeof(double));
+  if (b.partial == NULL || b.step == NULL) {
+    fprintf(stderr, " [ERROR] Not enough memory for the components\n");
+    exit(EXIT_FAILURE);
+  }
+  *updates = 0;
+  memset(y, 0, sizeof(double) * no_nodes);
+  memset(x, 0, sizeof(double) * no_nodes);
+
+  for (l = 0; l < scc->no_levels; ++l) {
+    b.first = scc->level_ptr[l];
+    b.last = scc->level_ptr[l + 1];
+    b.next = b.first;
+    /* Levels of few rows are not worth waking the threads for */
+    if (scc->comp_ptr[b.last] - scc->comp_ptr[b.first] < SCC_TEAM_NODES)
+      pr_blocks_task(0, &b);
+    else
+      team_run(team, pr_blocks_task, &b);
+
+    /* Then the large ones, with all the threads */
+    for (c = b.first; c < b.last && b.no_threads > 1; ++c) {
+      if (scc->comp_ptr[c + 1] - scc->comp_ptr[c] < SCC_TEAM_NODES)
+        continue;
+      b.comp = c;
+      conv.dist = conv.ratio = 0.;
+      conv.since = 0;
+      dist = DBL_MAX;
+      for (iter = 0; (dist > TOL * TOL || b.f > 0.) && iter < MAX_ITER;
+           ++iter) {
+        team_run(team, pr_block_row_task, &b);
+        for (t = 0, dist = dot = 0.; t < b.no_threads; ++t) {
+          dist += b.partial[t].dist;
+          dot += b.partial[t].dot;
+        }
+        b.f = pr_block_extrapolate(&conv, dist, dot);
+        team_run(team, pr_block_set_task, &b);
+        *updates += scc->comp_ptr[c + 1] - scc->comp_ptr[c];
+      }
+      b.f = 0.;
+      if (iter > max_iter)
+        max_iter = iter;
+    }
+  }
+  for (t = 0; t < b.no_threads; ++t) {
+    *updates += b.partial[t].updates;
+    if (b.partial[t].max_iter > max_iter)
+      max_iter = b.partial[t].max_iter;
+  }
+  free(b.partial);
+  free(b.step);
+
+  /* p = y / ||y||_1 */
+  for (i = 0, sum = 0.; i < no_nodes; ++i)
+    sum += y[i];
+  for (i = 0; i < no_nodes; ++i)
+    y[i] /= sum;
+  return max_iter;
+}
+
+/* PageRank is y / ||y||_1, where (I - d A) y = (1 - d) e / n for
+ * A = L^T D^-1 without the danglings. Starting from y = e / n, whose
+ * residual r = (1 - d) e / n - (I - d A) y is d A y - d e / n, moving r_v
+ * into y_v and d r_v / out_deg(v) into the residuals of the targets of v
+ * keeps y + (I - d A)^-1 r the same, so only the frontier, the nodes whose
+ * residual is above TOL / sqrt(n), needs to move at every iteration; once it
+ * is empty ||r||_2 <= TOL. A small frontier pushes along L, touching the
+ * edges of its nodes only; one with more than 1 / PULL_RATIO of the edges
+ * pulls along L^T with the threads, as the power iteration does, and
+ * extrapolates like the components of -C once the moves shrink by a steady
+ * ratio. Returns the iterations, -1 without memory. */
+int pr_residual(Team *team, PR_iteration *it, const long *row_ptr,
+                const void *col_ind, int index_width, PR_residual *res) {
+  const int *out_deg = it->out_deg;
+  int n = it->no_nodes;
+  long no_edges = row_ptr[n];
+  double *y = it->p, *x = it->x, *r, *step;
+  double d = it->d, theta = TOL / sqrt(n > 0 ? (double)n : 1.), sum, val;
+  PR_block_conv conv = {0., 0., 0};
+  double dist, dot, f;
+  int *front, *next, *swap;
+  char *in_front;
+  long k, front_edges;
+  int no_front, no_next, iter;
+  int i, v, w;
+
+  memset(res, 0, sizeof(PR_residual));
+  r = (double *)malloc(sizeof(double) * (n + 1));
+  step = (double *)calloc(n + 1, sizeof(double));
+  front = (int *)malloc(sizeof(int) * (n + 1));
+  next = (int *)malloc(sizeof(int) * (n + 1));
+  in_front = (char *)calloc(n + 1, 1);
+  if (r == NULL || step == NULL || front == NULL || next == NULL ||
+      in_front == NULL) {
+    free(r);
+    free(step);
+    free(front);
+    free(next);
+    free(in_front);
+    return -1;
+  }
+  no_front = 0;
+  for (v = 0; v < n; ++v)
+    x[v] = out_deg[v] > 0 ? d / (double)n / (double)out_deg[v] : 0.;
+  team_run(team, pr_spmv_task, it);
+  for (v = 0; v < n; ++v) {
+    y[v] = 1. / (double)n;
+    r[v] = it->p_new[v] - d / (double)n;
+    if (fabs(r[v]) > theta) {
+      front[no_front++] = v;
+      in_front[v] = 1;
+    }
+  }
+
+  for (iter = 0; no_front > 0 && iter < MAX_ITER; ++iter) {
+    printf("\riter %d", iter);
+    for (i = 0, front_edges = 0; i < no_front; ++i)
+      front_edges += out_deg[front[i]];
+
+    if ((front_edges + no_front) * PULL_RATIO > no_edges) {
+      /* Pull: the scaled residuals of the frontier through L^T, then the
+       * next frontier from a scan of all the residuals. Adding f times the
+       * move s to y takes f (I - d A) s off the residuals, and d A s is the
+       * product just pulled. */
+      memset(x, 0, sizeof(double) * n);
+      for (i = 0, dist = dot = 0.; i < no_front; ++i) {
+        v = front[i];
+        dist += r[v] * r[v];
+        dot += r[v] * step[v];
+      }
+      memset(step, 0, sizeof(double) * n);
+      for (i = 0; i < no_front; ++i) {
+        v = front[i];
+        y[v] += r[v];
+        x[v] = out_deg[v] > 0 ? d * r[v] / (double)out_deg[v] : 0.;
+        step[v] = r[v];
+        r[v] = 0.;
+        in_front[v] = 0;
+      }
+      f = pr_block_extrapolate(&conv, dist, dot);
+      team_run(team, pr_spmv_task, it);
+      for (v = 0, no_front = 0; v < n; ++v) {
+        r[v] += it->p_new[v];
+        if (f > 0.) {
+          y[v] += f * step[v];
+          r[v] += f * (it->p_new[v] - step[v]);
+        }
+        if (fabs(r[v]) > theta) {
+          front[no_front++] = v;
+          in_front[v] = 1;
+        }
+      }
+      ++res->no_pull;
+      res->pull_edges += no_edges;
+    } else {
+      /* Push: the residuals of the frontier taken first, so that every
+       * node moves what it had at the start of the iteration */
+      conv.since = 0;
+      for (i = 0; i < no_front; ++i) {
+        v = front[i];
+        y[v] += r[v];
+        x[v] = r[v];
+        r[v] = 0.;
+        in_front[v] = 0;
+      }
+      for (i = 0, no_next = 0; i < no_front; ++i) {
+        v = front[i];
+        if (out_deg[v] == 0)
+          continue;
+        val = d * x[v] / (double)out_deg[v];
+        for (k = row_ptr[v]; k < row_ptr[v + 1]; ++k) {
+          w = GRAPH_ID(col_ind, index_width, k);
+          r[w] += val;
+          if (fabs(r[w]) > theta && !in_front[w]) {
+            in_front[w] = 1;
+            next[no_next++] = w;
+          }
+        }
+      }
+      swap = front;
+      front = next;
+      next = swap;
+      no_front = no_next;
+      ++res->no_push;
+      res->push_edges += front_edges;
+    }
+  }
+
+  /* What is left of the residuals moves in at no cost */
+  res->no_front = no_front;
+  for (v = 0, sum = 0., dist = 0.; v < n; ++v) {
+    dist += r[v] * r[v];
+    y[v] += r[v];
+    sum += y[v];
+  }
+  res->dist = sqrt(dist);
+  for (v = 0; v < n; ++v)
+    y[v] /= sum;
+  free(r);
+  free(step);
+  free(front);
+  free(next);
+  free(in_front);
+  return iter;
+}
+
+/* Edges of every non-dangling node to the danglings, the rows [no_rows,
+ * no_nodes) of L^T */
+int *lump_edges(const long *row_ptr, const void *col_ind, int index_width,
+                int no_rows, int no_nodes) {
+  int *count = (int *)calloc(no_rows + 1, sizeof(int));
+  long k;
+
+  if (count == NULL) {
+    fprintf(stderr, " [ERROR] Not enough memory for the lumped danglings\n");
+    exit(EXIT_FAILURE);
+  }
+  for (k = row_ptr[no_rows]; k < row_ptr[no_nodes]; ++k)
+    ++count[GRAPH_ID(col_ind, index_width, k)];
+  return count;
 }
 
 void print_vec_f(double *v, int n) {
   int i;
   printf("[ ");
-  for (i = 0; i < n; ++i)
+  for (i = 0; i < n && i < MAX_PRINT; ++i)
     printf("%.3f ", v[i]);
+  if (n > MAX_PRINT)
+    printf("... (%d more) ", n - MAX_PRINT);
   printf("]\n");
 }
 
@@ -519,71 +1554,304 @@ void print_vec_d(int *v, int n) {
   printf("]\n");
 }
 
-void double_merge(int *from, int *to, int lo, int mid, int hi) {
-  int *FL, *TL;
-  int *FR, *TR;
-  int i, j;
-  int NL, NR;
-
-  NL = mid - lo;
-  NR = hi - mid;
-
-  FL = (int *)malloc(sizeof(int) * NL);
-  TL = (int *)malloc(sizeof(int) * NL);
-  FR = (int *)malloc(sizeof(int) * NR);
-  TR = (int *)malloc(sizeof(int) * NR);
+int cmp_int(const void *a, const void *b) {
+  return (*(const int *)a > *(const int *)b) -
+         (*(const int *)a < *(const int *)b);
+}
 
-  for (i = 0; i < NL; ++i) {
-    FL[i] = from[lo + i];
-    TL[i] = to[lo + i];
+/* Rows of the part of dist->rank, their sources numbered locally: the nodes
+ * of the part first, in increasing order, then the halo, by part and in
+ * increasing order within a part, which is the order the other processes
+ * send them in. A node is sent to every part its edges of L enter. */
+int pr_plan(const Graph *g, const Partition *part, Dist *dist, long **row_ptr,
+            int **col_ind) {
+  const int *own = part->nodes + part->node_ptr[dist->rank];
+  int no_own = part->node_ptr[dist->rank + 1] - part->node_ptr[dist->rank];
+  int no_parts = part->data.no_parts, rank = dist->rank;
+  int *keys = NULL, *mark = NULL, *pos = NULL;
+  int *send_ptr, *send_ind, *send_node, *recv_ptr, *recv_node;
+  int no_keys = 0, no_halo, lo, hi, mid;
+  long k;
+  int i, q, u, key;
+
+  /* Halo: the sources in other parts, by their position in the partition */
+  *row_ptr = (long *)malloc(sizeof(long) * (no_own + 1));
+  for (i = 0, k = 0; i < no_own; ++i)
+    k += g->row_ptr_t[own[i] + 1] - g->row_ptr_t[own[i]];
+  *col_ind = (int *)malloc(sizeof(int) * (k + 1));
+  keys = (int *)malloc(sizeof(int) * (k + 1));
+  send_ptr = (int *)calloc(no_parts + 1, sizeof(int));
+  recv_ptr = (int *)calloc(no_parts + 1, sizeof(int));
+  mark = (int *)calloc(no_parts, sizeof(int));
+  pos = (int *)malloc(sizeof(int) * no_parts);
+  if (*row_ptr == NULL || *col_ind == NULL || keys == NULL ||
+      send_ptr == NULL || recv_ptr == NULL || mark == NULL || pos == NULL) {
+    free(keys);
+    free(send_ptr);
+    free(recv_ptr);
+    free(mark);
+    free(pos);
+    return EXIT_FAILURE;
   }
-
-  for (j = 0; j < NR; ++j) {
-    FR[j] = from[mid + j];
-    TR[j] = to[mid + j];
+  for (i = 0; i < no_own; ++i)
+    for (k = g->row_ptr_t[own[i]]; k < g->row_ptr_t[own[i] + 1]; ++k) {
+      u = GRAPH_ID(g->col_ind_t, g->index_width, k);
+      if (part->part[u] != rank)
+        keys[no_keys++] = part->node_ptr[part->part[u]] + part->index[u];
+    }
+  qsort(keys, no_keys, sizeof(int), cmp_int);
+  for (i = 0, no_halo = 0; i < no_keys; ++i)
+    if (no_halo == 0 || keys[i] != keys[no_halo - 1])
+      keys[no_halo++] = keys[i];
+  recv_node = (int *)malloc(sizeof(int) * (no_halo + 1));
+  for (i = 0; recv_node != NULL && i < no_halo; ++i) {
+    recv_node[i] = part->nodes[keys[i]];
+    ++recv_ptr[part->part[recv_node[i]] + 1];
+  }
+  for (q = 0; q < no_parts; ++q)
+    recv_ptr[q + 1] += recv_ptr[q];
+
+  /* Local rows */
+  (*row_ptr)[0] = 0;
+  for (i = 0; i < no_own; ++i) {
+    (*row_ptr)[i + 1] = (*row_ptr)[i];
+    for (k = g->row_ptr_t[own[i]]; k < g->row_ptr_t[own[i] + 1]; ++k) {
+      u = GRAPH_ID(g->col_ind_t, g->index_width, k);
+      if (part->part[u] == rank)
+        (*col_ind)[(*row_ptr)[i + 1]++] = part->index[u];
+      else {
+        key = part->node_ptr[part->part[u]] + part->index[u];
+        for (lo = 0, hi = no_halo; hi - lo > 1;) {
+          mid = lo + (hi - lo) / 2;
+          if (keys[mid] <= key)
+            lo = mid;
+          else
+            hi = mid;
+        }
+        (*col_ind)[(*row_ptr)[i + 1]++] = no_own + lo;
+      }
+    }
   }
 
-  i = 0;
-  j = 0;
-  while (i < NL && j < NR) {
-    if (TL[i] < TR[j] || (TL[i] == TR[j] && FL[i] <= FR[j])) {
-      from[lo + i + j] = FL[i];
-      to[lo + i + j] = TL[i];
-      ++i;
-    } else {
-      from[lo + i + j] = FR[j];
-      to[lo + i + j] = TR[j];
-      ++j;
+  /* Sends: the own nodes with edges of L into part q, increasing */
+  for (i = 0; i < no_own; ++i)
+    for (k = g->row_ptr[own[i]]; k < g->row_ptr[own[i] + 1]; ++k) {
+      q = part->part[GRAPH_ID(g->col_ind, g->index_width, k)];
+      if (q != rank && mark[q] != i + 1) {
+        mark[q] = i + 1;
+        ++send_ptr[q + 1];
+      }
     }
+  for (q = 0; q < no_parts; ++q) {
+    send_ptr[q + 1] += send_ptr[q];
+    pos[q] = send_ptr[q];
+    mark[q] = 0;
   }
+  send_ind = (int *)malloc(sizeof(int) * (send_ptr[no_parts] + 1));
+  send_node = (int *)malloc(sizeof(int) * (send_ptr[no_parts] + 1));
+  for (i = 0; send_ind != NULL && send_node != NULL && i < no_own; ++i)
+    for (k = g->row_ptr[own[i]]; k < g->row_ptr[own[i] + 1]; ++k) {
+      q = part->part[GRAPH_ID(g->col_ind, g->index_width, k)];
+      if (q != rank && mark[q] != i + 1) {
+        mark[q] = i + 1;
+        send_ind[pos[q]] = i;
+        send_node[pos[q]++] = own[i];
+      }
+    }
 
-  while (i < NL) {
-    from[lo + i + j] = FL[i];
-    to[lo + i + j] = TL[i];
-    ++i;
+  free(keys);
+  free(mark);
+  free(pos);
+  if (recv_node == NULL || send_ind == NULL || send_node == NULL) {
+    free(send_ptr);
+    free(send_ind);
+    free(send_node);
+    free(recv_ptr);
+    free(recv_node);
+    return EXIT_FAILURE;
   }
+  return dist_plan(dist, send_ptr, send_ind, send_node, recv_ptr, recv_node);
+}
 
-  while (j < NR) {
-    from[lo + i + j] = FR[j];
-    to[lo + i + j] = TR[j];
-    ++j;
+/* PageRank by no_procs processes, forked once the partition is loaded: each
+ * one iterates the rows of L^T of its part and, after every update, sends
+ * the scaled ranks the other parts read with the partial sums of the
+ * distance and of the dangling ranks */
+int pr_procs(Graph *g, const char input[], const char fname[],
+             const char *kernel_name, double d, int no_procs, int transport,
+             Phase_timer *timer) {
+  char part_p[PATH], fres[PATH];
+  Partition part;
+  Dist dist;
+  const SpMV_kernel *kernel;
+  long *row_ptr = NULL;
+  int *col_ind = NULL;
+  const int *own, *out_deg = g->out_deg;
+  double *p = NULL, *p_new = NULL, *x = NULL, *res = NULL, *swap;
+  double sums[DIST_SUMS], stats[DIST_SUMS];
+  int no_nodes = g->data.no_nodes, no_own, no_halo = 0;
+  double teleport = (1. - d) / (double)no_nodes, dtp, dist_sq, danglings_sum;
+  double dist_norm = DBL_MAX, begin, exchange_time = 0., elapsed_time;
+  int iter = 0, err;
+  int i, q;
+
+  /* Edge-cut partition, cached next to the graph */
+  timer_start(timer);
+  graph_path(fname, ".part", part_p);
+  if (part_open(&part, part_p, input, g->row_ptr, g->col_ind, g->row_ptr_t,
+                g->col_ind_t, g->index_width, no_nodes,
+                no_procs) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Partition could not be built.\n");
+    return EXIT_FAILURE;
+  }
+  printf("Partition: %d parts, %ld edges cut (%.2f%%, %.2f%% for row "
+         "ranges), heaviest part %.2f times the average\n",
+         no_procs, part.data.cut,
+         100. * part.data.cut / (part.data.no_edges > 0 ? part.data.no_edges
+                                                        : 1),
+         100. * part.data.range_cut /
+             (part.data.no_edges > 0 ? part.data.no_edges : 1),
+         (double)part.data.max_load * no_procs /
+             (no_nodes + part.data.no_edges));
+  timer_stop(timer, "partition");
+
+  /* From here on every process runs the same code on its own part */
+  timer_start(timer);
+  kernel = spmv_select(kernel_name, sizeof(int));
+  if (dist_spawn(&dist, no_procs, transport, no_nodes) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Processes could not be started.\n");
+    part_free(&part);
+    return EXIT_FAILURE;
+  }
+  own = part.nodes + part.node_ptr[dist.rank];
+  no_own = part.node_ptr[dist.rank + 1] - part.node_ptr[dist.rank];
+  err = pr_plan(g, &part, &dist, &row_ptr, &col_ind) == EXIT_FAILURE;
+  if (!err) {
+    no_halo = dist.recv_ptr[no_procs];
+    p = (double *)malloc(sizeof(double) * (no_own + 1));
+    p_new = (double *)malloc(sizeof(double) * (no_own + 1));
+    x = (double *)malloc(sizeof(double) * (no_own + no_halo + 1));
+    err = p == NULL || p_new == NULL || x == NULL;
   }
 
-  free(FL);
-  free(TL);
-  free(FR);
-  free(TR);
-}
+  /* All the processes ready, and the volume of an exchange */
+  stats[0] = err;
+  stats[1] = no_halo;
+  for (q = 0, stats[2] = 0.; !err && q < no_procs; ++q)
+    stats[2] += dist.recv_ptr[q + 1] > dist.recv_ptr[q];
+  stats[3] = 0.;
+  if (dist_sum(&dist, stats) == EXIT_FAILURE || stats[0] > 0.) {
+    if (dist.rank == 0)
+      fprintf(stderr, " [ERROR] Not enough memory for the processes\n");
+    err = 1;
+  }
+  if (!err && dist.rank == 0)
+    printf("Halo exchange (%s): %.0f values, %.1f KB in %.0f messages per "
+           "iteration, %.2f per node\n",
+           dist_transport_name(transport), stats[1],
+           stats[1] * sizeof(double) / 1e3, stats[2],
+           stats[1] / (no_nodes > 0 ? no_nodes : 1));
+
+  if (!err) {
+    sums[1] = 0.;
+    for (i = 0; i < no_own; ++i) {
+      p[i] = 1. / (double)no_nodes;
+      x[i] = out_deg[own[i]] > 0 ? p[i] / (double)out_deg[own[i]] : 0.;
+      if (out_deg[own[i]] == 0)
+        sums[1] += p[i];
+    }
+    sums[0] = sums[2] = sums[3] = 0.;
+    err = dist_exchange(&dist, x, x + no_own, sums) == EXIT_FAILURE;
+    dtp = sums[1] / (double)no_nodes;
+  }
+  timer_stop(timer, "setup");
+
+  if (!err && dist.rank == 0)
+    printf("Computing PageRank (%s kernel, %d processes)...\n",
+           kernel->name, no_procs);
+  timer_start(timer);
+  while (!err && dist_norm > TOL && iter < MAX_ITER) {
+    if (dist.rank == 0)
+      printf("\riter %d", iter);
 
-void double_merge_sort(int *from, int *to, int lo, int hi) {
-  if (hi - lo > 1) {
-    int mid = (lo + hi) / 2;
-    double_merge_sort(from, to, lo, mid);
-    double_merge_sort(from, to, mid, hi);
-    double_merge(from, to, lo, mid, hi);
+    kernel->pattern(row_ptr, col_ind, x, p_new, 0, no_own);
+    dist_sq = danglings_sum = 0.;
+    for (i = 0; i < no_own; ++i) {
+      p_new[i] = d * (p_new[i] + dtp) + teleport;
+      x[i] = out_deg[own[i]] > 0 ? p_new[i] / (double)out_deg[own[i]] : 0.;
+      dist_sq += (p[i] - p_new[i]) * (p[i] - p_new[i]);
+      if (out_deg[own[i]] == 0)
+        danglings_sum += p_new[i];
+    }
+    swap = p;
+    p = p_new;
+    p_new = swap;
+
+    begin = timer_now();
+    sums[0] = dist_sq;
+    sums[1] = danglings_sum;
+    sums[2] = sums[3] = 0.;
+    err = dist_exchange(&dist, x, x + no_own, sums) == EXIT_FAILURE;
+    exchange_time += timer_now() - begin;
+    dist_norm = sqrt(sums[0]);
+    dtp = sums[1] / (double)no_nodes;
+    ++iter;
+  }
+  elapsed_time = timer_stop(timer, "iterate");
+
+  /* Time in the exchanges and memory, over all the processes */
+  stats[0] = exchange_time;
+  stats[1] = elapsed_time;
+  stats[2] = (double)mem_peak_rss();
+  stats[3] = err;
+  if (dist_sum(&dist, stats) == EXIT_FAILURE || stats[3] > 0.)
+    err = 1;
+
+  /* The ranks of every part to the first process */
+  timer_start(timer);
+  if (!err && dist.rank == 0 &&
+      (res = (double *)malloc(sizeof(double) * (no_nodes + 1))) == NULL)
+    err = 1;
+  if (!err)
+    err = dist_gather(&dist, p, part.node_ptr, part.nodes, res) ==
+          EXIT_FAILURE;
+  free(row_ptr);
+  free(col_ind);
+  free(p);
+  free(p_new);
+  free(x);
+  err = dist_finish(&dist, err) == EXIT_FAILURE;
+  part_free(&part);
+  if (err) {
+    fprintf(stderr, " [ERROR] PageRank processes failed.\n");
+    free(res);
+    return EXIT_FAILURE;
   }
-}
 
-void sort_input_data(int *from, int *to, int n) {
-  double_merge_sort(from, to, 0, n);
+  printf("\riter %d\nDone.\n\n", iter);
+  for (i = 0, dtp = 0.; i < no_nodes; ++i)
+    dtp += res[i];
+  printf("Proof of correctness:\n");
+  printf("sum(p) = %f\n\n", dtp);
+  printf("Elapsed time: %.3fs\n", elapsed_time);
+  printf("Exchanges: %.3fs per process, %.1f%% of the iterations\n",
+         stats[0] / no_procs,
+         stats[1] > 0. ? 100. * stats[0] / stats[1] : 0.);
+  printf("Peak memory: %.1f MB over %d processes\n", stats[2] / 1e6,
+         no_procs);
+
+  /* Writing data back to memory, in increasing input id order */
+  p = (double *)malloc(sizeof(double) * (no_nodes + 1));
+  strcpy(fres, fname);
+  strcat(fres, ".pr");
+  err = p == NULL;
+  if (!err) {
+    graph_unpermute(g, res, p);
+    err = write_data(fres, (void *)p, sizeof(double), no_nodes) ==
+          EXIT_FAILURE;
+  }
+  timer_stop(timer, "output");
+  free(p);
+  free(res);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
 }
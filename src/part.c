@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graph.h"
+#include "part.h"
+#include "team.h"
+
+/* Both matrices, for the neighbors of a node in either direction */
+typedef struct {
+  const long *row_ptr, *row_ptr_t;
+  const void *col_ind, *col_ind_t;
+  int index_width;
+} Part_graph;
+
+/* Neighbors of v already in a part, counted by part */
+static void part_neighbors(const Part_graph *g, const int *part, int v,
+                           int *count) {
+  long k;
+  int q;
+
+  for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+    if ((q = part[GRAPH_ID(g->col_ind, g->index_width, k)]) >= 0)
+      ++count[q];
+  for (k = g->row_ptr_t[v]; k < g->row_ptr_t[v + 1]; ++k)
+    if ((q = part[GRAPH_ID(g->col_ind_t, g->index_width, k)]) >= 0)
+      ++count[q];
+}
+
+/* Breadth-first order of the undirected graph, from the lowest unvisited
+ * node, that is the highest degree, of every connected component */
+static int part_bfs(const Part_graph *g, int no_nodes, int *order) {
+  char *seen;
+  long k;
+  int head = 0, tail = 0;
+  int r, v, u;
+
+  if ((seen = (char *)calloc(no_nodes + 1, 1)) == NULL)
+    return EXIT_FAILURE;
+  for (r = 0; r < no_nodes; ++r) {
+    if (seen[r])
+      continue;
+    seen[r] = 1;
+    order[tail++] = r;
+    while (head < tail) {
+      v = order[head++];
+      for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+        if (!seen[u = GRAPH_ID(g->col_ind, g->index_width, k)]) {
+          seen[u] = 1;
+          order[tail++] = u;
+        }
+      for (k = g->row_ptr_t[v]; k < g->row_ptr_t[v + 1]; ++k)
+        if (!seen[u = GRAPH_ID(g->col_ind_t, g->index_width, k)]) {
+          seen[u] = 1;
+          order[tail++] = u;
+        }
+    }
+  }
+  free(seen);
+  return EXIT_SUCCESS;
+}
+
+/* Edges of L between two parts */
+static long part_cut(const Part_graph *g, const int *part, int no_nodes) {
+  long cut = 0, k;
+  int v;
+
+  for (v = 0; v < no_nodes; ++v)
+    for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+      cut += part[GRAPH_ID(g->col_ind, g->index_width, k)] != part[v];
+  return cut;
+}
+
+int part_build(Partition *p, const long *row_ptr, const void *col_ind,
+               const long *row_ptr_t, const void *col_ind_t, int index_width,
+               int no_nodes, int no_parts) {
+  Part_graph g;
+  int *order, *count, *bounds;
+  long *load;
+  double cap, score, best_score;
+  long w;
+  int pass, moves;
+  int i, v, q, best, cur;
+
+  memset(p, 0, sizeof(Partition));
+  g.row_ptr = row_ptr;
+  g.col_ind = col_ind;
+  g.row_ptr_t = row_ptr_t;
+  g.col_ind_t = col_ind_t;
+  g.index_width = index_width;
+  p->data.no_nodes = no_nodes;
+  p->data.no_parts = no_parts;
+  p->data.no_edges = row_ptr_t[no_nodes];
+  p->part = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  p->index = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  p->node_ptr = (int *)calloc(no_parts + 1, sizeof(int));
+  p->nodes = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  order = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  count = (int *)malloc(sizeof(int) * no_parts);
+  bounds = (int *)malloc(sizeof(int) * (no_parts + 1));
+  load = (long *)calloc(no_parts, sizeof(long));
+  if (p->part == NULL || p->index == NULL || p->node_ptr == NULL ||
+      p->nodes == NULL || order == NULL || count == NULL || bounds == NULL ||
+      load == NULL || part_bfs(&g, no_nodes, order) == EXIT_FAILURE) {
+    free(order);
+    free(count);
+    free(bounds);
+    free(load);
+    part_free(p);
+    return EXIT_FAILURE;
+  }
+
+  /* Greedy streaming in breadth-first order; a node heavier than the
+   * capacity still fits in an empty part */
+  cap = PART_SLACK * (double)(no_nodes + p->data.no_edges) / no_parts;
+  for (v = 0; v < no_nodes; ++v)
+    p->part[v] = -1;
+  for (i = 0; i < no_nodes; ++i) {
+    v = order[i];
+    w = 1 + row_ptr_t[v + 1] - row_ptr_t[v];
+    memset(count, 0, sizeof(int) * no_parts);
+    part_neighbors(&g, p->part, v, count);
+    best = 0;
+    best_score = -1.;
+    for (q = 0; q < no_parts; ++q) {
+      if (load[q] > 0 && load[q] + w > cap)
+        continue;
+      score = count[q] * (1. - load[q] / cap);
+      if (score > best_score ||
+          (score == best_score && load[q] < load[best])) {
+        best = q;
+        best_score = score;
+      }
+    }
+    if (best_score < 0.)
+      for (q = 0; q < no_parts; ++q)
+        if (load[q] < load[best])
+          best = q;
+    p->part[v] = best;
+    load[best] += w;
+  }
+
+  /* Label propagation: to the part of the most neighbors, if it has room */
+  for (pass = 0; pass < PART_PASSES; ++pass) {
+    moves = 0;
+    for (i = 0; i < no_nodes; ++i) {
+      v = order[i];
+      w = 1 + row_ptr_t[v + 1] - row_ptr_t[v];
+      cur = best = p->part[v];
+      memset(count, 0, sizeof(int) * no_parts);
+      part_neighbors(&g, p->part, v, count);
+      for (q = 0; q < no_parts; ++q)
+        if (q != cur && count[q] > count[best] && load[q] + w <= cap)
+          best = q;
+      if (best != cur) {
+        p->part[v] = best;
+        load[cur] -= w;
+        load[best] += w;
+        ++moves;
+      }
+    }
+    if (moves == 0)
+      break;
+  }
+
+  /* Nodes grouped by part, in increasing order */
+  for (v = 0; v < no_nodes; ++v)
+    ++p->node_ptr[p->part[v] + 1];
+  for (q = 0; q < no_parts; ++q)
+    p->node_ptr[q + 1] += p->node_ptr[q];
+  memcpy(count, p->node_ptr, sizeof(int) * no_parts);
+  for (v = 0; v < no_nodes; ++v) {
+    p->index[v] = count[p->part[v]] - p->node_ptr[p->part[v]];
+    p->nodes[count[p->part[v]]++] = v;
+  }
+  for (q = 0; q < no_parts; ++q)
+    if (load[q] > p->data.max_load)
+      p->data.max_load = load[q];
+
+  /* Cut of the partition and, for reference, of row ranges */
+  p->data.cut = part_cut(&g, p->part, no_nodes);
+  team_partition(row_ptr_t, no_nodes, no_parts, 1, bounds);
+  for (q = 0; q < no_parts; ++q)
+    for (v = bounds[q]; v < bounds[q + 1]; ++v)
+      order[v] = q;
+  p->data.range_cut = part_cut(&g, order, no_nodes);
+
+  free(order);
+  free(count);
+  free(bounds);
+  free(load);
+  return EXIT_SUCCESS;
+}
+
+int part_write(const Partition *p, const char path[], const char source[]) {
+  Cache_writer cw;
+  int no_nodes = p->data.no_nodes;
+
+  if (cache_create(&cw, path, source, sizeof(int), sizeof(long)) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  if (cache_add(&cw, "data", &p->data, sizeof(Part_data)) == EXIT_FAILURE ||
+      cache_add(&cw, "part", p->part, (no_nodes + 1) * sizeof(int)) ==
+          EXIT_FAILURE ||
+      cache_add(&cw, "index", p->index, (no_nodes + 1) * sizeof(int)) ==
+          EXIT_FAILURE ||
+      cache_add(&cw, "node_ptr", p->node_ptr,
+                (p->data.no_parts + 1) * sizeof(int)) == EXIT_FAILURE ||
+      cache_add(&cw, "nodes", p->nodes, (no_nodes + 1) * sizeof(int)) ==
+          EXIT_FAILURE) {
+    cache_abort(&cw);
+    return EXIT_FAILURE;
+  }
+  return cache_commit(&cw);
+}
+
+int part_load(Partition *p, const char path[], const char source[],
+              int no_parts) {
+  const Part_data *data;
+  int no_nodes;
+
+  memset(p, 0, sizeof(Partition));
+  if (cache_open(&p->cache, path, source, sizeof(int), sizeof(long)) !=
+      CACHE_OK)
+    return EXIT_FAILURE;
+  if ((data = (const Part_data *)cache_array(&p->cache, "data",
+                                             sizeof(Part_data))) == NULL ||
+      data->no_parts != no_parts) {
+    part_free(p);
+    return EXIT_FAILURE;
+  }
+  p->data = *data;
+
+  no_nodes = p->data.no_nodes;
+  p->part = (int *)cache_array(&p->cache, "part",
+                               (no_nodes + 1) * sizeof(int));
+  p->index = (int *)cache_array(&p->cache, "index",
+                                (no_nodes + 1) * sizeof(int));
+  p->node_ptr = (int *)cache_array(&p->cache, "node_ptr",
+                                   (no_parts + 1) * sizeof(int));
+  p->nodes = (int *)cache_array(&p->cache, "nodes",
+                                (no_nodes + 1) * sizeof(int));
+  if (p->part == NULL || p->index == NULL || p->node_ptr == NULL ||
+      p->nodes == NULL) {
+    part_free(p);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int part_open(Partition *p, const char path[], const char source[],
+              const long *row_ptr, const void *col_ind, const long *row_ptr_t,
+              const void *col_ind_t, int index_width, int no_nodes,
+              int no_parts) {
+  int err;
+
+  if (part_load(p, path, source, no_parts) == EXIT_SUCCESS)
+    return EXIT_SUCCESS;
+  printf("Building partition in %d parts \"%s\"...\n", no_parts, path);
+  err = (part_build(p, row_ptr, col_ind, row_ptr_t, col_ind_t, index_width,
+                    no_nodes, no_parts) == EXIT_FAILURE) ||
+        (part_write(p, path, source) == EXIT_FAILURE);
+  part_free(p);
+  if (err)
+    return EXIT_FAILURE;
+  return part_load(p, path, source, no_parts);
+}
+
+void part_free(Partition *p) {
+  if (p->cache.base != NULL)
+    cache_close(&p->cache);
+  else {
+    free(p->part);
+    free(p->index);
+    free(p->node_ptr);
+    free(p->nodes);
+  }
+  p->part = NULL;
+  p->index = NULL;
+  p->node_ptr = NULL;
+  p->nodes = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef PART_H
+#define PART_H
+
+/* Partition of the nodes into no_parts parts of about the same work, rows of
+ * L^T and their edges, cutting few edges: the edges between parts are those
+ * whose ranks cross from one process to another at every iteration. The
+ * nodes are streamed in breadth-first order of the undirected graph and each
+ * one goes to the part holding most of its neighbors, damped by how full the
+ * part is (linear deterministic greedy), then a few passes of label
+ * propagation move nodes to the part of most of their neighbors while the
+ * parts stay within PART_SLACK of the average. */
+#define PART_SLACK 1.03
+#define PART_PASSES 4
+#define PART_MAX 64
+
+#include "cache.h"
+
+typedef struct {
+  int no_nodes;
+  int no_parts;
+  long no_edges;
+  long cut;       /* edges between two parts */
+  long range_cut; /* of no_parts ranges of rows balanced the same way */
+  long max_load;  /* rows plus edges of L^T of the heaviest part */
+} Part_data;
+
+typedef struct {
+  Part_data data;
+  int *part;     /* part of every node */
+  int *index;    /* position of every node in its part */
+  int *node_ptr; /* no_parts + 1 offsets into nodes */
+  int *nodes;    /* nodes of every part, increasing */
+  Cache cache;   /* mapping of the arrays once loaded */
+} Partition;
+
+/* Partition of the graph with matrix L in (row_ptr, col_ind) and L^T in
+ * (row_ptr_t, col_ind_t) */
+int part_build(Partition *p, const long *row_ptr, const void *col_ind,
+               const long *row_ptr_t, const void *col_ind_t, int index_width,
+               int no_nodes, int no_parts);
+/* Cache container of the partition, rebuilt when stale or built with
+ * another number of parts */
+int part_write(const Partition *p, const char path[], const char source[]);
+int part_load(Partition *p, const char path[], const char source[],
+              int no_parts);
+/* Loads the partition, building and writing it first if needed */
+int part_open(Partition *p, const char path[], const char source[],
+              const long *row_ptr, const void *col_ind, const long *row_ptr_t,
+              const void *col_ind_t, int index_width, int no_nodes,
+              int no_parts);
+void part_free(Partition *p);
+
+#endif
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "perf.h"
+#include "timer.h"
+
+/* Iterations moving between PERF_BW_BOUND and PERF_BW_CACHED times the peak
+ * bandwidth are bandwidth-bound (above it the modelled gathers must be hitting
+ * the caches), otherwise those retiring PERF_IPC_BOUND instructions per cycle
+ * are compute-bound and the others latency-bound */
+#define PERF_BW_BOUND 0.6
+#define PERF_BW_CACHED 1.25
+#define PERF_IPC_BOUND 1.5
+
+#define PEAK_DOUBLES (1L << 23)
+#define PEAK_TRIALS 5
+
+#define CACHE_EVENT(cache, op, result)                                         \
+  ((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct {
+  const char *name;
+  unsigned int type;
+  unsigned long config;
+} events[PERF_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"dTLB-load-misses", PERF_TYPE_HW_CACHE,
+     CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"node-loads", PERF_TYPE_HW_CACHE,
+     CACHE_EVENT(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ,
+                 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {"node-load-misses", PERF_TYPE_HW_CACHE,
+     CACHE_EVENT(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ,
+                 PERF_COUNT_HW_CACHE_RESULT_MISS)}};
+
+int perf_open(Perf_counters *pc) {
+  struct perf_event_attr attr;
+  int i, no_open = 0;
+
+  for (i = 0; i < PERF_EVENTS; ++i) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    pc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    no_open += pc->fd[i] >= 0;
+  }
+  return no_open;
+}
+
+void perf_read(const Perf_counters *pc, double values[PERF_EVENTS]) {
+  uint64_t v;
+  int i;
+
+  for (i = 0; i < PERF_EVENTS; ++i) {
+    values[i] = -1.;
+    if (pc->fd[i] >= 0 && read(pc->fd[i], &v, sizeof(v)) == sizeof(v))
+      values[i] = (double)v;
+  }
+}
+
+void perf_close(Perf_counters *pc) {
+  int i;
+
+  for (i = 0; i < PERF_EVENTS; ++i)
+    if (pc->fd[i] >= 0)
+      close(pc->fd[i]);
+}
+
+const char *perf_name(int event) { return events[event].name; }
+
+void perf_profile_init(Perf_profile *pp, const Perf_counters *pc, int enabled) {
+  pp->pc = pc;
+  pp->enabled = enabled;
+  pp->no_samples = 0;
+  pp->capacity = 0;
+  pp->samples = NULL;
+  perf_profile_start(pp);
+}
+
+void perf_profile_start(Perf_profile *pp) {
+  if (!pp->enabled)
+    return;
+  perf_read(pp->pc, pp->counts);
+  pp->begin = timer_now();
+}
+
+void perf_profile_stop(Perf_profile *pp, const char *label, double bytes) {
+  Perf_sample *ps;
+  double counts[PERF_EVENTS];
+  double now;
+  int i;
+
+  if (!pp->enabled)
+    return;
+  now = timer_now();
+  perf_read(pp->pc, counts);
+  if (pp->no_samples == pp->capacity) {
+    pp->capacity = pp->capacity ? 2 * pp->capacity : 64;
+    pp->samples = (Perf_sample *)realloc(pp->samples,
+                                         sizeof(Perf_sample) * pp->capacity);
+  }
+  ps = pp->samples + pp->no_samples++;
+  strncpy(ps->label, label, PERF_LABEL - 1);
+  ps->label[PERF_LABEL - 1] = '\0';
+  ps->seconds = now - pp->begin;
+  ps->bytes = bytes;
+  for (i = 0; i < PERF_EVENTS; ++i)
+    ps->counts[i] = counts[i] >= 0. && pp->counts[i] >= 0.
+                        ? counts[i] - pp->counts[i]
+                        : -1.;
+
+  /* The next sample starts here */
+  for (i = 0; i < PERF_EVENTS; ++i)
+    pp->counts[i] = counts[i];
+  pp->begin = now;
+}
+
+void perf_profile_free(Perf_profile *pp) {
+  free(pp->samples);
+  pp->samples = NULL;
+  pp->no_samples = 0;
+  pp->capacity = 0;
+}
+
+static void perf_field(FILE *pf, double v, int width) {
+  if (v >= 0.)
+    fprintf(pf, " %*.0f", width, v);
+  else
+    fprintf(pf, " %*s", width, "n/a");
+}
+
+/* Sum of the samples with modelled traffic */
+static void perf_iterations(const Perf_profile *pp, Perf_sample *total,
+                            int *no_iter) {
+  const Perf_sample *ps;
+  int i, j;
+
+  memset(total, 0, sizeof(Perf_sample));
+  *no_iter = 0;
+  for (i = 0; i < pp->no_samples; ++i) {
+    ps = pp->samples + i;
+    if (ps->bytes <= 0.)
+      continue;
+    total->seconds += ps->seconds;
+    total->bytes += ps->bytes;
+    for (j = 0; j < PERF_EVENTS; ++j)
+      if (ps->counts[j] < 0. || total->counts[j] < 0.)
+        total->counts[j] = -1.;
+      else
+        total->counts[j] += ps->counts[j];
+    ++*no_iter;
+  }
+}
+
+const char *perf_profile_bound(const Perf_profile *pp, double peak_bw) {
+  Perf_sample total;
+  double ratio;
+  int no_iter;
+
+  perf_iterations(pp, &total, &no_iter);
+  if (no_iter == 0 || total.seconds <= 0.)
+    return "unknown";
+  ratio = peak_bw > 0. ? total.bytes / total.seconds / peak_bw : 0.;
+  if (ratio >= PERF_BW_BOUND && ratio <= PERF_BW_CACHED)
+    return "bandwidth-bound";
+  if (total.counts[PERF_CYCLES] > 0. && total.counts[PERF_INSTRUCTIONS] >= 0.)
+    return total.counts[PERF_INSTRUCTIONS] / total.counts[PERF_CYCLES] >=
+                   PERF_IPC_BOUND
+               ? "compute-bound"
+               : "latency-bound";
+  if (ratio > PERF_BW_CACHED)
+    return "cache-resident, latency- or compute-bound (no cycle counts)";
+  return "latency- or compute-bound (no cycle counts)";
+}
+
+void perf_profile_print(const Perf_profile *pp, double peak_bw, FILE *pf) {
+  const Perf_sample *ps;
+  Perf_sample total;
+  int no_iter;
+  int i;
+
+  fprintf(pf, "%-10s %9s %12s %12s %5s %10s %10s %7s %7s\n", "phase",
+          "time[ms]", "cycles", "instr", "IPC", "LLC-miss", "dTLB-miss",
+          "GB/s", "LLCGB/s");
+  for (i = 0; i < pp->no_samples; ++i) {
+    ps = pp->samples + i;
+    fprintf(pf, "%-10s %9.3f", ps->label, ps->seconds * 1e3);
+    perf_field(pf, ps->counts[PERF_CYCLES], 12);
+    perf_field(pf, ps->counts[PERF_INSTRUCTIONS], 12);
+    if (ps->counts[PERF_CYCLES] > 0. && ps->counts[PERF_INSTRUCTIONS] >= 0.)
+      fprintf(pf, " %5.2f",
+              ps->counts[PERF_INSTRUCTIONS] / ps->counts[PERF_CYCLES]);
+    else
+      fprintf(pf, " %5s", "n/a");
+    perf_field(pf, ps->counts[PERF_LLC_MISSES], 10);
+    perf_field(pf, ps->counts[PERF_DTLB_MISSES], 10);
+    if (ps->bytes > 0. && ps->seconds > 0.)
+      fprintf(pf, " %7.2f", ps->bytes / ps->seconds / 1e9);
+    else
+      fprintf(pf, " %7s", "-");
+    if (ps->counts[PERF_LLC_MISSES] >= 0. && ps->seconds > 0.)
+      fprintf(pf, " %7.2f",
+              ps->counts[PERF_LLC_MISSES] * PERF_LINE / ps->seconds / 1e9);
+    else
+      fprintf(pf, " %7s", "n/a");
+    fprintf(pf, "\n");
+  }
+
+  perf_iterations(pp, &total, &no_iter);
+  if (no_iter == 0 || total.seconds <= 0.)
+    return;
+  fprintf(pf, "\nPeak read bandwidth: %.2f GB/s\n", peak_bw / 1e9);
+  fprintf(pf, "Iterations: %.2f GB/s modelled",
+          total.bytes / total.seconds / 1e9);
+  if (peak_bw > 0.)
+    fprintf(pf, " (%.0f%% of peak)",
+            100. * total.bytes / total.seconds / peak_bw);
+  if (total.counts[PERF_CYCLES] > 0. && total.counts[PERF_INSTRUCTIONS] >= 0.)
+    fprintf(pf, ", IPC %.2f",
+            total.counts[PERF_INSTRUCTIONS] / total.counts[PERF_CYCLES]);
+  if (total.counts[PERF_LLC_MISSES] >= 0.)
+    fprintf(pf, ", %.2f GB/s from LLC misses",
+            total.counts[PERF_LLC_MISSES] * PERF_LINE / total.seconds / 1e9);
+  fprintf(pf, "\n");
+  fprintf(pf, "The iterations are %s\n", perf_profile_bound(pp, peak_bw));
+}
+
+int perf_profile_csv(const Perf_profile *pp, const char *path) {
+  const Perf_sample *ps;
+  FILE *pf;
+  int i, j;
+
+  if ((pf = fopen(path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  fprintf(pf, "phase,seconds,bytes");
+  for (j = 0; j < PERF_EVENTS; ++j)
+    fprintf(pf, ",%s", events[j].name);
+  fprintf(pf, "\n");
+  for (i = 0; i < pp->no_samples; ++i) {
+    ps = pp->samples + i;
+    fprintf(pf, "%s,%.9f,%.0f", ps->label, ps->seconds, ps->bytes);
+    for (j = 0; j < PERF_EVENTS; ++j)
+      if (ps->counts[j] >= 0.)
+        fprintf(pf, ",%.0f", ps->counts[j]);
+      else
+        fprintf(pf, ",");
+    fprintf(pf, "\n");
+  }
+  fclose(pf);
+  return EXIT_SUCCESS;
+}
+
+/* Streaming read of thread tid's share of the buffer, one cache line of
+ * partial sums per thread */
+typedef struct {
+  double *buf;
+  long n;
+  int no_threads;
+  int init;
+  double *sum;
+} Peak_stream;
+
+static void perf_stream_task(int tid, void *arg) {
+  Peak_stream *ps = (Peak_stream *)arg;
+  long lo = ps->n * tid / ps->no_threads;
+  long hi = ps->n * (tid + 1) / ps->no_threads;
+  double s0 = 0., s1 = 0., s2 = 0., s3 = 0.;
+  long i;
+
+  if (ps->init) {
+    for (i = lo; i < hi; ++i)
+      ps->buf[i] = 1.;
+    return;
+  }
+  for (i = lo; i + 3 < hi; i += 4) {
+    s0 += ps->buf[i];
+    s1 += ps->buf[i + 1];
+    s2 += ps->buf[i + 2];
+    s3 += ps->buf[i + 3];
+  }
+  for (; i < hi; ++i)
+    s0 += ps->buf[i];
+  ps->sum[8 * tid] = s0 + s1 + s2 + s3;
+}
+
+double perf_peak_bandwidth(Team *team, int pages) {
+  Peak_stream ps;
+  double begin, best = 0., seconds;
+  int t;
+
+  ps.n = PEAK_DOUBLES;
+  ps.no_threads = team_size(team);
+  if ((ps.buf = (double *)mem_alloc(sizeof(double) * ps.n, pages)) == NULL)
+    return -1.;
+  ps.sum = (double *)malloc(sizeof(double) * 8 * ps.no_threads);
+
+  /* Every thread first touches the part it reads */
+  ps.init = 1;
+  team_run(team, perf_stream_task, &ps);
+  ps.init = 0;
+  for (t = 0; t < PEAK_TRIALS; ++t) {
+    begin = timer_now();
+    team_run(team, perf_stream_task, &ps);
+    seconds = timer_now() - begin;
+    if (seconds > 0. && sizeof(double) * ps.n / seconds > best)
+      best = sizeof(double) * ps.n / seconds;
+  }
+  free(ps.sum);
+  mem_free(ps.buf, sizeof(double) * ps.n);
+  return best;
+}
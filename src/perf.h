@@ -0,0 +1,67 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+
+#include "team.h"
+
+/* Hardware counters, read through perf_event_open(2) */
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_LLC_MISSES 2
+#define PERF_DTLB_MISSES 3
+#define PERF_NODE_LOADS 4
+#define PERF_NODE_MISSES 5
+#define PERF_EVENTS 6
+
+#define PERF_LABEL 16
+#define PERF_LINE 64 /* bytes moved by a last level cache miss */
+
+/* Counters of the calling process and of the threads it creates after
+ * perf_open(); an event the host does not expose has fd -1 */
+typedef struct {
+  int fd[PERF_EVENTS];
+} Perf_counters;
+
+int perf_open(Perf_counters *pc);
+void perf_read(const Perf_counters *pc, double values[PERF_EVENTS]);
+void perf_close(Perf_counters *pc);
+const char *perf_name(int event);
+
+/* Counts of a phase or of an iteration, -1 for unavailable events */
+typedef struct {
+  char label[PERF_LABEL];
+  double seconds;
+  double bytes; /* modelled memory traffic, 0 if not modelled */
+  double counts[PERF_EVENTS];
+} Perf_sample;
+
+/* Profiling mode: the counters are sampled around every phase and every
+ * iteration; nothing is recorded while disabled */
+typedef struct {
+  const Perf_counters *pc;
+  int enabled;
+  int no_samples;
+  int capacity;
+  Perf_sample *samples;
+  double begin;
+  double counts[PERF_EVENTS];
+} Perf_profile;
+
+void perf_profile_init(Perf_profile *pp, const Perf_counters *pc, int enabled);
+void perf_profile_start(Perf_profile *pp);
+/* Records the counts since perf_profile_start() as a sample and restarts */
+void perf_profile_stop(Perf_profile *pp, const char *label, double bytes);
+void perf_profile_free(Perf_profile *pp);
+
+/* Prints the samples as a table followed by a verdict on the samples with
+ * modelled traffic (the iterations), peak_bw being perf_peak_bandwidth() */
+void perf_profile_print(const Perf_profile *pp, double peak_bw, FILE *pf);
+int perf_profile_csv(const Perf_profile *pp, const char *path);
+const char *perf_profile_bound(const Perf_profile *pp, double peak_bw);
+
+/* Read bandwidth of the team streaming through a buffer much larger than
+ * the caches, in bytes per second */
+double perf_peak_bandwidth(Team *team, int pages);
+
+#endif
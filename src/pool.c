@@ -0,0 +1,253 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+/* Failed rounds over the deques before an idle worker sleeps */
+#define POOL_SPINS 64
+
+typedef struct {
+  pool_fn fn;
+  void *arg;
+  volatile int *pending;
+} Pool_task;
+
+/* Tasks [head, tail) of a growing ring, the owner at the tail and thieves
+ * at the head; a lock per deque is cheap next to the tasks of a batch. Thieves
+ * peek at head and tail without it, and check again under it. */
+typedef struct {
+  pthread_mutex_t lock;
+  Pool_task *tasks;
+  volatile long head, tail;
+  long mask;
+  long no_tasks, no_steals;
+  char pad[64];
+} Pool_deque;
+
+/* Idle workers sleep on wake once they fail to find a task, until a task is
+ * queued, a count of pending tasks drops to 0 or the pool quits; the others
+ * only take the lock to wake them when sleepers says some are asleep */
+struct Pool {
+  int no_threads;
+  pthread_t *threads;
+  Pool_deque *deques;
+  volatile int quit;
+  volatile long queued;
+  volatile int sleepers;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+};
+
+typedef struct {
+  Pool *pool;
+  int worker;
+} Pool_worker;
+
+/* The newest task of worker, or the oldest one of another worker */
+static int pool_take(Pool *pool, int worker, Pool_task *task) {
+  Pool_deque *q = pool->deques + worker;
+  int i, v;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->tail > q->head) {
+    *task = q->tasks[--q->tail & q->mask];
+    ++q->no_tasks;
+    pthread_mutex_unlock(&q->lock);
+    __sync_fetch_and_sub(&pool->queued, 1);
+    return 1;
+  }
+  pthread_mutex_unlock(&q->lock);
+  for (i = 1; i < pool->no_threads; ++i) {
+    v = (worker + i) % pool->no_threads;
+    q = pool->deques + v;
+    if (q->tail == q->head)
+      continue;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head) {
+      *task = q->tasks[q->head++ & q->mask];
+      pthread_mutex_unlock(&q->lock);
+      __sync_fetch_and_sub(&pool->queued, 1);
+      q = pool->deques + worker;
+      pthread_mutex_lock(&q->lock);
+      ++q->no_tasks;
+      ++q->no_steals;
+      pthread_mutex_unlock(&q->lock);
+      return 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+  }
+  return 0;
+}
+
+/* Wakes the sleeping workers; the atomic update that precedes it is a full
+ * barrier, so a worker either sees that update or is counted in sleepers */
+static void pool_wake(Pool *pool, int all) {
+  if (pool->sleepers == 0)
+    return;
+  pthread_mutex_lock(&pool->lock);
+  if (all)
+    pthread_cond_broadcast(&pool->wake);
+  else
+    pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* Sleeps until a task is queued, *pending drops to 0 or the pool quits */
+static void pool_sleep(Pool *pool, volatile int *pending) {
+  pthread_mutex_lock(&pool->lock);
+  __sync_fetch_and_add(&pool->sleepers, 1);
+  while (pool->queued == 0 && !pool->quit &&
+         (pending == NULL || *pending > 0))
+    pthread_cond_wait(&pool->wake, &pool->lock);
+  __sync_fetch_and_sub(&pool->sleepers, 1);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_run(Pool *pool, int worker, Pool_task *task) {
+  task->fn(worker, task->arg);
+  if (__sync_sub_and_fetch(task->pending, 1) == 0)
+    pool_wake(pool, 1);
+}
+
+static void *pool_loop(void *arg) {
+  Pool_worker *w = (Pool_worker *)arg;
+  Pool *pool = w->pool;
+  int worker = w->worker;
+  Pool_task task;
+  int spins = 0;
+
+  free(w);
+  while (!pool->quit) {
+    if (pool_take(pool, worker, &task)) {
+      pool_run(pool, worker, &task);
+      spins = 0;
+    } else if (++spins < POOL_SPINS)
+      sched_yield();
+    else {
+      pool_sleep(pool, NULL);
+      spins = 0;
+    }
+  }
+  return NULL;
+}
+
+Pool *pool_create(int no_threads) {
+  Pool *pool;
+  Pool_worker *w;
+  int i;
+
+  if (no_threads < 1)
+    no_threads = 1;
+  if ((pool = (Pool *)calloc(1, sizeof(Pool))) == NULL)
+    return NULL;
+  pool->no_threads = no_threads;
+  pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * no_threads);
+  pool->deques = (Pool_deque *)calloc(no_threads, sizeof(Pool_deque));
+  if (pool->threads == NULL || pool->deques == NULL) {
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  for (i = 0; i < no_threads; ++i)
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+  for (i = 1; i < no_threads; ++i) {
+    if ((w = (Pool_worker *)malloc(sizeof(Pool_worker))) == NULL)
+      break;
+    w->pool = pool;
+    w->worker = i;
+    if (pthread_create(pool->threads + i, NULL, pool_loop, w) != 0) {
+      free(w);
+      break;
+    }
+  }
+  if (i < no_threads) {
+    /* Only the workers below i were started */
+    pool->no_threads = i;
+    for (; i < no_threads; ++i)
+      pthread_mutex_destroy(&pool->deques[i].lock);
+    pool_destroy(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+void pool_destroy(Pool *pool) {
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 1; i < pool->no_threads; ++i)
+    pthread_join(pool->threads[i], NULL);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  for (i = 0; i < pool->no_threads; ++i) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].tasks);
+  }
+  free(pool->threads);
+  free(pool->deques);
+  free(pool);
+}
+
+int pool_size(const Pool *pool) { return pool->no_threads; }
+
+int pool_spawn(Pool *pool, int worker, pool_fn fn, void *arg,
+               volatile int *pending) {
+  Pool_deque *q = pool->deques + worker;
+  Pool_task *tasks;
+  long size, k;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->tasks == NULL || q->tail - q->head > q->mask) {
+    /* Full: the ring doubles, the tasks keeping their order */
+    size = q->tasks == NULL ? 64 : 2 * (q->mask + 1);
+    if ((tasks = (Pool_task *)malloc(sizeof(Pool_task) * size)) == NULL) {
+      pthread_mutex_unlock(&q->lock);
+      return EXIT_FAILURE;
+    }
+    for (k = q->head; k < q->tail; ++k)
+      tasks[k & (size - 1)] = q->tasks[k & q->mask];
+    free(q->tasks);
+    q->tasks = tasks;
+    q->mask = size - 1;
+  }
+  __sync_fetch_and_add(pending, 1);
+  q->tasks[q->tail & q->mask].fn = fn;
+  q->tasks[q->tail & q->mask].arg = arg;
+  q->tasks[q->tail & q->mask].pending = pending;
+  ++q->tail;
+  __sync_fetch_and_add(&pool->queued, 1);
+  pthread_mutex_unlock(&q->lock);
+  pool_wake(pool, 0);
+  return EXIT_SUCCESS;
+}
+
+void pool_wait(Pool *pool, int worker, volatile int *pending) {
+  Pool_task task;
+  int spins = 0;
+
+  while (*pending > 0) {
+    if (pool_take(pool, worker, &task)) {
+      pool_run(pool, worker, &task);
+      spins = 0;
+    } else if (++spins < POOL_SPINS)
+      sched_yield();
+    else {
+      pool_sleep(pool, pending);
+      spins = 0;
+    }
+  }
+  __sync_synchronize();
+}
+
+void pool_stats(const Pool *pool, int worker, long *tasks, long *steals) {
+  *tasks = pool->deques[worker].no_tasks;
+  *steals = pool->deques[worker].no_steals;
+}
@@ -0,0 +1,27 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Pool of worker threads that steal work: every worker owns a deque of tasks,
+ * runs its newest task first and, with nothing left, takes the oldest task of
+ * another worker. A task may spawn tasks and wait for them, running other
+ * tasks meanwhile, so that a large job splits its work across the workers
+ * that are idle while small jobs each stay on one worker. The thread that
+ * creates the pool is worker 0 and only runs tasks while it waits. */
+typedef void (*pool_fn)(int worker, void *arg);
+
+typedef struct Pool Pool;
+
+/* NULL if the memory or the threads of the pool could not be had */
+Pool *pool_create(int no_threads);
+void pool_destroy(Pool *pool);
+int pool_size(const Pool *pool);
+/* Queues fn(arg) on the deque of worker, counted in *pending until it has
+ * run; returns EXIT_FAILURE without memory */
+int pool_spawn(Pool *pool, int worker, pool_fn fn, void *arg,
+               volatile int *pending);
+/* Runs the tasks of worker, or stolen ones, until *pending drops to 0 */
+void pool_wait(Pool *pool, int worker, volatile int *pending);
+/* Tasks run by worker, and those of them taken from another worker */
+void pool_stats(const Pool *pool, int worker, long *tasks, long *steals);
+
+#endif
@@ -0,0 +1,233 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "query.h"
+
+/* Sub-CSR of the base set: row i of (row_ptr, col_ind) lists the targets of
+ * base node i, row i of (row_ptr_t, col_ind_t) its sources */
+typedef struct {
+  int no_nodes;
+  long no_edges;
+  long *row_ptr, *row_ptr_t;
+  int *col_ind, *col_ind_t;
+} Query_graph;
+
+static void query_add(Query_engine *q, Query_result *r, int v) {
+  if (q->local[v] < 0) {
+    q->local[v] = r->no_base;
+    r->nodes[r->no_base++] = v;
+  }
+}
+
+/* Roots, then their out- and in-neighbors. The rows of the cache are sorted
+ * by column and nodes are numbered by decreasing degree, so the in-neighbors
+ * kept are those of highest degree. */
+static int query_base(Query_engine *q, const uint64_t *ids, int no_ids,
+                      Query_result *r) {
+  const Graph *g = q->g;
+  int width = g->index_width;
+  long bound = 0, k, end;
+  int i, v, no_roots;
+
+  for (i = 0; i < no_ids; ++i)
+    if ((v = query_node(g, ids[i])) >= 0)
+      bound += 1 + (g->row_ptr[v + 1] - g->row_ptr[v]) +
+               (g->row_ptr_t[v + 1] - g->row_ptr_t[v] < q->max_in
+                    ? g->row_ptr_t[v + 1] - g->row_ptr_t[v]
+                    : q->max_in);
+  if (bound > g->data.no_nodes)
+    bound = g->data.no_nodes;
+  if ((r->nodes = (int *)mem_arena_alloc(&q->arena,
+                                         sizeof(int) * (bound + 1))) == NULL)
+    return EXIT_FAILURE;
+
+  for (i = 0; i < no_ids; ++i)
+    if ((v = query_node(g, ids[i])) >= 0)
+      query_add(q, r, v);
+  no_roots = r->no_base;
+  for (i = 0; i < no_roots; ++i) {
+    v = r->nodes[i];
+    for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+      query_add(q, r, GRAPH_ID(g->col_ind, width, k));
+    end = g->row_ptr_t[v] + q->max_in;
+    if (end > g->row_ptr_t[v + 1])
+      end = g->row_ptr_t[v + 1];
+    for (k = g->row_ptr_t[v]; k < end; ++k)
+      query_add(q, r, GRAPH_ID(g->col_ind_t, width, k));
+  }
+  r->no_roots = no_roots;
+  return EXIT_SUCCESS;
+}
+
+/* Edges of the cache between base nodes, and their transpose by counting */
+static int query_subgraph(Query_engine *q, const Query_result *r,
+                          Query_graph *s) {
+  const Graph *g = q->g;
+  int width = g->index_width;
+  int n = r->no_base;
+  long k, e;
+  int i, j, v;
+
+  s->no_nodes = n;
+  s->row_ptr = (long *)mem_arena_alloc(&q->arena, sizeof(long) * (n + 1));
+  s->row_ptr_t = (long *)mem_arena_alloc(&q->arena, sizeof(long) * (n + 1));
+  if (s->row_ptr == NULL || s->row_ptr_t == NULL)
+    return EXIT_FAILURE;
+  memset(s->row_ptr_t, 0, sizeof(long) * (n + 1));
+  s->row_ptr[0] = 0;
+  for (i = 0; i < n; ++i) {
+    v = r->nodes[i];
+    e = 0;
+    for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+      if ((j = q->local[GRAPH_ID(g->col_ind, width, k)]) >= 0) {
+        ++e;
+        ++s->row_ptr_t[j + 1];
+      }
+    s->row_ptr[i + 1] = s->row_ptr[i] + e;
+  }
+  s->no_edges = s->row_ptr[n];
+  s->col_ind = (int *)mem_arena_alloc(&q->arena, sizeof(int) * s->no_edges);
+  s->col_ind_t = (int *)mem_arena_alloc(&q->arena, sizeof(int) * s->no_edges);
+  if ((s->col_ind == NULL || s->col_ind_t == NULL) && s->no_edges > 0)
+    return EXIT_FAILURE;
+  for (i = 0; i < n; ++i)
+    s->row_ptr_t[i + 1] += s->row_ptr_t[i];
+
+  /* Rows of the transpose filled in increasing source order, so sorted */
+  for (i = 0; i < n; ++i) {
+    v = r->nodes[i];
+    e = s->row_ptr[i];
+    for (k = g->row_ptr[v]; k < g->row_ptr[v + 1]; ++k)
+      if ((j = q->local[GRAPH_ID(g->col_ind, width, k)]) >= 0)
+        s->col_ind[e++] = j;
+  }
+  for (i = 0; i < n; ++i)
+    for (k = s->row_ptr[i]; k < s->row_ptr[i + 1]; ++k)
+      s->col_ind_t[s->row_ptr_t[s->col_ind[k]]++] = i;
+  for (i = n; i > 0; --i)
+    s->row_ptr_t[i] = s->row_ptr_t[i - 1];
+  s->row_ptr_t[0] = 0;
+  return EXIT_SUCCESS;
+}
+
+/* Normalizes v_new to unit L1 norm and moves it to v, returning the L1
+ * distance between the two */
+static double query_normalize(double *v, double *v_new, int n) {
+  double sum = 0., dist = 0.;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    sum += v_new[i];
+  if (sum > 0.)
+    for (i = 0; i < n; ++i)
+      v_new[i] /= sum;
+  for (i = 0; i < n; ++i) {
+    dist += fabs(v_new[i] - v[i]);
+    v[i] = v_new[i];
+  }
+  return dist;
+}
+
+/* The iteration of hits.c: a = L^T h and h = L a from the previous a and h,
+ * both normalized, until both move by at most tol */
+static int query_hits(Query_engine *q, const Query_graph *s,
+                      Query_result *r) {
+  int n = s->no_nodes;
+  double *a_new, *h_new, sum;
+  long k;
+  int i;
+
+  r->a = (double *)mem_arena_alloc(&q->arena, sizeof(double) * n);
+  r->h = (double *)mem_arena_alloc(&q->arena, sizeof(double) * n);
+  a_new = (double *)mem_arena_alloc(&q->arena, sizeof(double) * n);
+  h_new = (double *)mem_arena_alloc(&q->arena, sizeof(double) * n);
+  if (r->a == NULL || r->h == NULL || a_new == NULL || h_new == NULL)
+    return EXIT_FAILURE;
+  for (i = 0; i < n; ++i)
+    r->a[i] = r->h[i] = 1.;
+
+  r->a_dist = r->h_dist = 0.;
+  for (r->iter = 0; r->iter < q->max_iter;) {
+    for (i = 0; i < n; ++i) {
+      sum = 0.;
+      for (k = s->row_ptr_t[i]; k < s->row_ptr_t[i + 1]; ++k)
+        sum += r->h[s->col_ind_t[k]];
+      a_new[i] = sum;
+      sum = 0.;
+      for (k = s->row_ptr[i]; k < s->row_ptr[i + 1]; ++k)
+        sum += r->a[s->col_ind[k]];
+      h_new[i] = sum;
+    }
+    r->a_dist = query_normalize(r->a, a_new, n);
+    r->h_dist = query_normalize(r->h, h_new, n);
+    ++r->iter;
+    if (r->a_dist <= q->tol && r->h_dist <= q->tol)
+      break;
+  }
+  return EXIT_SUCCESS;
+}
+
+int query_init(Query_engine *q, const Graph *g, int max_in, double tol,
+               int max_iter) {
+  int i;
+
+  memset(q, 0, sizeof(Query_engine));
+  q->g = g;
+  q->max_in = max_in;
+  q->tol = tol;
+  q->max_iter = max_iter;
+  if ((q->local = (int *)malloc(sizeof(int) * (g->data.no_nodes + 1))) ==
+          NULL ||
+      mem_arena_init(&q->arena, 0) == EXIT_FAILURE) {
+    free(q->local);
+    return EXIT_FAILURE;
+  }
+  for (i = 0; i < g->data.no_nodes; ++i)
+    q->local[i] = -1;
+  return EXIT_SUCCESS;
+}
+
+void query_free(Query_engine *q) {
+  free(q->local);
+  mem_arena_free(&q->arena);
+  q->local = NULL;
+}
+
+int query_node(const Graph *g, uint64_t id) {
+  int lo = 0, hi = g->data.no_nodes, mid;
+
+  /* First k with ids[order[k]] >= id */
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (g->ids[g->order[mid]] < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < g->data.no_nodes && g->ids[g->order[lo]] == id ? g->order[lo]
+                                                             : -1;
+}
+
+int query_run(Query_engine *q, const uint64_t *ids, int no_ids,
+              Query_result *r) {
+  Query_graph s;
+  int err;
+  int i;
+
+  mem_arena_reset(&q->arena);
+  memset(r, 0, sizeof(Query_result));
+  err = query_base(q, ids, no_ids, r) == EXIT_FAILURE ||
+        query_subgraph(q, r, &s) == EXIT_FAILURE;
+  if (!err && r->no_base > 0) {
+    r->no_edges = s.no_edges;
+    err = query_hits(q, &s, r) == EXIT_FAILURE;
+  }
+
+  /* Back to no base for the next query */
+  if (r->nodes != NULL)
+    for (i = 0; i < r->no_base; ++i)
+      q->local[r->nodes[i]] = -1;
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
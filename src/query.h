@@ -0,0 +1,45 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+/* Query-dependent HITS, as Kleinberg defined it: the root set of a query is
+ * grown into a base set with the targets of the edges of every root and the
+ * sources of at most max_in of the edges entering it, and HITS runs on the
+ * subgraph induced by the base set. The subgraph is copied out of the cache
+ * into a compact CSR and its transpose, numbered by base node, in an arena
+ * that keeps its memory from one query to the next, so a resident process
+ * answers a query with no allocation once warm. */
+#define QUERY_MAX_IN 50 /* sources of the edges entering a root */
+
+#include "graph.h"
+#include "mem.h"
+
+typedef struct {
+  int no_roots;  /* found in the graph, duplicates removed */
+  int no_base;
+  long no_edges; /* of the induced subgraph */
+  int iter;
+  double a_dist, h_dist;
+  int *nodes;    /* graph node of every base node, roots first */
+  double *a, *h; /* L1-normalized scores of the base nodes */
+} Query_result;
+
+typedef struct {
+  const Graph *g;
+  int *local; /* base node of every graph node, -1 outside the base */
+  Mem_arena arena;
+  int max_in;
+  double tol;
+  int max_iter;
+} Query_engine;
+
+int query_init(Query_engine *q, const Graph *g, int max_in, double tol,
+               int max_iter);
+void query_free(Query_engine *q);
+/* Node of an input id, -1 if not in the graph */
+int query_node(const Graph *g, uint64_t id);
+/* HITS on the base set of the nodes with the given input ids, unknown ones
+ * skipped; the result lives in the arena until the next query */
+int query_run(Query_engine *q, const uint64_t *ids, int no_ids,
+              Query_result *r);
+
+#endif
@@ -0,0 +1,81 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "queue.h"
+
+int queue_create(Queue *q, size_t capacity) {
+  size_t size = 2;
+  size_t i;
+
+  while (size < capacity)
+    size <<= 1;
+  if ((q->cells = (Queue_cell *)malloc(sizeof(Queue_cell) * size)) == NULL)
+    return EXIT_FAILURE;
+  for (i = 0; i < size; ++i)
+    q->cells[i].seq = i;
+  q->mask = size - 1;
+  q->head = 0;
+  q->tail = 0;
+  q->closed = 0;
+  return EXIT_SUCCESS;
+}
+
+void queue_free(Queue *q) {
+  free(q->cells);
+  q->cells = NULL;
+}
+
+void queue_push(Queue *q, void *item) {
+  Queue_cell *cell;
+  size_t pos;
+  long dif;
+
+  for (;;) {
+    pos = q->tail;
+    cell = q->cells + (pos & q->mask);
+    dif = (long)(cell->seq - pos);
+    if (dif == 0 && __sync_bool_compare_and_swap(&q->tail, pos, pos + 1))
+      break;
+    /* Full: the cell has not been read on the previous lap yet */
+    if (dif < 0)
+      sched_yield();
+  }
+  cell->item = item;
+  __sync_synchronize();
+  cell->seq = pos + 1;
+}
+
+void *queue_pop(Queue *q) {
+  Queue_cell *cell;
+  void *item;
+  size_t pos;
+  long dif;
+  int closed;
+
+  for (;;) {
+    pos = q->head;
+    cell = q->cells + (pos & q->mask);
+    dif = (long)(cell->seq - (pos + 1));
+    if (dif == 0 && __sync_bool_compare_and_swap(&q->head, pos, pos + 1))
+      break;
+    if (dif < 0) {
+      /* Empty: over if it was closed, the last item having been pushed
+       * before that */
+      closed = q->closed;
+      __sync_synchronize();
+      if (closed && (long)(cell->seq - (pos + 1)) < 0 && q->head == pos)
+        return NULL;
+      sched_yield();
+    }
+  }
+  item = cell->item;
+  __sync_synchronize();
+  cell->seq = pos + q->mask + 1;
+  return item;
+}
+
+void queue_close(Queue *q) {
+  __sync_synchronize();
+  q->closed = 1;
+}
@@ -0,0 +1,33 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+/* Bounded lock-free queue of pointers between the stages of a pipeline, for
+ * any number of producers and consumers: every cell carries a sequence number
+ * telling whether it may be written or read on the current lap, and head and
+ * tail are advanced with compare-and-swap. A full or empty queue makes the
+ * caller yield the CPU until it can go on. */
+typedef struct {
+  volatile size_t seq;
+  void *item;
+} Queue_cell;
+
+typedef struct {
+  Queue_cell *cells;
+  size_t mask;
+  volatile size_t head, tail;
+  volatile int closed;
+} Queue;
+
+/* Room for at least capacity items */
+int queue_create(Queue *q, size_t capacity);
+void queue_free(Queue *q);
+/* Waits while the queue is full */
+void queue_push(Queue *q, void *item);
+/* Waits while the queue is empty; NULL once it is closed and drained */
+void *queue_pop(Queue *q);
+/* No more items: called once all the producers are done */
+void queue_close(Queue *q);
+
+#endif
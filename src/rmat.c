@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Synthetic power-law graphs with the recursive matrix (R-MAT) model: every
+ * edge descends scale levels of the adjacency matrix, choosing one of the
+ * four quadrants with probabilities a, b, c and 1 - a - b - c. The edges are
+ * written sorted and without duplicates in the SNAP text format read by
+ * pagerank and hits. */
+
+#define DEFAULT_SCALE 16
+#define DEFAULT_EDGE_FACTOR 16
+#define DEFAULT_A 0.57
+#define DEFAULT_B 0.19
+#define DEFAULT_C 0.19
+
+typedef struct {
+  int from;
+  int to;
+} Edge;
+
+unsigned long next_random(unsigned long *state);
+double next_uniform(unsigned long *state);
+int edge_cmp(const void *x, const void *y);
+
+int main(int argc, char *argv[]) {
+  FILE *pf;
+  Edge *edges;
+  unsigned long state;
+  double a = DEFAULT_A, b = DEFAULT_B, c = DEFAULT_C;
+  double r;
+  long no_edges, no_unique;
+  long e;
+  int scale = DEFAULT_SCALE;
+  int edge_factor = DEFAULT_EDGE_FACTOR;
+  int no_nodes, from, to, half;
+  int level;
+  int opt;
+
+  state = 1;
+  while ((opt = getopt(argc, argv, "s:e:a:b:c:S:")) != -1) {
+    switch (opt) {
+    case 's':
+      scale = atoi(optarg);
+      break;
+    case 'e':
+      edge_factor = atoi(optarg);
+      break;
+    case 'a':
+      a = atof(optarg);
+      break;
+    case 'b':
+      b = atof(optarg);
+      break;
+    case 'c':
+      c = atof(optarg);
+      break;
+    case 'S':
+      state = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, " [ERROR] usage: ./rmat [-s <scale>] [-e <edge_factor>] "
+                      "[-a <a>] [-b <b>] [-c <c>] [-S <seed>] <output>\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (argc - optind != 1) {
+    fprintf(stderr, " [ERROR] *1* argument required: ./rmat <output>\n");
+    exit(EXIT_FAILURE);
+  }
+  if (scale < 1 || scale > 30 || edge_factor < 1) {
+    fprintf(stderr, " [ERROR] the graph must have less than 2^31 nodes (scale "
+                    "in [1, 30]) and at least one edge per node\n");
+    exit(EXIT_FAILURE);
+  }
+  if (a < 0. || b < 0. || c < 0. || a + b + c > 1.) {
+    fprintf(stderr, " [ERROR] a, b, c must be probabilities with a sum "
+                    "not greater than 1\n");
+    exit(EXIT_FAILURE);
+  }
+
+  no_nodes = 1 << scale;
+  no_edges = (long)edge_factor << scale;
+  if ((edges = (Edge *)malloc(sizeof(Edge) * no_edges)) == NULL) {
+    fprintf(stderr, " [ERROR] cannot allocate %ld edges\n", no_edges);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Generating R-MAT graph (scale %d, edge factor %d, a %.2f, b %.2f, "
+         "c %.2f)...\n",
+         scale, edge_factor, a, b, c);
+  for (e = 0; e < no_edges; ++e) {
+    from = 0;
+    to = 0;
+    for (level = 0, half = no_nodes >> 1; level < scale; ++level, half >>= 1) {
+      r = next_uniform(&state);
+      if (r >= a + b + c) {
+        from += half;
+        to += half;
+      } else if (r >= a + b)
+        from += half;
+      else if (r >= a)
+        to += half;
+    }
+    edges[e].from = from;
+    edges[e].to = to;
+  }
+
+  /* Sorting by source and destination, as the parsers expect */
+  qsort(edges, no_edges, sizeof(Edge), edge_cmp);
+  no_unique = 0;
+  for (e = 0; e < no_edges; ++e)
+    if (no_unique == 0 || edge_cmp(edges + e, edges + no_unique - 1) != 0)
+      edges[no_unique++] = edges[e];
+  printf("%d nodes, %ld edges (%ld duplicates removed)\n", no_nodes, no_unique,
+         no_edges - no_unique);
+
+  if ((pf = fopen(argv[optind], "w")) == NULL) {
+    fprintf(stderr, " [ERROR] cannot open output file \"%s\"\n", argv[optind]);
+    free(edges);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(pf, "# Directed graph: %s\n", argv[optind]);
+  fprintf(pf, "# R-MAT scale %d, edge factor %d, a %g, b %g, c %g\n", scale,
+          edge_factor, a, b, c);
+  fprintf(pf, "# Nodes: %d Edges: %ld\n", no_nodes, no_unique);
+  fprintf(pf, "# FromNodeId\tToNodeId\n");
+  for (e = 0; e < no_unique; ++e)
+    fprintf(pf, "%d\t%d\n", edges[e].from, edges[e].to);
+  fclose(pf);
+  free(edges);
+  printf("Done.\n");
+
+  exit(EXIT_SUCCESS);
+}
+
+/* Helper functions */
+
+/* splitmix64 */
+unsigned long next_random(unsigned long *state) {
+  unsigned long z = (*state += 0x9e3779b97f4a7c15UL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1) with 53 random bits */
+double next_uniform(unsigned long *state) {
+  return (double)(next_random(state) >> 11) * (1. / 9007199254740992.);
+}
+
+int edge_cmp(const void *x, const void *y) {
+  const Edge *ex = (const Edge *)x, *ey = (const Edge *)y;
+
+  if (ex->from != ey->from)
+    return ex->from < ey->from ? -1 : 1;
+  if (ex->to != ey->to)
+    return ex->to < ey->to ? -1 : 1;
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graph.h"
+#include "scc.h"
+
+/* Tarjan's algorithm with an explicit stack of calls, each one holding the
+ * next edge of its node to follow. A component is found after all the
+ * components it reaches, so its numbers are in reverse topological order.
+ * Returns the number of components, -1 without memory. */
+static int scc_tarjan(const long *row_ptr, const void *col_ind,
+                      int index_width, int no_nodes, int *comp) {
+  int *index, *low, *stack, *call;
+  long *next;
+  int no_comps = 0, counter = 0, top = 0, depth;
+  int r, v, w;
+
+  index = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  low = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  stack = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  call = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  next = (long *)malloc(sizeof(long) * (no_nodes + 1));
+  if (index == NULL || low == NULL || stack == NULL || call == NULL ||
+      next == NULL) {
+    free(index);
+    free(low);
+    free(stack);
+    free(call);
+    free(next);
+    return -1;
+  }
+  for (v = 0; v < no_nodes; ++v) {
+    index[v] = -1;
+    comp[v] = -1;
+  }
+
+  for (r = 0; r < no_nodes; ++r) {
+    if (index[r] >= 0)
+      continue;
+    depth = 0;
+    call[depth++] = r;
+    next[r] = row_ptr[r];
+    index[r] = low[r] = counter++;
+    stack[top++] = r;
+    while (depth > 0) {
+      v = call[depth - 1];
+      if (next[v] < row_ptr[v + 1]) {
+        w = GRAPH_ID(col_ind, index_width, next[v]);
+        ++next[v];
+        if (index[w] < 0) {
+          /* Descending into w */
+          call[depth++] = w;
+          next[w] = row_ptr[w];
+          index[w] = low[w] = counter++;
+          stack[top++] = w;
+        } else if (comp[w] < 0 && index[w] < low[v])
+          low[v] = index[w]; /* w is still on the stack */
+        continue;
+      }
+      /* All the edges of v followed: v may close a component */
+      --depth;
+      if (low[v] == index[v]) {
+        do {
+          w = stack[--top];
+          comp[w] = no_comps;
+        } while (w != v);
+        ++no_comps;
+      }
+      if (depth > 0 && low[v] < low[call[depth - 1]])
+        low[call[depth - 1]] = low[v];
+    }
+  }
+
+  free(index);
+  free(low);
+  free(stack);
+  free(call);
+  free(next);
+  return no_comps;
+}
+
+int scc_compute(Scc *s, const long *row_ptr, const void *col_ind,
+                int index_width, int no_nodes) {
+  int *level, *rank, *count;
+  int no_comps;
+  int i, j, c, t, l;
+  long k;
+
+  memset(s, 0, sizeof(Scc));
+  s->comp = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  s->nodes = (int *)malloc(sizeof(int) * (no_nodes + 1));
+  if (s->comp == NULL || s->nodes == NULL ||
+      (no_comps = scc_tarjan(row_ptr, col_ind, index_width, no_nodes,
+                             s->comp)) < 0) {
+    scc_free(s);
+    return EXIT_FAILURE;
+  }
+  s->no_comps = no_comps;
+  level = (int *)calloc(no_comps + 1, sizeof(int));
+  rank = (int *)malloc(sizeof(int) * (no_comps + 1));
+  count = (int *)calloc(no_comps + 2, sizeof(int));
+  s->comp_ptr = (int *)malloc(sizeof(int) * (no_comps + 1));
+  if (level == NULL || rank == NULL || count == NULL || s->comp_ptr == NULL) {
+    free(level);
+    free(rank);
+    free(count);
+    scc_free(s);
+    return EXIT_FAILURE;
+  }
+
+  /* Nodes grouped by topological number, no_comps - 1 - Tarjan's */
+  for (i = 0; i < no_nodes; ++i) {
+    s->comp[i] = no_comps - 1 - s->comp[i];
+    ++count[s->comp[i] + 1];
+  }
+  for (c = 0; c < no_comps; ++c)
+    count[c + 1] += count[c];
+  memcpy(s->comp_ptr, count, sizeof(int) * (no_comps + 1));
+  for (i = 0; i < no_nodes; ++i)
+    s->nodes[count[s->comp[i]]++] = i;
+
+  /* Levels, final for a component once all the lower numbers are done */
+  s->no_levels = no_comps > 0 ? 1 : 0;
+  for (c = 0; c < no_comps; ++c)
+    for (j = s->comp_ptr[c]; j < s->comp_ptr[c + 1]; ++j)
+      for (k = row_ptr[s->nodes[j]]; k < row_ptr[s->nodes[j] + 1]; ++k) {
+        t = s->comp[GRAPH_ID(col_ind, index_width, k)];
+        if (t != c && level[t] < level[c] + 1) {
+          level[t] = level[c] + 1;
+          if (level[t] + 1 > s->no_levels)
+            s->no_levels = level[t] + 1;
+        }
+      }
+
+  /* Renumbering by level, topological order within a level */
+  s->level_ptr = (int *)calloc(s->no_levels + 1, sizeof(int));
+  if (s->level_ptr == NULL) {
+    free(level);
+    free(rank);
+    free(count);
+    scc_free(s);
+    return EXIT_FAILURE;
+  }
+  for (c = 0; c < no_comps; ++c)
+    ++s->level_ptr[level[c] + 1];
+  for (l = 0; l < s->no_levels; ++l)
+    s->level_ptr[l + 1] += s->level_ptr[l];
+  memcpy(count, s->level_ptr, sizeof(int) * s->no_levels);
+  for (c = 0; c < no_comps; ++c)
+    rank[c] = count[level[c]]++;
+  memset(count, 0, sizeof(int) * (no_comps + 2));
+  for (i = 0; i < no_nodes; ++i) {
+    s->comp[i] = rank[s->comp[i]];
+    ++count[s->comp[i] + 1];
+  }
+  for (c = 0; c < no_comps; ++c) {
+    count[c + 1] += count[c];
+    s->no_singletons += count[c + 1] - count[c] == 1;
+    if (count[c + 1] - count[c] > s->max_size)
+      s->max_size = count[c + 1] - count[c];
+  }
+  memcpy(s->comp_ptr, count, sizeof(int) * (no_comps + 1));
+  for (i = 0; i < no_nodes; ++i)
+    s->nodes[count[s->comp[i]]++] = i;
+
+  free(level);
+  free(rank);
+  free(count);
+  return EXIT_SUCCESS;
+}
+
+void scc_free(Scc *s) {
+  free(s->comp);
+  free(s->comp_ptr);
+  free(s->nodes);
+  free(s->level_ptr);
+  s->comp = NULL;
+  s->comp_ptr = NULL;
+  s->nodes = NULL;
+  s->level_ptr = NULL;
+}
@@ -0,0 +1,27 @@
+#ifndef SCC_H
+#define SCC_H
+
+/* Strongly connected components of a graph and the levels of its
+ * condensation: a component is on level 0 if no edge enters it from another
+ * component, else on the level after the highest of those components.
+ * Components are numbered by level, so every edge between two components
+ * goes from a lower number to a higher one, and the components of a level
+ * do not depend on each other. */
+typedef struct {
+  int no_comps;
+  int no_levels;
+  int no_singletons; /* components of a single node */
+  int max_size;
+  int *comp;      /* component of every node */
+  int *comp_ptr;  /* no_comps + 1 offsets into nodes */
+  int *nodes;     /* the nodes of every component */
+  int *level_ptr; /* no_levels + 1 offsets into the components */
+} Scc;
+
+/* Components of the graph whose row i of (row_ptr, col_ind) lists the
+ * targets of the edges of i, found with an iterative Tarjan search */
+int scc_compute(Scc *s, const long *row_ptr, const void *col_ind,
+                int index_width, int no_nodes);
+void scc_free(Scc *s);
+
+#endif
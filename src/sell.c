@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "sell.h"
+
+typedef struct {
+  int len;
+  int row;
+} Row_len;
+
+static int cmp_row_len(const void *a, const void *b) {
+  const Row_len *L = (const Row_len *)a;
+  const Row_len *R = (const Row_len *)b;
+
+  if (L->len != R->len)
+    return (L->len < R->len) - (R->len < L->len);
+  return (L->row > R->row) - (L->row < R->row);
+}
+
+int sell_build(SELL_matrix *m, const long *row_ptr, const void *col_ind,
+               int index_width, const double *val, int no_rows, int sigma) {
+  Row_len *order;
+  int no_lanes;
+  int i, j, k, w, r;
+  long off;
+
+  if (sigma < SELL_C)
+    sigma = SELL_C;
+  sigma = (sigma + SELL_C - 1) / SELL_C * SELL_C;
+
+  memset(m, 0, sizeof(SELL_matrix));
+  m->data.no_rows = no_rows;
+  m->data.no_chunks = (no_rows + SELL_C - 1) / SELL_C;
+  m->data.sigma = sigma;
+  m->data.index_width = index_width;
+  no_lanes = m->data.no_chunks * SELL_C;
+
+  /* Sorting rows by length inside each sigma window */
+  order = (Row_len *)malloc(sizeof(Row_len) * (no_rows > 0 ? no_rows : 1));
+  for (i = 0; i < no_rows; ++i) {
+    order[i].len = (int)(row_ptr[i + 1] - row_ptr[i]);
+    order[i].row = i;
+  }
+  for (w = 0; w < no_rows; w += sigma)
+    qsort(order + w, (no_rows - w < sigma) ? no_rows - w : sigma,
+          sizeof(Row_len), cmp_row_len);
+
+  m->perm = (int *)malloc(sizeof(int) * no_lanes);
+  m->row_len = (int *)malloc(sizeof(int) * no_lanes);
+  m->chunk_ptr = (long *)malloc(sizeof(long) * (m->data.no_chunks + 1));
+  for (i = 0; i < no_lanes; ++i) {
+    m->perm[i] = (i < no_rows) ? order[i].row : -1;
+    m->row_len[i] = (i < no_rows) ? order[i].len : 0;
+  }
+  free(order);
+
+  /* The first row of a chunk is the longest one */
+  m->chunk_ptr[0] = 0;
+  for (k = 0; k < m->data.no_chunks; ++k)
+    m->chunk_ptr[k + 1] = m->chunk_ptr[k] + SELL_C * m->row_len[k * SELL_C];
+  m->data.no_entries = m->chunk_ptr[m->data.no_chunks];
+
+  m->col_ind = calloc(m->data.no_entries + 1, index_width);
+  m->val = NULL;
+  if (val != NULL)
+    m->val = (double *)calloc(m->data.no_entries + 1, sizeof(double));
+  if (m->perm == NULL || m->row_len == NULL || m->chunk_ptr == NULL ||
+      m->col_ind == NULL || (val != NULL && m->val == NULL)) {
+    sell_free(m);
+    return EXIT_FAILURE;
+  }
+
+  /* Column-major packing inside each chunk */
+  for (k = 0; k < m->data.no_chunks; ++k) {
+    for (i = 0; i < SELL_C; ++i) {
+      r = m->perm[k * SELL_C + i];
+      if (r < 0)
+        break;
+      for (j = 0; j < m->row_len[k * SELL_C + i]; ++j) {
+        off = m->chunk_ptr[k] + (long)j * SELL_C + i;
+        memcpy((char *)m->col_ind + off * index_width,
+               (const char *)col_ind + (row_ptr[r] + j) * index_width,
+               index_width);
+        if (val != NULL)
+          m->val[off] = val[row_ptr[r] + j];
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int sell_write(const SELL_matrix *m, const char path[], const char source[]) {
+  Cache_writer cw;
+  int no_lanes = m->data.no_chunks * SELL_C;
+
+  if (cache_create(&cw, path, source, m->data.index_width, sizeof(long)) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  if (cache_add(&cw, "data", &m->data, sizeof(SELL_data)) == EXIT_FAILURE ||
+      cache_add(&cw, "chunk_ptr", m->chunk_ptr,
+                (m->data.no_chunks + 1) * sizeof(long)) == EXIT_FAILURE ||
+      cache_add(&cw, "row_len", m->row_len, no_lanes * sizeof(int)) ==
+          EXIT_FAILURE ||
+      cache_add(&cw, "perm", m->perm, no_lanes * sizeof(int)) ==
+          EXIT_FAILURE ||
+      cache_add(&cw, "col_ind", m->col_ind,
+                (m->data.no_entries + 1) * m->data.index_width) ==
+          EXIT_FAILURE ||
+      (m->val != NULL &&
+       cache_add(&cw, "val", m->val,
+                 (m->data.no_entries + 1) * sizeof(double)) == EXIT_FAILURE)) {
+    cache_abort(&cw);
+    return EXIT_FAILURE;
+  }
+  return cache_commit(&cw);
+}
+
+int sell_load(SELL_matrix *m, const char path[], const char source[],
+              int index_width, int has_val, int sigma) {
+  const SELL_data *data;
+  int no_lanes;
+
+  memset(m, 0, sizeof(SELL_matrix));
+  if (cache_open(&m->cache, path, source, index_width, sizeof(long)) !=
+      CACHE_OK)
+    return EXIT_FAILURE;
+  m->storage = SELL_MMAPPED;
+  if ((data = (const SELL_data *)cache_array(&m->cache, "data",
+                                            sizeof(SELL_data))) == NULL) {
+    sell_free(m);
+    return EXIT_FAILURE;
+  }
+  m->data = *data;
+
+  /* A layout built with a different window has to be rebuilt */
+  if (sigma < SELL_C)
+    sigma = SELL_C;
+  if (m->data.sigma != (sigma + SELL_C - 1) / SELL_C * SELL_C) {
+    sell_free(m);
+    return EXIT_FAILURE;
+  }
+
+  no_lanes = m->data.no_chunks * SELL_C;
+  m->chunk_ptr = (long *)cache_array(&m->cache, "chunk_ptr",
+                                     (m->data.no_chunks + 1) * sizeof(long));
+  m->row_len = (int *)cache_array(&m->cache, "row_len", no_lanes * sizeof(int));
+  m->perm = (int *)cache_array(&m->cache, "perm", no_lanes * sizeof(int));
+  m->col_ind = (void *)cache_array(&m->cache, "col_ind",
+                                   (m->data.no_entries + 1) * index_width);
+  if (has_val)
+    m->val = (double *)cache_array(&m->cache, "val",
+                                   (m->data.no_entries + 1) * sizeof(double));
+  if (m->chunk_ptr == NULL || m->row_len == NULL || m->perm == NULL ||
+      m->col_ind == NULL || (has_val && m->val == NULL)) {
+    sell_free(m);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int sell_open(SELL_matrix *m, const char path[], const char source[],
+              const long *row_ptr, const void *col_ind, int index_width,
+              const double *val, int no_rows, int sigma) {
+  int err;
+
+  if (sell_load(m, path, source, index_width, val != NULL, sigma) ==
+      EXIT_SUCCESS)
+    return EXIT_SUCCESS;
+  printf("Building SELL-%d-%d layout \"%s\"...\n", SELL_C, sigma, path);
+  err = (sell_build(m, row_ptr, col_ind, index_width, val, no_rows, sigma) ==
+         EXIT_FAILURE) ||
+        (sell_write(m, path, source) == EXIT_FAILURE);
+  sell_free(m);
+  if (err)
+    return EXIT_FAILURE;
+  return sell_load(m, path, source, index_width, val != NULL, sigma);
+}
+
+void sell_free(SELL_matrix *m) {
+  int no_lanes = m->data.no_chunks * SELL_C;
+
+  if (m->storage == SELL_PLACED) {
+    mem_free(m->chunk_ptr, (m->data.no_chunks + 1) * sizeof(long));
+    mem_free(m->row_len, no_lanes * sizeof(int));
+    mem_free(m->perm, no_lanes * sizeof(int));
+    mem_free(m->col_ind, (m->data.no_entries + 1) * m->data.index_width);
+    mem_free(m->val, (m->data.no_entries + 1) * sizeof(double));
+  } else if (m->storage == SELL_MMAPPED) {
+    cache_close(&m->cache);
+  } else {
+    free(m->chunk_ptr);
+    free(m->row_len);
+    free(m->perm);
+    free(m->col_ind);
+    free(m->val);
+  }
+  m->chunk_ptr = NULL;
+  m->row_len = NULL;
+  m->perm = NULL;
+  m->col_ind = NULL;
+  m->val = NULL;
+}
+
+/* Byte ranges of an array owned by each thread, scale bytes per unit: the
+ * units [units[t], ...) or, with ptr, [ptr[units[t]], ...) */
+static size_t *sell_bounds(const int *units, const long *ptr, int no_parts,
+                           size_t scale, size_t total) {
+  size_t *bounds = (size_t *)malloc(sizeof(size_t) * (no_parts + 1));
+  int t;
+
+  for (t = 0; t < no_parts; ++t)
+    bounds[t] = (ptr != NULL ? ptr[units[t]] : units[t]) * scale;
+  bounds[no_parts] = total;
+  return bounds;
+}
+
+int sell_place(SELL_matrix *m, Team *team, const int *chunk_bounds, int place,
+               int pages) {
+  SELL_matrix placed;
+  int no_parts = team_size(team);
+  int no_lanes = m->data.no_chunks * SELL_C;
+  size_t *bounds;
+
+  placed = *m;
+  placed.storage = SELL_PLACED;
+  bounds = sell_bounds(chunk_bounds, NULL, no_parts, sizeof(long),
+                       (m->data.no_chunks + 1) * sizeof(long));
+  placed.chunk_ptr = (long *)mem_place(team, m->chunk_ptr, bounds[no_parts],
+                                       bounds, place, pages);
+  free(bounds);
+  bounds = sell_bounds(chunk_bounds, NULL, no_parts, SELL_C * sizeof(int),
+                       no_lanes * sizeof(int));
+  placed.row_len = (int *)mem_place(team, m->row_len, bounds[no_parts],
+                                    bounds, place, pages);
+  placed.perm =
+      (int *)mem_place(team, m->perm, bounds[no_parts], bounds, place, pages);
+  free(bounds);
+  bounds = sell_bounds(chunk_bounds, m->chunk_ptr, no_parts,
+                       m->data.index_width,
+                       (m->data.no_entries + 1) * m->data.index_width);
+  placed.col_ind =
+      mem_place(team, m->col_ind, bounds[no_parts], bounds, place, pages);
+  free(bounds);
+  placed.val = NULL;
+  if (m->val != NULL) {
+    bounds = sell_bounds(chunk_bounds, m->chunk_ptr, no_parts, sizeof(double),
+                         (m->data.no_entries + 1) * sizeof(double));
+    placed.val = (double *)mem_place(team, m->val, bounds[no_parts], bounds,
+                                     place, pages);
+    free(bounds);
+  }
+
+  if (placed.chunk_ptr == NULL || placed.row_len == NULL ||
+      placed.perm == NULL || placed.col_ind == NULL ||
+      (m->val != NULL && placed.val == NULL)) {
+    sell_free(&placed);
+    return EXIT_FAILURE;
+  }
+  sell_free(m);
+  *m = placed;
+  return EXIT_SUCCESS;
+}
+
+double sell_bytes(const SELL_matrix *m, int has_val) {
+  double no_lanes = (double)m->data.no_chunks * SELL_C;
+
+  /* chunk_ptr + row_len + perm + col_ind + gathered x + y (+ val) */
+  return (m->data.no_chunks + 1.) * sizeof(long) +
+         2. * no_lanes * sizeof(int) +
+         (double)m->data.no_entries * (m->data.index_width + sizeof(double)) +
+         (double)m->data.no_rows * sizeof(double) +
+         (has_val ? (double)m->data.no_entries * sizeof(double) : 0.);
+}
+
+double sell_fill(const SELL_matrix *m, long no_edges) {
+  return no_edges > 0 ? (double)m->data.no_entries / (double)no_edges : 1.;
+}
@@ -0,0 +1,61 @@
+#ifndef SELL_H
+#define SELL_H
+
+/* SELL-C-sigma (sliced ELLPACK) layout: rows are sorted by decreasing length
+ * within windows of sigma rows and packed in chunks of SELL_C rows, stored
+ * column-major inside each chunk so that one column of a chunk fills one
+ * vector register. Padding entries have col_ind 0 and val 0. */
+#define SELL_C 8
+#define SELL_SIGMA 1024
+
+#include "cache.h"
+#include "team.h"
+
+/* Storage of the SELL arrays */
+#define SELL_MALLOC 0
+#define SELL_MMAPPED 1
+#define SELL_PLACED 2
+
+/* Data for compression */
+typedef struct {
+  int no_rows;
+  int no_chunks;
+  int sigma;
+  int index_width; /* bytes of the col_ind entries */
+  long no_entries;
+} SELL_data;
+
+typedef struct {
+  SELL_data data;
+  long *chunk_ptr; /* no_chunks + 1 offsets into col_ind/val */
+  int *row_len;    /* no_chunks * SELL_C row lengths, sorted order */
+  int *perm;       /* no_chunks * SELL_C original row ids, -1 for padding */
+  void *col_ind;   /* no_entries node ids of index_width bytes */
+  double *val;     /* no_entries, NULL for pattern matrices */
+  int storage;
+  Cache cache; /* mapping of the arrays if SELL_MMAPPED */
+} SELL_matrix;
+
+int sell_build(SELL_matrix *m, const long *row_ptr, const void *col_ind,
+               int index_width, const double *val, int no_rows, int sigma);
+/* Cache container of the layout, rebuilt when stale or built with another
+ * sigma */
+int sell_write(const SELL_matrix *m, const char path[], const char source[]);
+int sell_load(SELL_matrix *m, const char path[], const char source[],
+              int index_width, int has_val, int sigma);
+/* Loads the layout, building and writing it first if needed */
+int sell_open(SELL_matrix *m, const char path[], const char source[],
+              const long *row_ptr, const void *col_ind, int index_width,
+              const double *val, int no_rows, int sigma);
+void sell_free(SELL_matrix *m);
+
+/* Replaces the arrays with copies placed as in mem_place(), thread t owning
+ * chunks [chunk_bounds[t], chunk_bounds[t + 1]) */
+int sell_place(SELL_matrix *m, Team *team, const int *chunk_bounds, int place,
+               int pages);
+
+/* Memory traffic of a single SpMV and padding overhead */
+double sell_bytes(const SELL_matrix *m, int has_val);
+double sell_fill(const SELL_matrix *m, long no_edges);
+
+#endif
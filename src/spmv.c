@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spmv.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPMV_X86
+#include <immintrin.h>
+#endif
+
+/* Kernels are generated from spmv_kernels.h for every width of the node
+ * ids, so that the index conversion is resolved at compile time */
+#define SPMV_CAT2(a, b) a##_##b
+#define SPMV_CAT(a, b) SPMV_CAT2(a, b)
+#define SPMV_FN(name) SPMV_CAT(name, SPMV_BITS)
+
+#ifdef SPMV_X86
+
+__attribute__((target("avx2"))) static double hsum_avx2(__m256d v) {
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+  lo = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+/* Row remainder of 16-bit ids: a masked load of 16-bit lanes would need
+ * AVX-512BW, and an unmasked one could read past the end of col_ind */
+__attribute__((target("avx512f,avx512vl"))) static __m256i
+maskload8_u16(__mmask8 m, const unsigned short *p) {
+  int idx[8];
+  int i;
+
+  for (i = 0; i < 8; ++i)
+    idx[i] = (m >> i & 1) ? p[i] : 0;
+  return _mm256_loadu_si256((const __m256i *)idx);
+}
+
+#endif
+
+/* 32-bit node ids */
+#define SPMV_BITS 32
+#define SPMV_INDEX int
+#define SPMV_LOAD4(p) _mm_loadu_si128((const __m128i *)(p))
+#define SPMV_LOAD8(p) _mm256_loadu_si256((const __m256i *)(p))
+#define SPMV_MASKLOAD8(m, p) _mm256_maskz_loadu_epi32(m, p)
+#include "spmv_kernels.h"
+#undef SPMV_BITS
+#undef SPMV_INDEX
+#undef SPMV_LOAD4
+#undef SPMV_LOAD8
+#undef SPMV_MASKLOAD8
+
+/* 16-bit node ids, zero-extended to 32-bit lanes */
+#define SPMV_BITS 16
+#define SPMV_INDEX unsigned short
+#define SPMV_LOAD4(p) _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#define SPMV_LOAD8(p)                                                          \
+  _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#define SPMV_MASKLOAD8(m, p) maskload8_u16(m, p)
+#include "spmv_kernels.h"
+#undef SPMV_BITS
+#undef SPMV_INDEX
+#undef SPMV_LOAD4
+#undef SPMV_LOAD8
+#undef SPMV_MASKLOAD8
+
+static const int no_kernels = sizeof(kernels_32) / sizeof(kernels_32[0]);
+
+static int spmv_supported(const SpMV_kernel *k) {
+#ifdef SPMV_X86
+  __builtin_cpu_init();
+  if (strcmp(k->name, "avx512") == 0)
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vl");
+  if (strcmp(k->name, "avx2") == 0)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+  return 1;
+}
+
+const SpMV_kernel *spmv_select(const char *name, int index_width) {
+  const SpMV_kernel *kernels;
+  int i;
+
+  if (index_width == 2)
+    kernels = kernels_16;
+  else if (index_width == 4)
+    kernels = kernels_32;
+  else
+    return NULL;
+  for (i = 0; i < no_kernels; ++i) {
+    if (name != NULL && strcmp(name, "auto") != 0 &&
+        strcmp(name, kernels[i].name) != 0)
+      continue;
+    if (spmv_supported(kernels + i))
+      return kernels + i;
+    if (name != NULL && strcmp(name, "auto") != 0)
+      return NULL;
+  }
+  return NULL;
+}
+
+void spmv_list(FILE *pf) {
+  int i;
+
+  for (i = 0; i < no_kernels; ++i)
+    fprintf(pf, "%s%s", i ? ", " : "", kernels_32[i].name);
+}
+
+double spmv_bytes(int no_nodes, long no_edges, int index_width, int has_val) {
+  /* row_ptr + col_ind + gathered x + y (+ val) */
+  return (no_nodes + 1.) * sizeof(long) + (double)no_edges * index_width +
+         (double)no_edges * sizeof(double) + (double)no_nodes * sizeof(double) +
+         (has_val ? (double)no_edges * sizeof(double) : 0.);
+}
+
+double spmv_flops(long no_edges, int has_val) {
+  return (has_val ? 2. : 1.) * no_edges;
+}
@@ -0,0 +1,48 @@
+#ifndef SPMV_H
+#define SPMV_H
+
+#include <stdio.h>
+
+#include "sell.h"
+
+/* Row-range SpMV kernels over a CSR matrix, rows [lo, hi):
+ *   val:     y[r] = base + sum_c x[col_ind[c]] * val[c]
+ *   pattern: y[r] = sum_c x[col_ind[c]]
+ *   pattern2: the pattern products of x into y and of w into z, from a
+ *             single pass over the ids
+ * col_ind holds node ids of the width the kernel was selected for */
+typedef void (*spmv_val_fn)(const long *row_ptr, const void *col_ind,
+                            const double *val, const double *x, double *y,
+                            int lo, int hi, double base);
+typedef void (*spmv_pattern_fn)(const long *row_ptr, const void *col_ind,
+                                const double *x, double *y, int lo, int hi);
+typedef void (*spmv_pattern2_fn)(const long *row_ptr, const void *col_ind,
+                                 const double *x, const double *w, double *y,
+                                 double *z, int lo, int hi);
+
+/* Chunk-range SpMV kernels over a SELL-C-sigma matrix, chunks [lo, hi) */
+typedef void (*sell_val_fn)(const SELL_matrix *m, const double *x, double *y,
+                            int lo, int hi, double base);
+typedef void (*sell_pattern_fn)(const SELL_matrix *m, const double *x,
+                                double *y, int lo, int hi);
+
+typedef struct {
+  const char *name;
+  spmv_val_fn val;
+  spmv_pattern_fn pattern;
+  sell_val_fn sell_val;
+  sell_pattern_fn sell_pattern;
+  spmv_pattern2_fn pattern2;
+} SpMV_kernel;
+
+/* Returns the kernel called name, or the best one supported by the CPU when
+ * name is NULL or "auto", specialized for node ids of index_width bytes (2 or
+ * 4). Returns NULL if the kernel is unknown/unsupported */
+const SpMV_kernel *spmv_select(const char *name, int index_width);
+void spmv_list(FILE *pf);
+
+/* Memory traffic and floating point operations of a single SpMV */
+double spmv_bytes(int no_nodes, long no_edges, int index_width, int has_val);
+double spmv_flops(long no_edges, int has_val);
+
+#endif
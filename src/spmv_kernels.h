@@ -0,0 +1,507 @@
+/* SpMV kernels for one width of the node ids, included by spmv.c once per
+ * width (no include guard). The including file defines:
+ *   SPMV_BITS            suffix of the generated names (e.g. 32)
+ *   SPMV_INDEX           type of the col_ind entries
+ *   SPMV_LOAD4(p)        4 ids at p as a __m128i of 32-bit lanes
+ *   SPMV_LOAD8(p)        8 ids at p as a __m256i of 32-bit lanes
+ *   SPMV_MASKLOAD8(m, p) the ids at p selected by the mask m, others 0
+ * and gets the kernel table SPMV_FN(kernels), best first. */
+
+/* Scalar kernels */
+
+static void SPMV_FN(spmv_val_scalar)(const long *row_ptr, const void *ind,
+                                     const double *val, const double *x,
+                                     double *y, int lo, int hi, double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci;
+  int ri;
+  double sum;
+
+  for (ri = lo; ri < hi; ++ri) {
+    sum = base;
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
+      sum += x[col_ind[ci]] * val[ci];
+    y[ri] = sum;
+  }
+}
+
+static void SPMV_FN(spmv_pattern_scalar)(const long *row_ptr, const void *ind,
+                                         const double *x, double *y, int lo,
+                                         int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci;
+  int ri;
+  double sum;
+
+  for (ri = lo; ri < hi; ++ri) {
+    sum = 0.;
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
+      sum += x[col_ind[ci]];
+    y[ri] = sum;
+  }
+}
+
+static void SPMV_FN(spmv_pattern2_scalar)(const long *row_ptr,
+                                          const void *ind, const double *x,
+                                          const double *w, double *y,
+                                          double *z, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci;
+  int ri;
+  double sum_x, sum_w;
+
+  for (ri = lo; ri < hi; ++ri) {
+    sum_x = sum_w = 0.;
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
+      sum_x += x[col_ind[ci]];
+      sum_w += w[col_ind[ci]];
+    }
+    y[ri] = sum_x;
+    z[ri] = sum_w;
+  }
+}
+
+static void SPMV_FN(sell_val_scalar)(const SELL_matrix *m, const double *x,
+                                     double *y, int lo, int hi, double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, i, j, w;
+  double acc[SELL_C];
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    for (i = 0; i < SELL_C; ++i)
+      acc[i] = base;
+    for (j = 0; j < w; ++j, off += SELL_C)
+      for (i = 0; i < SELL_C; ++i)
+        acc[i] += x[col_ind[off + i]] * m->val[off + i];
+    for (i = 0; i < SELL_C && m->perm[k * SELL_C + i] >= 0; ++i)
+      y[m->perm[k * SELL_C + i]] = acc[i];
+  }
+}
+
+static void SPMV_FN(sell_pattern_scalar)(const SELL_matrix *m, const double *x,
+                                         double *y, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, i, j, w;
+  const int *len;
+  double acc[SELL_C];
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    len = m->row_len + k * SELL_C;
+    for (i = 0; i < SELL_C; ++i)
+      acc[i] = 0.;
+    for (j = 0; j < w; ++j, off += SELL_C)
+      for (i = 0; i < SELL_C; ++i)
+        if (j < len[i])
+          acc[i] += x[col_ind[off + i]];
+    for (i = 0; i < SELL_C && m->perm[k * SELL_C + i] >= 0; ++i)
+      y[m->perm[k * SELL_C + i]] = acc[i];
+  }
+}
+
+#ifdef SPMV_X86
+
+/* AVX2 kernels: rows shorter than a vector stay scalar, longer rows are
+ * gathered 4 columns at a time and unrolled by two vectors */
+
+__attribute__((target("avx2,fma"))) static void
+SPMV_FN(spmv_val_avx2)(const long *row_ptr, const void *ind, const double *val,
+                       const double *x, double *y, int lo, int hi,
+                       double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  double sum;
+  __m256d acc0, acc1;
+  __m128i idx0, idx1;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    sum = base;
+    if (end - ci >= 4) {
+      acc0 = _mm256_setzero_pd();
+      acc1 = _mm256_setzero_pd();
+      for (; ci + 8 <= end; ci += 8) {
+        idx0 = SPMV_LOAD4(col_ind + ci);
+        idx1 = SPMV_LOAD4(col_ind + ci + 4);
+        acc0 = _mm256_fmadd_pd(_mm256_i32gather_pd(x, idx0, 8),
+                               _mm256_loadu_pd(val + ci), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_i32gather_pd(x, idx1, 8),
+                               _mm256_loadu_pd(val + ci + 4), acc1);
+      }
+      if (ci + 4 <= end) {
+        idx0 = SPMV_LOAD4(col_ind + ci);
+        acc0 = _mm256_fmadd_pd(_mm256_i32gather_pd(x, idx0, 8),
+                               _mm256_loadu_pd(val + ci), acc0);
+        ci += 4;
+      }
+      sum += hsum_avx2(_mm256_add_pd(acc0, acc1));
+    }
+    for (; ci < end; ++ci)
+      sum += x[col_ind[ci]] * val[ci];
+    y[ri] = sum;
+  }
+}
+
+__attribute__((target("avx2"))) static void
+SPMV_FN(spmv_pattern_avx2)(const long *row_ptr, const void *ind,
+                           const double *x, double *y, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  double sum;
+  __m256d acc0, acc1;
+  __m128i idx0, idx1;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    sum = 0.;
+    if (end - ci >= 4) {
+      acc0 = _mm256_setzero_pd();
+      acc1 = _mm256_setzero_pd();
+      for (; ci + 8 <= end; ci += 8) {
+        idx0 = SPMV_LOAD4(col_ind + ci);
+        idx1 = SPMV_LOAD4(col_ind + ci + 4);
+        acc0 = _mm256_add_pd(_mm256_i32gather_pd(x, idx0, 8), acc0);
+        acc1 = _mm256_add_pd(_mm256_i32gather_pd(x, idx1, 8), acc1);
+      }
+      if (ci + 4 <= end) {
+        idx0 = SPMV_LOAD4(col_ind + ci);
+        acc0 = _mm256_add_pd(_mm256_i32gather_pd(x, idx0, 8), acc0);
+        ci += 4;
+      }
+      sum += hsum_avx2(_mm256_add_pd(acc0, acc1));
+    }
+    for (; ci < end; ++ci)
+      sum += x[col_ind[ci]];
+    y[ri] = sum;
+  }
+}
+
+__attribute__((target("avx2"))) static void
+SPMV_FN(spmv_pattern2_avx2)(const long *row_ptr, const void *ind,
+                            const double *x, const double *w, double *y,
+                            double *z, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  double sum_x, sum_w;
+  __m256d acc_x, acc_w;
+  __m128i idx;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    sum_x = sum_w = 0.;
+    if (end - ci >= 4) {
+      acc_x = _mm256_setzero_pd();
+      acc_w = _mm256_setzero_pd();
+      for (; ci + 4 <= end; ci += 4) {
+        idx = SPMV_LOAD4(col_ind + ci);
+        acc_x = _mm256_add_pd(_mm256_i32gather_pd(x, idx, 8), acc_x);
+        acc_w = _mm256_add_pd(_mm256_i32gather_pd(w, idx, 8), acc_w);
+      }
+      sum_x += hsum_avx2(acc_x);
+      sum_w += hsum_avx2(acc_w);
+    }
+    for (; ci < end; ++ci) {
+      sum_x += x[col_ind[ci]];
+      sum_w += w[col_ind[ci]];
+    }
+    y[ri] = sum_x;
+    z[ri] = sum_w;
+  }
+}
+
+/* AVX2 SELL kernels: one chunk column is two 4-lane gathers; the lanes past
+ * the end of the shortest row of the chunk are masked out */
+
+__attribute__((target("avx2,fma"))) static void
+SPMV_FN(sell_val_avx2)(const SELL_matrix *m, const double *x, double *y,
+                       int lo, int hi, double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, i, j, w;
+  __m256d acc0, acc1;
+  __m128i idx0, idx1;
+  double acc[SELL_C];
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    acc0 = _mm256_set1_pd(base);
+    acc1 = _mm256_set1_pd(base);
+    for (j = 0; j < w; ++j, off += SELL_C) {
+      idx0 = SPMV_LOAD4(col_ind + off);
+      idx1 = SPMV_LOAD4(col_ind + off + 4);
+      acc0 = _mm256_fmadd_pd(_mm256_i32gather_pd(x, idx0, 8),
+                             _mm256_loadu_pd(m->val + off), acc0);
+      acc1 = _mm256_fmadd_pd(_mm256_i32gather_pd(x, idx1, 8),
+                             _mm256_loadu_pd(m->val + off + 4), acc1);
+    }
+    _mm256_storeu_pd(acc, acc0);
+    _mm256_storeu_pd(acc + 4, acc1);
+    for (i = 0; i < SELL_C && m->perm[k * SELL_C + i] >= 0; ++i)
+      y[m->perm[k * SELL_C + i]] = acc[i];
+  }
+}
+
+__attribute__((target("avx2"))) static void
+SPMV_FN(sell_pattern_avx2)(const SELL_matrix *m, const double *x, double *y,
+                           int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, i, j, w, min_len;
+  __m256d acc0, acc1, mask0, mask1;
+  __m128i idx0, idx1, len0, len1, jv;
+  double acc[SELL_C];
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    min_len = m->row_len[k * SELL_C + SELL_C - 1];
+    len0 = _mm_loadu_si128((const __m128i *)(m->row_len + k * SELL_C));
+    len1 = _mm_loadu_si128((const __m128i *)(m->row_len + k * SELL_C + 4));
+    acc0 = _mm256_setzero_pd();
+    acc1 = _mm256_setzero_pd();
+    for (j = 0; j < min_len; ++j, off += SELL_C) {
+      idx0 = SPMV_LOAD4(col_ind + off);
+      idx1 = SPMV_LOAD4(col_ind + off + 4);
+      acc0 = _mm256_add_pd(_mm256_i32gather_pd(x, idx0, 8), acc0);
+      acc1 = _mm256_add_pd(_mm256_i32gather_pd(x, idx1, 8), acc1);
+    }
+    for (; j < w; ++j, off += SELL_C) {
+      jv = _mm_set1_epi32(j);
+      mask0 = _mm256_castsi256_pd(
+          _mm256_cvtepi32_epi64(_mm_cmpgt_epi32(len0, jv)));
+      mask1 = _mm256_castsi256_pd(
+          _mm256_cvtepi32_epi64(_mm_cmpgt_epi32(len1, jv)));
+      idx0 = SPMV_LOAD4(col_ind + off);
+      idx1 = SPMV_LOAD4(col_ind + off + 4);
+      acc0 = _mm256_add_pd(
+          _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, idx0, mask0, 8),
+          acc0);
+      acc1 = _mm256_add_pd(
+          _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, idx1, mask1, 8),
+          acc1);
+    }
+    _mm256_storeu_pd(acc, acc0);
+    _mm256_storeu_pd(acc + 4, acc1);
+    for (i = 0; i < SELL_C && m->perm[k * SELL_C + i] >= 0; ++i)
+      y[m->perm[k * SELL_C + i]] = acc[i];
+  }
+}
+
+/* AVX-512 kernels: 8 columns per gather, unrolled by two vectors, and the
+ * row remainder handled by a single masked gather instead of a scalar tail */
+
+__attribute__((target("avx512f,avx512vl"))) static void
+SPMV_FN(spmv_val_avx512)(const long *row_ptr, const void *ind,
+                         const double *val, const double *x, double *y, int lo,
+                         int hi, double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  double sum;
+  __m512d acc0, acc1;
+  __m256i idx0, idx1;
+  __mmask8 m;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    sum = base;
+    if (end - ci == 1) {
+      y[ri] = sum + x[col_ind[ci]] * val[ci];
+      continue;
+    }
+    acc0 = _mm512_setzero_pd();
+    acc1 = _mm512_setzero_pd();
+    for (; ci + 16 <= end; ci += 16) {
+      idx0 = SPMV_LOAD8(col_ind + ci);
+      idx1 = SPMV_LOAD8(col_ind + ci + 8);
+      acc0 = _mm512_fmadd_pd(_mm512_i32gather_pd(idx0, x, 8),
+                             _mm512_loadu_pd(val + ci), acc0);
+      acc1 = _mm512_fmadd_pd(_mm512_i32gather_pd(idx1, x, 8),
+                             _mm512_loadu_pd(val + ci + 8), acc1);
+    }
+    if (ci + 8 <= end) {
+      idx0 = SPMV_LOAD8(col_ind + ci);
+      acc0 = _mm512_fmadd_pd(_mm512_i32gather_pd(idx0, x, 8),
+                             _mm512_loadu_pd(val + ci), acc0);
+      ci += 8;
+    }
+    if (ci < end) {
+      m = (__mmask8)((1u << (end - ci)) - 1);
+      idx1 = SPMV_MASKLOAD8(m, col_ind + ci);
+      acc1 = _mm512_fmadd_pd(
+          _mm512_mask_i32gather_pd(_mm512_setzero_pd(), m, idx1, x, 8),
+          _mm512_maskz_loadu_pd(m, val + ci), acc1);
+    }
+    y[ri] = sum + _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+  }
+}
+
+__attribute__((target("avx512f,avx512vl"))) static void
+SPMV_FN(spmv_pattern_avx512)(const long *row_ptr, const void *ind,
+                             const double *x, double *y, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  __m512d acc0, acc1;
+  __m256i idx0, idx1;
+  __mmask8 m;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    if (end - ci <= 1) {
+      y[ri] = (ci < end) ? x[col_ind[ci]] : 0.;
+      continue;
+    }
+    acc0 = _mm512_setzero_pd();
+    acc1 = _mm512_setzero_pd();
+    for (; ci + 16 <= end; ci += 16) {
+      idx0 = SPMV_LOAD8(col_ind + ci);
+      idx1 = SPMV_LOAD8(col_ind + ci + 8);
+      acc0 = _mm512_add_pd(_mm512_i32gather_pd(idx0, x, 8), acc0);
+      acc1 = _mm512_add_pd(_mm512_i32gather_pd(idx1, x, 8), acc1);
+    }
+    if (ci + 8 <= end) {
+      idx0 = SPMV_LOAD8(col_ind + ci);
+      acc0 = _mm512_add_pd(_mm512_i32gather_pd(idx0, x, 8), acc0);
+      ci += 8;
+    }
+    if (ci < end) {
+      m = (__mmask8)((1u << (end - ci)) - 1);
+      idx1 = SPMV_MASKLOAD8(m, col_ind + ci);
+      acc1 = _mm512_add_pd(
+          _mm512_mask_i32gather_pd(_mm512_setzero_pd(), m, idx1, x, 8), acc1);
+    }
+    y[ri] = _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+  }
+}
+
+__attribute__((target("avx512f,avx512vl"))) static void
+SPMV_FN(spmv_pattern2_avx512)(const long *row_ptr, const void *ind,
+                              const double *x, const double *w, double *y,
+                              double *z, int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)ind;
+  long ci, end;
+  int ri;
+  __m512d acc_x, acc_w;
+  __m256i idx;
+  __mmask8 m;
+
+  for (ri = lo; ri < hi; ++ri) {
+    ci = row_ptr[ri];
+    end = row_ptr[ri + 1];
+    if (end - ci <= 1) {
+      y[ri] = (ci < end) ? x[col_ind[ci]] : 0.;
+      z[ri] = (ci < end) ? w[col_ind[ci]] : 0.;
+      continue;
+    }
+    acc_x = _mm512_setzero_pd();
+    acc_w = _mm512_setzero_pd();
+    for (; ci + 8 <= end; ci += 8) {
+      idx = SPMV_LOAD8(col_ind + ci);
+      acc_x = _mm512_add_pd(_mm512_i32gather_pd(idx, x, 8), acc_x);
+      acc_w = _mm512_add_pd(_mm512_i32gather_pd(idx, w, 8), acc_w);
+    }
+    if (ci < end) {
+      m = (__mmask8)((1u << (end - ci)) - 1);
+      idx = SPMV_MASKLOAD8(m, col_ind + ci);
+      acc_x = _mm512_add_pd(
+          _mm512_mask_i32gather_pd(_mm512_setzero_pd(), m, idx, x, 8), acc_x);
+      acc_w = _mm512_add_pd(
+          _mm512_mask_i32gather_pd(_mm512_setzero_pd(), m, idx, w, 8), acc_w);
+    }
+    y[ri] = _mm512_reduce_add_pd(acc_x);
+    z[ri] = _mm512_reduce_add_pd(acc_w);
+  }
+}
+
+/* AVX-512 SELL kernels: one chunk column is a single 8-lane gather and the
+ * results are scattered back through the row permutation. Chunk columns are
+ * always complete (padding has id 0), so ids are loaded unmasked */
+
+__attribute__((target("avx512f,avx512vl"))) static void
+SPMV_FN(sell_val_avx512)(const SELL_matrix *m, const double *x, double *y,
+                         int lo, int hi, double base) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, j, w;
+  __m512d acc;
+  __m256i idx, perm;
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    acc = _mm512_set1_pd(base);
+    for (j = 0; j < w; ++j, off += SELL_C) {
+      idx = SPMV_LOAD8(col_ind + off);
+      acc = _mm512_fmadd_pd(_mm512_i32gather_pd(idx, x, 8),
+                            _mm512_loadu_pd(m->val + off), acc);
+    }
+    perm = _mm256_loadu_si256((const __m256i *)(m->perm + k * SELL_C));
+    _mm512_mask_i32scatter_pd(
+        y, _mm256_cmpge_epi32_mask(perm, _mm256_setzero_si256()), perm, acc,
+        8);
+  }
+}
+
+__attribute__((target("avx512f,avx512vl"))) static void
+SPMV_FN(sell_pattern_avx512)(const SELL_matrix *m, const double *x, double *y,
+                             int lo, int hi) {
+  const SPMV_INDEX *col_ind = (const SPMV_INDEX *)m->col_ind;
+  long off;
+  int k, j, w, min_len;
+  __m512d acc;
+  __m256i idx, perm, len;
+  __mmask8 mask;
+
+  for (k = lo; k < hi; ++k) {
+    off = m->chunk_ptr[k];
+    w = (int)((m->chunk_ptr[k + 1] - off) / SELL_C);
+    min_len = m->row_len[k * SELL_C + SELL_C - 1];
+    len = _mm256_loadu_si256((const __m256i *)(m->row_len + k * SELL_C));
+    acc = _mm512_setzero_pd();
+    for (j = 0; j < min_len; ++j, off += SELL_C) {
+      idx = SPMV_LOAD8(col_ind + off);
+      acc = _mm512_add_pd(_mm512_i32gather_pd(idx, x, 8), acc);
+    }
+    for (; j < w; ++j, off += SELL_C) {
+      mask = _mm256_cmpgt_epi32_mask(len, _mm256_set1_epi32(j));
+      idx = SPMV_LOAD8(col_ind + off);
+      acc = _mm512_add_pd(
+          _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, idx, x, 8), acc);
+    }
+    perm = _mm256_loadu_si256((const __m256i *)(m->perm + k * SELL_C));
+    _mm512_mask_i32scatter_pd(
+        y, _mm256_cmpge_epi32_mask(perm, _mm256_setzero_si256()), perm, acc,
+        8);
+  }
+}
+
+#endif
+
+/* Kernel table, best first */
+static const SpMV_kernel SPMV_FN(kernels)[] = {
+#ifdef SPMV_X86
+    {"avx512", SPMV_FN(spmv_val_avx512), SPMV_FN(spmv_pattern_avx512),
+     SPMV_FN(sell_val_avx512), SPMV_FN(sell_pattern_avx512),
+     SPMV_FN(spmv_pattern2_avx512)},
+    {"avx2", SPMV_FN(spmv_val_avx2), SPMV_FN(spmv_pattern_avx2),
+     SPMV_FN(sell_val_avx2), SPMV_FN(sell_pattern_avx2),
+     SPMV_FN(spmv_pattern2_avx2)},
+#endif
+    {"scalar", SPMV_FN(spmv_val_scalar), SPMV_FN(spmv_pattern_scalar),
+     SPMV_FN(sell_val_scalar), SPMV_FN(sell_pattern_scalar),
+     SPMV_FN(spmv_pattern2_scalar)}};
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "stream.h"
+
+int stream_build(Stream_graph *s, const long *row_ptr, const void *col_ind,
+                 int index_width, int no_nodes, int part_bits) {
+  long *pos;
+  long k;
+  int no_parts;
+  int i, j, p;
+
+  memset(s, 0, sizeof(Stream_graph));
+  no_parts = no_nodes > 0 ? ((no_nodes - 1) >> part_bits) + 1 : 1;
+  s->data.no_nodes = no_nodes;
+  s->data.no_parts = no_parts;
+  s->data.part_bits = part_bits;
+  s->data.no_edges = row_ptr[no_nodes];
+
+  s->edge_ptr = (long *)malloc(sizeof(long) * (no_parts + 1));
+  s->update_ptr = (long *)calloc(no_parts + 1, sizeof(long));
+  s->edges = (int *)malloc(sizeof(int) * (2 * s->data.no_edges + 1));
+  s->update_ind = (int *)malloc(sizeof(int) * (s->data.no_edges + 1));
+  pos = (long *)malloc(sizeof(long) * (no_parts + 1));
+  if (s->edge_ptr == NULL || s->update_ptr == NULL || s->edges == NULL ||
+      s->update_ind == NULL || pos == NULL) {
+    free(pos);
+    stream_free(s);
+    return EXIT_FAILURE;
+  }
+
+  /* The rows of a source partition are contiguous, so are its edges */
+  for (p = 0; p <= no_parts; ++p)
+    s->edge_ptr[p] = row_ptr[(long)p << part_bits < no_nodes
+                                 ? (long)p << part_bits
+                                 : no_nodes];
+  for (i = 0; i < no_nodes; ++i)
+    for (k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+      j = index_width == 2 ? ((const unsigned short *)col_ind)[k]
+                           : ((const int *)col_ind)[k];
+      s->edges[2 * k] = i;
+      s->edges[2 * k + 1] = j;
+      ++s->update_ptr[(j >> part_bits) + 1];
+    }
+  for (p = 0; p < no_parts; ++p)
+    s->update_ptr[p + 1] += s->update_ptr[p];
+
+  /* Targets of the updates, in the order the scatter appends them */
+  memcpy(pos, s->update_ptr, sizeof(long) * no_parts);
+  for (k = 0; k < s->data.no_edges; ++k) {
+    j = s->edges[2 * k + 1];
+    s->update_ind[pos[j >> part_bits]++] = j;
+  }
+  free(pos);
+  return EXIT_SUCCESS;
+}
+
+int stream_write(const Stream_graph *s, const char path[],
+                 const char source[]) {
+  Cache_writer cw;
+  int no_parts = s->data.no_parts;
+
+  if (cache_create(&cw, path, source, sizeof(int), sizeof(long)) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  if (cache_add(&cw, "data", &s->data, sizeof(Stream_data)) == EXIT_FAILURE ||
+      cache_add(&cw, "edge_ptr", s->edge_ptr,
+                (no_parts + 1) * sizeof(long)) == EXIT_FAILURE ||
+      cache_add(&cw, "edges", s->edges,
+                (2 * s->data.no_edges + 1) * sizeof(int)) == EXIT_FAILURE ||
+      cache_add(&cw, "update_ptr", s->update_ptr,
+                (no_parts + 1) * sizeof(long)) == EXIT_FAILURE ||
+      cache_add(&cw, "update_ind", s->update_ind,
+                (s->data.no_edges + 1) * sizeof(int)) == EXIT_FAILURE) {
+    cache_abort(&cw);
+    return EXIT_FAILURE;
+  }
+  return cache_commit(&cw);
+}
+
+int stream_load(Stream_graph *s, const char path[], const char source[],
+                int part_bits) {
+  const Stream_data *data;
+  int no_parts;
+
+  memset(s, 0, sizeof(Stream_graph));
+  if (cache_open(&s->cache, path, source, sizeof(int), sizeof(long)) !=
+      CACHE_OK)
+    return EXIT_FAILURE;
+  if ((data = (const Stream_data *)cache_array(&s->cache, "data",
+                                              sizeof(Stream_data))) == NULL ||
+      data->part_bits != part_bits) {
+    stream_free(s);
+    return EXIT_FAILURE;
+  }
+  s->data = *data;
+
+  no_parts = s->data.no_parts;
+  s->edge_ptr = (long *)cache_array(&s->cache, "edge_ptr",
+                                    (no_parts + 1) * sizeof(long));
+  s->edges = (int *)cache_array(&s->cache, "edges",
+                                (2 * s->data.no_edges + 1) * sizeof(int));
+  s->update_ptr = (long *)cache_array(&s->cache, "update_ptr",
+                                      (no_parts + 1) * sizeof(long));
+  s->update_ind = (int *)cache_array(&s->cache, "update_ind",
+                                     (s->data.no_edges + 1) * sizeof(int));
+  if (s->edge_ptr == NULL || s->edges == NULL || s->update_ptr == NULL ||
+      s->update_ind == NULL) {
+    stream_free(s);
+    return EXIT_FAILURE;
+  }
+
+  /* Read front to back at every iteration */
+  madvise(s->edges, (2 * s->data.no_edges + 1) * sizeof(int),
+          MADV_SEQUENTIAL);
+  madvise(s->update_ind, (s->data.no_edges + 1) * sizeof(int),
+          MADV_SEQUENTIAL);
+  return EXIT_SUCCESS;
+}
+
+int stream_open(Stream_graph *s, const char path[], const char source[],
+                const long *row_ptr, const void *col_ind, int index_width,
+                int no_nodes, int part_bits) {
+  int err;
+
+  if (stream_load(s, path, source, part_bits) == EXIT_SUCCESS)
+    return EXIT_SUCCESS;
+  printf("Building edge stream layout \"%s\"...\n", path);
+  err = (stream_build(s, row_ptr, col_ind, index_width, no_nodes,
+                      part_bits) == EXIT_FAILURE) ||
+        (stream_write(s, path, source) == EXIT_FAILURE);
+  stream_free(s);
+  if (err)
+    return EXIT_FAILURE;
+  return stream_load(s, path, source, part_bits);
+}
+
+void stream_free(Stream_graph *s) {
+  if (s->cache.base != NULL)
+    cache_close(&s->cache);
+  else {
+    free(s->edge_ptr);
+    free(s->edges);
+    free(s->update_ptr);
+    free(s->update_ind);
+  }
+  s->edge_ptr = NULL;
+  s->edges = NULL;
+  s->update_ptr = NULL;
+  s->update_ind = NULL;
+}
+
+long *stream_offsets(const Stream_graph *s, const int *part_bounds,
+                     int no_threads) {
+  int no_parts = s->data.no_parts, part_bits = s->data.part_bits;
+  long *offsets;
+  long k;
+  int t, p;
+
+  if ((offsets = (long *)calloc((long)no_threads * no_parts + 1,
+                                sizeof(long))) == NULL)
+    return NULL;
+
+  /* Updates of every thread for every target partition, then their prefix
+   * sums, partition by partition in thread order */
+  for (t = 0; t < no_threads; ++t)
+    for (k = s->edge_ptr[part_bounds[t]]; k < s->edge_ptr[part_bounds[t + 1]];
+         ++k)
+      ++offsets[(long)t * no_parts + (s->edges[2 * k + 1] >> part_bits)];
+  for (p = 0; p < no_parts; ++p) {
+    k = s->update_ptr[p];
+    for (t = 0; t < no_threads; ++t) {
+      k += offsets[(long)t * no_parts + p];
+      offsets[(long)t * no_parts + p] = k - offsets[(long)t * no_parts + p];
+    }
+  }
+  return offsets;
+}
+
+void stream_scatter(const Stream_graph *s, const double *x, double *updates,
+                    long *pos, int lo, int hi) {
+  const int *edges = s->edges;
+  int part_bits = s->data.part_bits;
+  long k;
+
+  for (k = s->edge_ptr[lo]; k < s->edge_ptr[hi]; ++k)
+    updates[pos[edges[2 * k + 1] >> part_bits]++] = x[edges[2 * k]];
+}
+
+void stream_gather(const Stream_graph *s, const double *updates, double *y,
+                   int lo, int hi) {
+  const int *update_ind = s->update_ind;
+  long first = (long)lo << s->data.part_bits;
+  long last = (long)hi << s->data.part_bits;
+  long k;
+
+  if (last > s->data.no_nodes)
+    last = s->data.no_nodes;
+  if (first < last)
+    memset(y + first, 0, sizeof(double) * (last - first));
+  for (k = s->update_ptr[lo]; k < s->update_ptr[hi]; ++k)
+    y[update_ind[k]] += updates[k];
+}
+
+double stream_bytes(const Stream_graph *s) {
+  double no_edges = (double)s->data.no_edges;
+
+  /* edges + updates written and read back + update_ind + x + y */
+  return no_edges * (2. * sizeof(int) + 2. * sizeof(double) + sizeof(int)) +
+         2. * s->data.no_nodes * sizeof(double);
+}
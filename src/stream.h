@@ -0,0 +1,66 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+/* Edge-centric (X-Stream) layout: the nodes are cut into streaming partitions
+ * of 2^part_bits nodes, small enough for their ranks to stay in cache, and the
+ * edges are stored as (source, target) pairs grouped by the partition of the
+ * source. An iteration streams the edges once, appending the contribution of
+ * every edge to the update buffer of the partition of its target (scatter),
+ * then streams the buffer of each partition, adding the contributions to its
+ * ranks (gather). Outside of one partition, memory is only read and written
+ * sequentially. The order of the updates never changes, so their targets are
+ * stored in the layout and an iteration only writes their values. */
+#define STREAM_PART_BITS 15
+
+#include "cache.h"
+
+typedef struct {
+  int no_nodes;
+  int no_parts;
+  int part_bits;
+  int pad;
+  long no_edges;
+} Stream_data;
+
+typedef struct {
+  Stream_data data;
+  long *edge_ptr;   /* no_parts + 1 offsets into edges, by source partition */
+  int *edges;       /* no_edges (source, target) pairs */
+  long *update_ptr; /* no_parts + 1 offsets into the updates, by target
+                       partition */
+  int *update_ind;  /* no_edges targets of the updates */
+  Cache cache;      /* mapping of the arrays once loaded */
+} Stream_graph;
+
+/* Layout of the matrix whose row i lists the targets of the edges of i */
+int stream_build(Stream_graph *s, const long *row_ptr, const void *col_ind,
+                 int index_width, int no_nodes, int part_bits);
+/* Cache container of the layout, rebuilt when stale or built with other
+ * partitions */
+int stream_write(const Stream_graph *s, const char path[],
+                 const char source[]);
+int stream_load(Stream_graph *s, const char path[], const char source[],
+                int part_bits);
+/* Loads the layout, building and writing it first if needed */
+int stream_open(Stream_graph *s, const char path[], const char source[],
+                const long *row_ptr, const void *col_ind, int index_width,
+                int no_nodes, int part_bits);
+void stream_free(Stream_graph *s);
+
+/* Offsets in the updates where the scatter of the source partitions
+ * [part_bounds[t], part_bounds[t + 1]) starts, no_parts for each thread t */
+long *stream_offsets(const Stream_graph *s, const int *part_bounds,
+                     int no_threads);
+/* Scatter of x over the edges of the source partitions [lo, hi), pos being
+ * the offsets of these partitions, advanced past their updates */
+void stream_scatter(const Stream_graph *s, const double *x, double *updates,
+                    long *pos, int lo, int hi);
+/* y of the nodes of the target partitions [lo, hi), the sums of their
+ * updates */
+void stream_gather(const Stream_graph *s, const double *updates, double *y,
+                   int lo, int hi);
+
+/* Memory traffic of an iteration */
+double stream_bytes(const Stream_graph *s);
+
+#endif
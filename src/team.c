@@ -0,0 +1,201 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "team.h"
+
+struct Team {
+  int no_threads;
+  int *cpus;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  team_fn fn;
+  void *arg;
+  unsigned long generation;
+  int running;
+  int quit;
+  cpu_set_t caller; /* affinity of the calling thread before thread 0 pins */
+  int pinned;
+};
+
+typedef struct {
+  Team *team;
+  int tid;
+} Team_worker;
+
+static void team_pin(int cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+static void *team_loop(void *arg) {
+  Team_worker *w = (Team_worker *)arg;
+  Team *team = w->team;
+  int tid = w->tid;
+  unsigned long seen = 0;
+
+  free(w);
+  if (team->cpus[tid] >= 0)
+    team_pin(team->cpus[tid]);
+  pthread_mutex_lock(&team->lock);
+  for (;;) {
+    while (team->generation == seen && !team->quit)
+      pthread_cond_wait(&team->start, &team->lock);
+    if (team->quit)
+      break;
+    seen = team->generation;
+    pthread_mutex_unlock(&team->lock);
+
+    team->fn(tid, team->arg);
+
+    pthread_mutex_lock(&team->lock);
+    if (--team->running == 0)
+      pthread_cond_signal(&team->done);
+  }
+  pthread_mutex_unlock(&team->lock);
+  return NULL;
+}
+
+Team *team_create(int no_threads, int pin) {
+  Team *team;
+  Team_worker *w;
+  cpu_set_t set;
+  int no_cpus, cpu;
+  int i;
+
+  if (no_threads < 1)
+    no_threads = 1;
+  if ((team = (Team *)calloc(1, sizeof(Team))) == NULL)
+    return NULL;
+  team->no_threads = no_threads;
+  team->cpus = (int *)malloc(sizeof(int) * no_threads);
+  team->threads = (pthread_t *)malloc(sizeof(pthread_t) * no_threads);
+  if (team->cpus == NULL || team->threads == NULL) {
+    free(team->cpus);
+    free(team->threads);
+    free(team);
+    return NULL;
+  }
+  pthread_mutex_init(&team->lock, NULL);
+  pthread_cond_init(&team->start, NULL);
+  pthread_cond_init(&team->done, NULL);
+
+  /* Thread i runs on the i-th CPU the process is allowed to use */
+  no_cpus = 0;
+  if (pin && sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0)
+    no_cpus = CPU_COUNT(&set);
+  for (i = 0, cpu = 0; i < no_threads; ++i) {
+    team->cpus[i] = -1;
+    if (no_cpus == 0)
+      continue;
+    while (!CPU_ISSET(cpu % CPU_SETSIZE, &set))
+      cpu = (cpu + 1) % CPU_SETSIZE;
+    team->cpus[i] = cpu;
+    cpu = (cpu + 1) % CPU_SETSIZE;
+  }
+
+  /* The caller runs as thread 0 until team_destroy() gives it back its own
+   * CPUs */
+  if (team->cpus[0] >= 0 &&
+      pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                             &team->caller) == 0) {
+    team->pinned = 1;
+    team_pin(team->cpus[0]);
+  }
+  for (i = 1; i < no_threads; ++i) {
+    if ((w = (Team_worker *)malloc(sizeof(Team_worker))) == NULL)
+      break;
+    w->team = team;
+    w->tid = i;
+    if (pthread_create(team->threads + i, NULL, team_loop, w) != 0) {
+      free(w);
+      break;
+    }
+  }
+  if (i < no_threads) {
+    /* Only the threads below i were started */
+    team->no_threads = i;
+    team_destroy(team);
+    return NULL;
+  }
+  return team;
+}
+
+void team_run(Team *team, team_fn fn, void *arg) {
+  if (team->no_threads == 1) {
+    fn(0, arg);
+    return;
+  }
+  pthread_mutex_lock(&team->lock);
+  team->fn = fn;
+  team->arg = arg;
+  team->running = team->no_threads - 1;
+  ++team->generation;
+  pthread_cond_broadcast(&team->start);
+  pthread_mutex_unlock(&team->lock);
+
+  fn(0, arg);
+
+  pthread_mutex_lock(&team->lock);
+  while (team->running > 0)
+    pthread_cond_wait(&team->done, &team->lock);
+  pthread_mutex_unlock(&team->lock);
+}
+
+void team_destroy(Team *team) {
+  int i;
+
+  pthread_mutex_lock(&team->lock);
+  team->quit = 1;
+  pthread_cond_broadcast(&team->start);
+  pthread_mutex_unlock(&team->lock);
+  for (i = 1; i < team->no_threads; ++i)
+    pthread_join(team->threads[i], NULL);
+  if (team->pinned)
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &team->caller);
+  pthread_mutex_destroy(&team->lock);
+  pthread_cond_destroy(&team->start);
+  pthread_cond_destroy(&team->done);
+  free(team->cpus);
+  free(team->threads);
+  free(team);
+}
+
+int team_size(const Team *team) { return team->no_threads; }
+
+int team_cpu(const Team *team, int tid) { return team->cpus[tid]; }
+
+void team_partition(const long *ptr, int n, int no_parts, int align,
+                    int *bounds) {
+  double total = (double)(ptr[n] - ptr[0]) + n;
+  double target;
+  int lo, hi, mid;
+  int t;
+
+  bounds[0] = 0;
+  for (t = 1; t < no_parts; ++t) {
+    /* First item whose prefix weight reaches t / no_parts of the total */
+    target = total * t / no_parts;
+    lo = bounds[t - 1];
+    hi = n;
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if ((double)(ptr[mid] - ptr[0]) + mid < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    lo = (lo + align / 2) / align * align;
+    if (lo < bounds[t - 1])
+      lo = bounds[t - 1];
+    bounds[t] = lo < n ? lo : n;
+  }
+  bounds[no_parts] = n;
+}
@@ -0,0 +1,24 @@
+#ifndef TEAM_H
+#define TEAM_H
+
+/* Team of persistent worker threads running the same task on every thread.
+ * The calling thread takes part in each run as thread 0; pinned, it gets its
+ * own affinity back from team_destroy(). */
+typedef void (*team_fn)(int tid, void *arg);
+
+typedef struct Team Team;
+
+/* NULL if the memory or the threads of the team could not be had */
+Team *team_create(int no_threads, int pin);
+void team_run(Team *team, team_fn fn, void *arg);
+void team_destroy(Team *team);
+int team_size(const Team *team);
+int team_cpu(const Team *team, int tid);
+
+/* Splits [0, n) in no_parts ranges [bounds[t], bounds[t + 1]) of about the
+ * same weight, where ptr is a CSR-like prefix sum of the item weights; every
+ * item also weighs 1 and bounds are multiples of align */
+void team_partition(const long *ptr, int n, int no_parts, int align,
+                    int *bounds);
+
+#endif
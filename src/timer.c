@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "timer.h"
+
+double timer_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void timer_init(Phase_timer *pt) {
+  pt->no_phases = 0;
+  pt->begin = timer_now();
+}
+
+void timer_start(Phase_timer *pt) { pt->begin = timer_now(); }
+
+double timer_stop(Phase_timer *pt, const char *phase) {
+  double elapsed = timer_now() - pt->begin;
+  int i;
+
+  for (i = 0; i < pt->no_phases; ++i)
+    if (strcmp(pt->name[i], phase) == 0)
+      break;
+  if (i == pt->no_phases) {
+    if (pt->no_phases == TIMER_PHASES)
+      return elapsed;
+    pt->name[i] = phase;
+    pt->seconds[i] = 0.;
+    ++pt->no_phases;
+  }
+  pt->seconds[i] += elapsed;
+  pt->begin = timer_now();
+  return elapsed;
+}
+
+double timer_get(const Phase_timer *pt, const char *phase) {
+  int i;
+
+  for (i = 0; i < pt->no_phases; ++i)
+    if (strcmp(pt->name[i], phase) == 0)
+      return pt->seconds[i];
+  return 0.;
+}
+
+void timer_json(const Phase_timer *pt, FILE *pf) {
+  int i;
+
+  fprintf(pf, "{");
+  for (i = 0; i < pt->no_phases; ++i)
+    fprintf(pf, "%s\"%s\": %.6f", i ? ", " : "", pt->name[i], pt->seconds[i]);
+  fprintf(pf, "}");
+}
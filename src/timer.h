@@ -0,0 +1,26 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdio.h>
+
+#define TIMER_PHASES 16
+
+/* Monotonic wall clock time of the phases of a run */
+typedef struct {
+  const char *name[TIMER_PHASES];
+  double seconds[TIMER_PHASES];
+  int no_phases;
+  double begin;
+} Phase_timer;
+
+double timer_now(void);
+void timer_init(Phase_timer *pt);
+/* Starts timing a new phase */
+void timer_start(Phase_timer *pt);
+/* Adds the time since timer_start() to phase, returns it */
+double timer_stop(Phase_timer *pt, const char *phase);
+double timer_get(const Phase_timer *pt, const char *phase);
+/* Writes the phases as a JSON object */
+void timer_json(const Phase_timer *pt, FILE *pf);
+
+#endif
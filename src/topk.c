@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "topk.h"
+
+typedef struct {
+  double val;
+  int ind;
+} Topk_entry;
+
+/* Order of the top-K: larger values first, then smaller nodes */
+static int topk_before(double a, int i, double b, int j) {
+  return a > b || (a == b && i < j);
+}
+
+static int topk_cmp(const void *x, const void *y) {
+  const Topk_entry *a = (const Topk_entry *)x, *b = (const Topk_entry *)y;
+
+  return topk_before(b->val, b->ind, a->val, a->ind) -
+         topk_before(a->val, a->ind, b->val, b->ind);
+}
+
+int topk_create(Topk *t, int k, int no_threads) {
+  memset(t, 0, sizeof(Topk));
+  t->k = k;
+  t->no_threads = no_threads;
+  t->heap_val = (double *)malloc(sizeof(double) * k * no_threads);
+  t->heap_ind = (int *)malloc(sizeof(int) * k * no_threads);
+  t->heap_len = (int *)calloc(no_threads, sizeof(int));
+  t->top = (int *)malloc(sizeof(int) * k);
+  t->prev = (int *)malloc(sizeof(int) * k);
+  if (t->heap_val == NULL || t->heap_ind == NULL || t->heap_len == NULL ||
+      t->top == NULL || t->prev == NULL) {
+    topk_free(t);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+void topk_free(Topk *t) {
+  free(t->heap_val);
+  free(t->heap_ind);
+  free(t->heap_len);
+  free(t->top);
+  free(t->prev);
+  t->heap_val = NULL;
+  t->heap_ind = NULL;
+  t->heap_len = NULL;
+  t->top = t->prev = NULL;
+}
+
+void topk_scan(Topk *t, int tid, const double *v, int lo, int hi) {
+  double *val = t->heap_val + (long)tid * t->k;
+  int *ind = t->heap_ind + (long)tid * t->k;
+  int len = 0, k = t->k;
+  int i, j, c;
+
+  for (i = lo; i < hi; ++i) {
+    if (len == k && !topk_before(v[i], i, val[0], ind[0]))
+      continue;
+    if (len < k) {
+      /* Sifting up from the new leaf */
+      for (j = len++; j > 0 && topk_before(val[(j - 1) / 2], ind[(j - 1) / 2],
+                                           v[i], i);
+           j = (j - 1) / 2) {
+        val[j] = val[(j - 1) / 2];
+        ind[j] = ind[(j - 1) / 2];
+      }
+    } else {
+      /* Replacing the smallest, sifting down from the root */
+      for (j = 0; (c = 2 * j + 1) < len; j = c) {
+        if (c + 1 < len &&
+            topk_before(val[c], ind[c], val[c + 1], ind[c + 1]))
+          ++c;
+        if (!topk_before(v[i], i, val[c], ind[c]))
+          break;
+        val[j] = val[c];
+        ind[j] = ind[c];
+      }
+    }
+    val[j] = v[i];
+    ind[j] = i;
+  }
+  t->heap_len[tid] = len;
+}
+
+int topk_merge(Topk *t) {
+  Topk_entry *all;
+  int *swap;
+  int n = 0, same;
+  int tid, j;
+
+  if ((all = (Topk_entry *)malloc(sizeof(Topk_entry) * t->k *
+                                  t->no_threads)) == NULL)
+    return t->stable = 0;
+  for (tid = 0; tid < t->no_threads; ++tid)
+    for (j = 0; j < t->heap_len[tid]; ++j, ++n) {
+      all[n].val = t->heap_val[(long)tid * t->k + j];
+      all[n].ind = t->heap_ind[(long)tid * t->k + j];
+    }
+  qsort(all, n, sizeof(Topk_entry), topk_cmp);
+  if (n > t->k)
+    n = t->k;
+
+  swap = t->prev;
+  t->prev = t->top;
+  t->top = swap;
+  for (j = 0, same = n == t->k; j < n; ++j) {
+    t->top[j] = all[j].ind;
+    same = same && t->top[j] == t->prev[j];
+  }
+  free(all);
+  t->stable = same ? t->stable + 1 : 0;
+  return t->stable;
+}
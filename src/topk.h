@@ -0,0 +1,28 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+/* Tracker of the K largest entries of a vector across iterations, for
+ * stopping once their order settles. Every thread keeps the K largest of its
+ * rows in a min-heap, so a scan mostly costs one comparison per row; the
+ * heaps are merged once per iteration. Ties go to the smaller node, so the
+ * result does not depend on the number of threads. */
+#define TOPK_ROUNDS 3 /* iterations without changes before stopping */
+
+typedef struct {
+  int k;
+  int no_threads;
+  double *heap_val; /* k entries per thread */
+  int *heap_ind;
+  int *heap_len;
+  int *top, *prev; /* nodes, largest first */
+  int stable;      /* consecutive merges leaving top unchanged */
+} Topk;
+
+int topk_create(Topk *t, int k, int no_threads);
+void topk_free(Topk *t);
+/* Heap of thread tid, with the largest entries of v[lo, hi) */
+void topk_scan(Topk *t, int tid, const double *v, int lo, int hi);
+/* Merges the heaps into the top-K and returns t->stable */
+int topk_merge(Topk *t);
+
+#endif